@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/* bounded lock-free queue(Dmitry Vyukov's array based MPMC queue).
+
+   Any number of threads may push and pop. Each slot carries a sequence
+   number telling whether it's free for the producer of a given position or
+   holds an element for the consumer of that position, so a push/pop is one
+   CAS on the shared position plus one store on the slot.
+*/
+template <typename T>
+class BoundedQueue final {
+public:
+    //! @param capacity rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t Capacity() const { return mask_ + 1; }
+
+    //! @brief `value` is moved from only when the push succeeds
+    bool TryPush(T& value) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPush(T&& value) {
+        return TryPush(value);
+    }
+
+    bool TryPop(T& value) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! @brief approximate, only meant for monitoring
+    size_t Size() const {
+        size_t enqueue = enqueuePos_.load(std::memory_order_relaxed);
+        size_t dequeue = dequeuePos_.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // keep the hot positions on their own cache lines
+    alignas(64) std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_ = 0;
+    alignas(64) std::atomic<size_t> dequeuePos_ = 0;
+};
+
+/* lets a thread sleep until a `BoundedQueue` or the counters around it change,
+   instead of polling them.
+
+   A waiter registers itself before checking its condition, so `Notify` only
+   takes the lock when somebody may be asleep: the side that doesn't wait
+   stays lock-free as long as the other one keeps up.
+*/
+class QueueSignal final {
+public:
+    //! @brief wait until `ready()` is true, at most `timeout`
+    //! @return `ready()`
+    template <typename F, typename Rep, typename Period>
+    bool Wait(F&& ready, std::chrono::duration<Rep, Period> timeout) {
+        if (ready()) {
+            return true;
+        }
+        std::unique_lock lock(mutex_);
+        waiters_.fetch_add(1, std::memory_order_relaxed);
+        // pairs with the fence in `Notify`: either it sees the waiter or `ready` sees its change
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool result = cond_.wait_for(lock, timeout, ready);
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    //! @brief wake the waiters, call after making the change they wait for
+    void Notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        {
+            // a waiter between checking `ready` and sleeping holds the lock
+            std::lock_guard guard(mutex_);
+        }
+        cond_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<uint32_t> waiters_ = 0;
+};
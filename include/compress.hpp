@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* block compression of frame payloads(`FrameHeader::FlagCompressed`):
+
+    | raw size(u32) | LZ4 block |
+
+   The `SequenceTag` of a sequenced frame stays in front, uncompressed.
+   Uses the LZ4 block format(3rdlibs/lz4): a few hundred MB/s even on poorly
+   compressible data, so it only costs when the link is fast anyway.
+*/
+struct BlockCodec final {
+    //! payloads smaller than this aren't worth compressing
+    static constexpr size_t DefaultThreshold = 16 * 1024;
+    //! an LZ4 block never inflates to more than this many times its size
+    static constexpr uint64_t MaxRatio = 255;
+    //! decompression buffers kept for reuse give back anything above this
+    static constexpr size_t KeepCapacity = 4 * 1024 * 1024;
+
+    //! @brief append the compressed form of `[data, data + size)` to `out`
+    //! @return false, with `out` left as it was, if it doesn't get smaller
+    static bool Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+    //! @brief decompress a whole payload, `out` is resized to the raw size
+    //! @return false if the payload is malformed or claims a raw size it can't have
+    static bool Decompress(const uint8_t* beg, const uint8_t* end, std::vector<uint8_t>& out);
+
+    //! @brief free the buffers of `buffers` an oversized payload grew past `KeepCapacity`
+    static void TrimPool(std::vector<std::vector<uint8_t>>& buffers);
+};
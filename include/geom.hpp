@@ -20,6 +20,33 @@ struct Linear {
     }
 };
 
+//! @brief axis aligned bounding box, empty until something is added
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    bool Empty() const {
+        return min.x > max.x;
+    }
+
+    void Add(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Add(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    //! @brief the box around this one moved by `transform`
+    AABB Transformed(const glm::mat4& transform) const;
+};
+
+//! @brief true if `box` is certainly off screen: all its corners are outside one plane of the clip volume
+//! @param clip projection * view * model
+bool OutsideClip(const AABB& box, const glm::mat4& clip);
+
 bool IsLineParallel(const Linear& l1, const Linear& l2);
 float ParallelLineDist(const glm::vec3& origin1, const glm::vec3& origin2, const glm::vec3& dir);
 std::optional<std::pair<float, float>> RaySegNearest(const Linear& ray, const Linear& seg);
\ No newline at end of file
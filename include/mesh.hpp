@@ -15,12 +15,57 @@ struct Mesh final {
     std::vector<Vertex> vertices;
     std::optional<std::vector<uint32_t>> indices;
     Type type;
+    // per vertex attributes live in their own arrays, so positions stay packed
+    // for decoding and each attribute is its own vertex buffer
+    std::optional<std::vector<glm::vec3>> colors;
+    std::optional<std::vector<glm::vec3>> normals;
 
-    static Mesh Create(Type type, const std::vector<Vertex>& vertices) {
-        return Mesh{vertices, std::nullopt, type};
+    static Mesh Create(Type type, std::vector<Vertex> vertices) {
+        return Mesh{std::move(vertices), std::nullopt, type, std::nullopt, std::nullopt};
     }
 
     static Mesh CreateWithIndices(Type type, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
-        return Mesh{vertices, indices, type};
+        return Mesh{vertices, indices, type, std::nullopt, std::nullopt};
     }
+
+    //! @brief bytes the arrays hold on the heap, spare capacity included
+    size_t HeapBytes() const {
+        return vertices.capacity() * sizeof(Vertex) +
+               (indices ? indices->capacity() * sizeof(uint32_t) : 0) +
+               (colors ? colors->capacity() * sizeof(glm::vec3) : 0) +
+               (normals ? normals->capacity() * sizeof(glm::vec3) : 0);
+    }
+
+    //! @brief bytes `Renderer::Draw` uploads to draw it
+    size_t UploadBytes() const {
+        return vertices.size() * sizeof(Vertex) +
+               (indices ? indices->size() * sizeof(uint32_t) : 0) +
+               (colors && colors->size() == vertices.size() ? colors->size() * sizeof(glm::vec3) : 0) +
+               (normals && normals->size() == vertices.size() ? normals->size() * sizeof(glm::vec3) : 0);
+    }
+};
+
+/* the arrays of a `Mesh` as they were when the view was taken, what `Renderer::Draw` reads.
+
+   The mesh may grow meanwhile as long as its arrays aren't reallocated: the
+   view keeps its counts and never looks at the vectors again.
+*/
+struct MeshView final {
+    Mesh::Type type = Mesh::Type::Points;
+    const Vertex* vertices = nullptr;
+    size_t vertexCount = 0;
+    const uint32_t* indices = nullptr;
+    size_t indexCount = 0;
+    bool indexed = false;
+    const glm::vec3* colors = nullptr;     // null unless there is one per vertex
+    const glm::vec3* normals = nullptr;    // the same
+
+    MeshView() = default;
+
+    MeshView(const Mesh& mesh)
+        : type(mesh.type), vertices(mesh.vertices.data()), vertexCount(mesh.vertices.size()),
+          indices(mesh.indices ? mesh.indices->data() : nullptr), indexCount(mesh.indices ? mesh.indices->size() : 0),
+          indexed(mesh.indices.has_value()),
+          colors(mesh.colors && mesh.colors->size() == vertexCount ? mesh.colors->data() : nullptr),
+          normals(mesh.normals && mesh.normals->size() == vertexCount ? mesh.normals->data() : nullptr) {}
 };
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/* process wide interning of object names into dense ids 0, 1, 2, ...
+
+   Ids are never reused, so the scene keeps its objects in a flat array indexed
+   by id. The receivers intern the names of incoming packets, names declared
+   on a connection(`Opcode::Declare`) are only hashed once.
+*/
+class NameTable final {
+public:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    static NameTable& Instance();
+
+    //! @brief id of `name`, a new one if it wasn't seen yet. Thread safe
+    uint32_t Intern(std::string_view name);
+
+    //! @brief the interned name, empty for an unknown id. Thread safe
+    //! @return points into the table: NUL terminated and valid until the program exits
+    std::string_view Name(uint32_t id) const;
+
+    size_t Size() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::deque<std::string> names_;     // a deque never moves its elements, the keys point into it
+    std::unordered_map<std::string_view, uint32_t> ids_;
+};
@@ -1,27 +1,75 @@
-/* A thin layer for Win32 Socket
+/* A thin layer for Win32 Socket and POSIX socket
     usage:
 
     ```cpp
     #define NET_IMPLEMENTATION
     #include "net.hpp"
     ```
+
+    On Linux the readiness loop(`Poller`) is backed by epoll, other platforms
+    fall back to `poll`/`WSAPoll`.
 */ 
 #pragma once
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#endif
+
 #include <iostream>
 #include <string_view>
 #include <unordered_map>
 #include <array>
 #include <string>
 #include <utility>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <mutex>
+#include <cstring>
 
+#ifdef _WIN32
 #pragma comment(lib, "Ws2_32.lib")
+#endif
 
 namespace net
 {
 
+#ifdef _WIN32
+
+using SocketHandle = SOCKET;
+constexpr SocketHandle InvalidSocket = INVALID_SOCKET;
+constexpr int ErrWouldBlock = WSAEWOULDBLOCK;
+constexpr int ErrInterrupted = WSAEINTR;
+constexpr int ErrInvalid = WSAEINVAL;
+constexpr int ErrConnRefused = WSAECONNREFUSED;
+constexpr int SendFlags = 0;
+
+inline int LastErrorCode()
+{
+    return WSAGetLastError();
+}
+
+inline int CloseSocket(SocketHandle s)
+{
+    return closesocket(s);
+}
+
 static std::unordered_map<int, std::string_view> ErrorStrMap = {
     {WSA_INVALID_HANDLE, "WSA_INVALID_HANDLE"},
     {WSA_NOT_ENOUGH_MEMORY, "WSA_NOT_ENOUGH_MEMORY"},
@@ -120,6 +168,76 @@ static std::unordered_map<int, std::string_view> ErrorStrMap = {
     {WSA_QOS_RESERVED_PETYPE, "WSA_QOS_RESERVED_PETYPE"},
 };
 
+#else
+
+using SocketHandle = int;
+constexpr SocketHandle InvalidSocket = -1;
+constexpr int ErrWouldBlock = EWOULDBLOCK;
+constexpr int ErrInterrupted = EINTR;
+constexpr int ErrInvalid = EINVAL;
+constexpr int ErrConnRefused = ECONNREFUSED;
+#ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+constexpr int SendFlags = 0;
+#endif
+
+inline int LastErrorCode()
+{
+    return errno;
+}
+
+inline int CloseSocket(SocketHandle s)
+{
+    return ::close(s);
+}
+
+static std::unordered_map<int, std::string_view> ErrorStrMap = {
+    {EINTR, "EINTR"},
+    {EBADF, "EBADF"},
+    {EACCES, "EACCES"},
+    {EFAULT, "EFAULT"},
+    {EINVAL, "EINVAL"},
+    {EMFILE, "EMFILE"},
+    {ENFILE, "ENFILE"},
+    {ENOMEM, "ENOMEM"},
+    {EPIPE, "EPIPE"},
+    {EAGAIN, "EAGAIN"},
+    {EINPROGRESS, "EINPROGRESS"},
+    {EALREADY, "EALREADY"},
+    {ENOTSOCK, "ENOTSOCK"},
+    {EDESTADDRREQ, "EDESTADDRREQ"},
+    {EMSGSIZE, "EMSGSIZE"},
+    {EPROTOTYPE, "EPROTOTYPE"},
+    {ENOPROTOOPT, "ENOPROTOOPT"},
+    {EPROTONOSUPPORT, "EPROTONOSUPPORT"},
+    {EOPNOTSUPP, "EOPNOTSUPP"},
+    {EAFNOSUPPORT, "EAFNOSUPPORT"},
+    {EADDRINUSE, "EADDRINUSE"},
+    {EADDRNOTAVAIL, "EADDRNOTAVAIL"},
+    {ENETDOWN, "ENETDOWN"},
+    {ENETUNREACH, "ENETUNREACH"},
+    {ENETRESET, "ENETRESET"},
+    {ECONNABORTED, "ECONNABORTED"},
+    {ECONNRESET, "ECONNRESET"},
+    {ENOBUFS, "ENOBUFS"},
+    {EISCONN, "EISCONN"},
+    {ENOTCONN, "ENOTCONN"},
+    {ESHUTDOWN, "ESHUTDOWN"},
+    {ETIMEDOUT, "ETIMEDOUT"},
+    {ECONNREFUSED, "ECONNREFUSED"},
+    {ELOOP, "ELOOP"},
+    {ENAMETOOLONG, "ENAMETOOLONG"},
+    {EHOSTDOWN, "EHOSTDOWN"},
+    {EHOSTUNREACH, "EHOSTUNREACH"},
+    {ENOENT, "ENOENT"},
+    {ENOSYS, "ENOSYS"},
+};
+
+#endif
+
+constexpr int SocketError = -1;
+
 enum class SockType {
     STREAM = 0,
     DGRAM,
@@ -128,11 +246,13 @@ enum class SockType {
 enum class Protocol {
     TCP = 0,
     UDP,
+    Default,    // let the family pick, used by Unix domain sockets
 };
 
 enum class Family {
     IPv4 = 0,
     IPv6,
+    Unix,
 };
 
 enum class Flags {
@@ -147,14 +267,16 @@ constexpr std::array<uint8_t, 2> SockTypeMapper{
     SOCK_DGRAM,
 };
 
-constexpr std::array<uint8_t, 2> ProtocolMapper{
+constexpr std::array<uint8_t, 3> ProtocolMapper{
     IPPROTO_TCP,
     IPPROTO_UDP,
+    0,
 };
 
-constexpr std::array<uint8_t, 2> FamilyMapper{
+constexpr std::array<uint8_t, 3> FamilyMapper{
     AF_INET,
     AF_INET6,
+    AF_UNIX,
 };
 
 constexpr std::array<uint8_t, 2> FlagsMapper{
@@ -165,27 +287,57 @@ constexpr std::array<uint8_t, 2> FlagsMapper{
 
 inline std::string_view Error2Str(int error)
 {
-    return ErrorStrMap[error];
+    if (auto it = ErrorStrMap.find(error); it != ErrorStrMap.end()) {
+        return it->second;
+    }
+    return "UNKNOWN";
 }
 
 inline std::string_view GetLastError()
 {
-    return Error2Str(WSAGetLastError());
+    return Error2Str(LastErrorCode());
 }
 
 struct AddrInfo {
     addrinfo info;
+    sockaddr_storage addr;
 
+    // `getaddrinfo` owns `ai_addr`, so we keep our own copy of the address
     AddrInfo(addrinfo* info) {
         memcpy(&this->info, info, sizeof(addrinfo));
+        memset(&addr, 0, sizeof(addr));
+        memcpy(&addr, info->ai_addr, info->ai_addrlen);
+        this->info.ai_addr = (sockaddr*)&addr;
+        this->info.ai_canonname = nullptr;
+        this->info.ai_next = nullptr;
         freeaddrinfo(info);
     }
 
     AddrInfo() {
         memset(&info, 0, sizeof(addrinfo));
+        memset(&addr, 0, sizeof(addr));
     }
+
+    AddrInfo(const AddrInfo& o) {
+        *this = o;
+    }
+
+    AddrInfo& operator=(const AddrInfo& o) {
+        memcpy(&info, &o.info, sizeof(addrinfo));
+        memcpy(&addr, &o.addr, sizeof(addr));
+        info.ai_addr = o.info.ai_addr ? (sockaddr*)&addr : nullptr;
+        return *this;
+    }
+};
+
+//! @brief one piece of a gathered send, see `Socket::SendV`
+struct IoSlice {
+    const void* data;
+    size_t size;
 };
 
+constexpr size_t MaxIoSlices = 16;
+
 template <typename ErrorCodeType, typename T>
 struct Result {
     ErrorCodeType result;
@@ -218,6 +370,18 @@ struct AddrInfoBuilder {
         return builder;
     }
 
+    //! @brief a Unix domain stream socket, `path` is the socket file
+    static AddrInfoBuilder CreateUnix(const std::string& path) {
+        AddrInfoBuilder builder;
+        builder.SetAddress(path)
+               .SetPort(0)
+               .SetFamily(Family::Unix)
+               .SetProtocol(Protocol::Default)
+               .SetSockType(SockType::STREAM)
+               .SetFlags(Flags::None);
+        return builder;
+    }
+
     AddrInfoBuilder& SetAddress(const std::string& address) {
         address_ = address;
         return *this;
@@ -244,16 +408,23 @@ struct AddrInfoBuilder {
     }
     
     Result<int, AddrInfo> Build() {
+        if (family_ == Family::Unix) {
+            return buildUnix();
+        }
+
         addrinfo hint;
-        ZeroMemory(&hint, sizeof(hint));
+        memset(&hint, 0, sizeof(hint));
         hint.ai_family = FamilyMapper[static_cast<uint8_t>(family_)];
         hint.ai_flags = FlagsMapper[static_cast<uint8_t>(flags_)];
         hint.ai_socktype = SockTypeMapper[static_cast<uint8_t>(socktype_)];
         hint.ai_protocol = ProtocolMapper[static_cast<uint8_t>(protocol_)];
 
-        addrinfo* result;
+        addrinfo* result = nullptr;
         auto port = std::to_string(port_);
-        int resultCode = getaddrinfo(address_.c_str() == "" ? nullptr : address_.c_str(), port.c_str(), &hint, &result);
+        int resultCode = getaddrinfo(address_.empty() ? nullptr : address_.c_str(), port.c_str(), &hint, &result);
+        if (resultCode != 0 || !result) {
+            return Result<int, AddrInfo>(resultCode, AddrInfo());
+        }
         return Result<int, AddrInfo>(resultCode, AddrInfo(result));
     }
 
@@ -264,21 +435,39 @@ private:
     uint16_t port_;
     Flags flags_;
     std::string address_;
+
+    // `getaddrinfo` doesn't know about Unix domain sockets
+    Result<int, AddrInfo> buildUnix() const {
+#ifdef _WIN32
+        return Result<int, AddrInfo>(WSAEAFNOSUPPORT, AddrInfo());
+#else
+        AddrInfo info;
+        auto un = reinterpret_cast<sockaddr_un*>(&info.addr);
+        if (address_.empty() || address_.size() >= sizeof(un->sun_path)) {
+            return Result<int, AddrInfo>(ENAMETOOLONG, AddrInfo());
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, address_.c_str(), address_.size() + 1);
+        info.info.ai_family = AF_UNIX;
+        info.info.ai_socktype = SockTypeMapper[static_cast<uint8_t>(socktype_)];
+        info.info.ai_protocol = 0;
+        info.info.ai_addr = reinterpret_cast<sockaddr*>(&info.addr);
+        info.info.ai_addrlen = sizeof(sockaddr_un);
+        return Result<int, AddrInfo>(0, info);
+#endif
+    }
 };
 
 class Socket final {
 public:
-    Socket(SOCKET s) : s_(s) {}
-    Socket(const AddrInfo &addr, bool nonBlock) : addr_(&addr) {
+    Socket(SocketHandle s) : s_(s) {}
+    Socket(const AddrInfo &addr, bool nonBlock) : addr_(addr) {
         s_ = socket(addr.info.ai_family, addr.info.ai_socktype, addr.info.ai_protocol);
-        if (s_ == INVALID_SOCKET) {
+        if (s_ == InvalidSocket) {
             std::cerr << "socket create failed" << GetLastError() << std::endl;
         } else {
             if (nonBlock) {
-                unsigned long ul = 1;
-                if (int result = ioctlsocket(s_, FIONBIO, (unsigned long*)&ul); result != 0) {
-                    std::cerr << "set socket non-block failed: " << Error2Str(result) << std::endl;
-                }
+                SetNonblock(true);
             }
         }
     }
@@ -295,34 +484,61 @@ public:
 
     Socket& operator=(const Socket&) = delete;
 
-    int Socket::Bind() {
+    int Bind() {
+#ifndef _WIN32
+        if (addr_->info.ai_family == AF_UNIX) {
+            // a viewer that didn't exit cleanly leaves its socket file behind
+            const char* path = reinterpret_cast<const sockaddr_un*>(addr_->info.ai_addr)->sun_path;
+            struct stat st;
+            if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                unlink(path);
+            }
+        } else {
+            // let the viewer rebind its port right after a restart
+            int reuse = 1;
+            setsockopt(s_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+#endif
         return ::bind(s_, addr_->info.ai_addr, (int)addr_->info.ai_addrlen);
     }
 
-    int Socket::Listen(int backlog) {
+    //! @brief enlarge the kernel receive buffer, lets a UDP socket absorb bursts
+    int SetRecvBufferSize(int size) {
+        return setsockopt(s_, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+    }
+
+    int Listen(int backlog) {
         return listen(s_, backlog);
     }
 
     void SetNonblock(bool nonBlock) {
+#ifdef _WIN32
         unsigned long mode = nonBlock ? 1 : 0;
         if (ioctlsocket(s_, FIONBIO, &mode) == SOCKET_ERROR) {
             std::cerr << "set non-block io failed:" << Error2Str(WSAGetLastError()) << std::endl;
         }
+#else
+        int flags = fcntl(s_, F_GETFL, 0);
+        flags = nonBlock ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+        if (flags < 0 || fcntl(s_, F_SETFL, flags) == -1) {
+            std::cerr << "set non-block io failed:" << Error2Str(errno) << std::endl;
+        }
+#endif
     }
 
     void Close() {
         if (Valid()) {
-            closesocket(s_);
-            s_ = INVALID_SOCKET;
+            CloseSocket(s_);
+            s_ = InvalidSocket;
         }
     }
 
     Result<int, std::unique_ptr<Socket>> Accept() {
-        SOCKET clientSocket = accept(s_, nullptr, nullptr);
-        if (clientSocket == INVALID_SOCKET)
+        SocketHandle clientSocket = accept(s_, nullptr, nullptr);
+        if (clientSocket == InvalidSocket)
         {
-            int result = WSAGetLastError();
-            if (result != WSAEWOULDBLOCK) {
+            int result = LastErrorCode();
+            if (result != ErrWouldBlock) {
                 std::cerr << "accept socket failed: " << Error2Str(result) << std::endl;
             }
             return Result<int, std::unique_ptr<Socket>>(result, nullptr);
@@ -331,7 +547,11 @@ public:
         return Result<int, std::unique_ptr<Socket>>(0, std::make_unique<Socket>(clientSocket));
     }
     bool Valid() const {
-        return s_ != INVALID_SOCKET;
+        return s_ != InvalidSocket;
+    }
+
+    SocketHandle Handle() const {
+        return s_;
     }
 
     int Connect() {
@@ -339,27 +559,91 @@ public:
     }
 
     Result<int, int> Recv(char *buf, size_t size) {
-        int len = recv(s_, buf, size, 0);
+        int len;
+        do {
+            len = recv(s_, buf, size, 0);
+        } while (len < 0 && LastErrorCode() == ErrInterrupted);
         if (len <= 0) {
-            return Result<int, int>(WSAGetLastError(), len);
+            return Result<int, int>(LastErrorCode(), len);
         } else {
             return Result<int, int>(0, len);
         }
     }
 
-    Result<int, int> Send(char *buf, size_t size) {
-        char* last = buf;
+    Result<int, int> Send(const char *buf, size_t size) {
+        const char* last = buf;
         do {
-            int len = send(s_, last, size - (last - buf), 0);
+            int len = send(s_, last, size - (last - buf), SendFlags);
             if (len <= 0) {
-                return Result<int, int>(WSAGetLastError(), len);
+                if (len < 0 && LastErrorCode() == ErrInterrupted) {
+                    continue;
+                }
+                return Result<int, int>(LastErrorCode(), len);
             } else {
                 last = last + len;
             }
-        } while (last < buf);
+        } while (last < buf + size);
         return Result<int, int>(0, size);
     }
 
+    //! @brief send all slices with as few syscalls as possible(`sendmsg`/`WSASend`)
+    //! @param count at most `MaxIoSlices`
+    Result<int, int> SendV(const IoSlice* slices, size_t count) {
+        if (count > MaxIoSlices) {
+            return Result<int, int>(ErrInvalid, SocketError);
+        }
+
+#ifdef _WIN32
+        WSABUF bufs[MaxIoSlices];
+        for (size_t i = 0; i < count; i++) {
+            bufs[i].buf = (char*)slices[i].data;
+            bufs[i].len = (ULONG)slices[i].size;
+        }
+#else
+        iovec bufs[MaxIoSlices];
+        for (size_t i = 0; i < count; i++) {
+            bufs[i].iov_base = const_cast<void*>(slices[i].data);
+            bufs[i].iov_len = slices[i].size;
+        }
+#endif
+
+        size_t first = 0;
+        size_t total = 0;
+        while (first < count) {
+#ifdef _WIN32
+            DWORD sent = 0;
+            if (WSASend(s_, bufs + first, (DWORD)(count - first), &sent, 0, nullptr, nullptr) == SOCKET_ERROR) {
+                return Result<int, int>(LastErrorCode(), SocketError);
+            }
+            size_t len = sent;
+#else
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = bufs + first;
+            msg.msg_iovlen = count - first;
+            ssize_t sent = sendmsg(s_, &msg, SendFlags);
+            if (sent < 0) {
+                if (LastErrorCode() == ErrInterrupted) {
+                    continue;
+                }
+                return Result<int, int>(LastErrorCode(), SocketError);
+            }
+            size_t len = sent;
+#endif
+            total += len;
+
+            // drop the fully sent slices and advance into the partially sent one
+            while (first < count && len >= sliceSize(bufs[first])) {
+                len -= sliceSize(bufs[first]);
+                first ++;
+            }
+            if (first < count) {
+                advanceSlice(bufs[first], len);
+            }
+        }
+        return Result<int, int>(0, (int)total);
+    }
+
     template <typename T>
     int Recv(const T &buf) {
         return recv(s_, buf.data(), buf.size(), 0);
@@ -367,12 +651,26 @@ public:
 
     template <typename T>
     int Send(const T &buf) {
-        return send(s_, buf.data(), buf.size(), 0);
+        return send(s_, buf.data(), buf.size(), SendFlags);
     }
 
 private:
-    SOCKET s_ = INVALID_SOCKET;
-    const AddrInfo *addr_ = nullptr;
+    SocketHandle s_ = InvalidSocket;
+    std::optional<AddrInfo> addr_;  // our own copy, `Bind`/`Connect` outlive the caller's
+
+#ifdef _WIN32
+    static size_t sliceSize(const WSABUF& buf) { return buf.len; }
+    static void advanceSlice(WSABUF& buf, size_t len) {
+        buf.buf += len;
+        buf.len -= (ULONG)len;
+    }
+#else
+    static size_t sliceSize(const iovec& buf) { return buf.iov_len; }
+    static void advanceSlice(iovec& buf, size_t len) {
+        buf.iov_base = (char*)buf.iov_base + len;
+        buf.iov_len -= len;
+    }
+#endif
 
     friend void swap(Socket &lhs, Socket &rhs)
     {
@@ -381,16 +679,184 @@ private:
     }
 };
 
+/* readiness notification over a set of sockets.
+   epoll on Linux, `poll`/`WSAPoll` elsewhere. Level triggered.
+*/
+class Poller final {
+public:
+    struct Event {
+        void* userData;
+        bool readable;
+        bool writable;
+        bool hangup;
+    };
+
+    Poller() {
+#ifdef __linux__
+        fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (fd_ < 0) {
+            std::cerr << "epoll create failed: " << GetLastError() << std::endl;
+        }
+#endif
+    }
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    ~Poller() {
+#ifdef __linux__
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    bool Valid() const {
+#ifdef __linux__
+        return fd_ >= 0;
+#else
+        return true;
+#endif
+    }
+
+    bool Add(SocketHandle s, void* userData, bool wantWrite = false) {
+#ifdef __linux__
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.ptr = userData;
+        return epoll_ctl(fd_, EPOLL_CTL_ADD, s, &event) == 0;
+#else
+        std::lock_guard guard(mutex_);
+        pollfd fd;
+        fd.fd = s;
+        fd.events = POLLIN | (wantWrite ? POLLOUT : 0);
+        fd.revents = 0;
+        fds_.push_back(fd);
+        userDatas_.push_back(userData);
+        return true;
+#endif
+    }
+
+    bool Modify(SocketHandle s, void* userData, bool wantWrite) {
+#ifdef __linux__
+        epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        event.data.ptr = userData;
+        return epoll_ctl(fd_, EPOLL_CTL_MOD, s, &event) == 0;
+#else
+        std::lock_guard guard(mutex_);
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (fds_[i].fd == s) {
+                fds_[i].events = POLLIN | (wantWrite ? POLLOUT : 0);
+                userDatas_[i] = userData;
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+
+    void Remove(SocketHandle s) {
+#ifdef __linux__
+        epoll_event event{};
+        epoll_ctl(fd_, EPOLL_CTL_DEL, s, &event);
+#else
+        std::lock_guard guard(mutex_);
+        for (size_t i = 0; i < fds_.size(); i++) {
+            if (fds_[i].fd == s) {
+                fds_.erase(fds_.begin() + i);
+                userDatas_.erase(userDatas_.begin() + i);
+                return;
+            }
+        }
+#endif
+    }
+
+    //! @brief wait for readiness
+    //! @param events receive the ready sockets, cleared first
+    //! @param timeoutMs -1 means wait forever
+    //! @return number of ready sockets, -1 on error
+    int Wait(std::vector<Event>& events, int timeoutMs) {
+        events.clear();
+#ifdef __linux__
+        epoll_event buf[64];
+        int count = epoll_wait(fd_, buf, 64, timeoutMs);
+        if (count < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        for (int i = 0; i < count; i++) {
+            uint32_t e = buf[i].events;
+            events.push_back(Event{buf[i].data.ptr,
+                                   (e & EPOLLIN) != 0,
+                                   (e & EPOLLOUT) != 0,
+                                   (e & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0});
+        }
+        return count;
+#else
+        std::vector<pollfd> fds;
+        std::vector<void*> userDatas;
+        {
+            std::lock_guard guard(mutex_);
+            fds = fds_;
+            userDatas = userDatas_;
+        }
+        if (fds.empty()) {
+            // nothing to poll yet, behave like an idle wait
+            pollSleep(timeoutMs);
+            return 0;
+        }
+#ifdef _WIN32
+        int count = WSAPoll(fds.data(), (ULONG)fds.size(), timeoutMs);
+#else
+        int count = poll(fds.data(), fds.size(), timeoutMs);
+#endif
+        if (count < 0) {
+            return LastErrorCode() == ErrInterrupted ? 0 : -1;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            auto e = fds[i].revents;
+            if (e == 0) {
+                continue;
+            }
+            events.push_back(Event{userDatas[i],
+                                   (e & POLLIN) != 0,
+                                   (e & POLLOUT) != 0,
+                                   (e & (POLLHUP | POLLERR)) != 0});
+        }
+        return static_cast<int>(events.size());
+#endif
+    }
+
+private:
+#ifdef __linux__
+    int fd_ = -1;
+#else
+#ifdef _WIN32
+    using pollfd = WSAPOLLFD;
+    static void pollSleep(int timeoutMs) { Sleep(timeoutMs < 0 ? 10 : timeoutMs); }
+#else
+    static void pollSleep(int timeoutMs) { poll(nullptr, 0, timeoutMs < 0 ? 10 : timeoutMs); }
+#endif
+    std::mutex mutex_;
+    std::vector<pollfd> fds_;
+    std::vector<void*> userDatas_;
+#endif
+};
+
 class Net final
 {
 public:
     Net() {
+#ifdef _WIN32
         WSAStartup(MAKEWORD(2, 2), &wsaData_);
+#endif
     }
 
     ~Net() {
         sockets_.clear();
+#ifdef _WIN32
         WSACleanup();
+#endif
     }
 
     Socket *CreateSocket(const AddrInfo &addr, bool nonBlock = false) {
@@ -399,13 +865,15 @@ public:
     }
 
 private:
+#ifdef _WIN32
     WSADATA wsaData_;
+#endif
     std::vector<std::unique_ptr<Socket>> sockets_;
 };
 
 // function declarations
 
-inline [[nodiscard]] std::unique_ptr<Net> Init()
+[[nodiscard]] inline std::unique_ptr<Net> Init()
 {
     return std::make_unique<Net>();
 }
@@ -3,6 +3,18 @@
 #include "pch.hpp"
 #include "mesh.hpp"
 #include "net.hpp"
+#include "recv_buffer.hpp"
+#include "bounded_queue.hpp"
+#include "shm.hpp"
+#include "compress.hpp"
+#include "name_table.hpp"
+#include "wire.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 
 using Vec3 = glm::vec3;
 
@@ -10,39 +22,517 @@ struct NetData final {
     std::vector<Vec3> positions;
     glm::vec3 color;
     std::string name;
+
+    // optional, only sent when there is one per position
+    std::vector<glm::vec3> colors;
+    std::vector<Vec3> normals;
+    // optional, index into `positions`
+    std::vector<uint32_t> indices;
+};
+
+enum class Opcode: uint8_t {
+    Mesh = 1,       // payload is a whole `Packet`, replaces the named mesh
+    Append = 2,     // same payload, its positions go after the named mesh's vertices
+    Replace = 3,    // offset(u32) then a `Packet`, overwrites vertices from `offset` on
+    Batch = 4,      // many of the above in one payload, see `Batch`
+    Declare = 5,    // binds a name to an id for the packets after it, see `NameDeclaration`
+    Transform = 6,  // sets the named mesh's model transform, its vertices stay as they are
+};
+
+/* every message on the wire is a frame:
+
+    | magic(u32) | version(u8) | opcode(u8) | flags(u16) | length(u32) | payload(length bytes) |
+
+   old clients wrap the payload in "BEG"/"END" instead, `NetRecv` still accepts that.
+*/
+struct FrameHeader final {
+    static constexpr uint32_t Magic = 0x47424456;    // "VDBG"
+    static constexpr uint8_t Version = 1;
+    static constexpr size_t Size = 12;
+    static constexpr uint32_t MaxLength = 1u << 30;
+
+    //! payload starts with a `SequenceTag`, set by senders on UDP
+    static constexpr uint16_t FlagSequenced = 1 << 0;
+    //! the rest of the payload is compressed, see `BlockCodec`
+    static constexpr uint16_t FlagCompressed = 1 << 1;
+
+    uint8_t version = Version;
+    Opcode opcode = Opcode::Mesh;
+    uint16_t flags = 0;
+    uint32_t length = 0;
+
+    void Write(uint8_t* buf) const;
+
+    //! @brief parse a header from `[beg, end)`, `std::nullopt` if there are less than `Size` bytes or no magic
+    static std::optional<FrameHeader> Read(const uint8_t* beg, const uint8_t* end);
+
+    static bool StartsWithMagic(const uint8_t* beg, const uint8_t* end);
+};
+
+using FrameHeaderSchema = wire::Schema<FrameHeader,
+                                       wire::Const<uint32_t, FrameHeader::Magic>,
+                                       wire::Field<&FrameHeader::version>,
+                                       wire::Field<&FrameHeader::opcode, uint8_t>,
+                                       wire::Field<&FrameHeader::flags>,
+                                       wire::Field<&FrameHeader::length>>;
+static_assert(FrameHeaderSchema::Size == FrameHeader::Size);
+
+inline void FrameHeader::Write(uint8_t* buf) const {
+    FrameHeaderSchema::Write(*this, buf);
+}
+
+inline std::optional<FrameHeader> FrameHeader::Read(const uint8_t* beg, const uint8_t* end) {
+    FrameHeader header;
+    if (!FrameHeaderSchema::Read(header, beg, end)) {
+        return std::nullopt;
+    }
+    return header;
+}
+
+/* prefix of a `FrameHeader::FlagSequenced` payload.
+   `session` is picked randomly by each sender, so packets of a restarted
+   sender aren't taken for stale ones.
+*/
+struct SequenceTag final {
+    static constexpr size_t Size = 8;
+
+    uint32_t session = 0;
+    uint32_t sequence = 0;
+
+    void Write(uint8_t* buf) const;
+    static std::optional<SequenceTag> Read(const uint8_t* beg, const uint8_t* end);
+
+    //! @brief whether this tag supersedes `old`, sequence numbers may wrap around
+    bool NewerThan(const SequenceTag& old) const {
+        return session != old.session || static_cast<int32_t>(sequence - old.sequence) > 0;
+    }
+};
+
+using SequenceTagSchema = wire::Schema<SequenceTag,
+                                       wire::Field<&SequenceTag::session>,
+                                       wire::Field<&SequenceTag::sequence>>;
+static_assert(SequenceTagSchema::Size == SequenceTag::Size);
+
+inline void SequenceTag::Write(uint8_t* buf) const {
+    SequenceTagSchema::Write(*this, buf);
+}
+
+inline std::optional<SequenceTag> SequenceTag::Read(const uint8_t* beg, const uint8_t* end) {
+    SequenceTag tag;
+    if (!SequenceTagSchema::Read(tag, beg, end)) {
+        return std::nullopt;
+    }
+    return tag;
+}
+
+/* how `Packet` positions go on the wire, stored in bits 4-5 of the type byte.
+   Old viewers only understand `Float64`, so it stays the default. */
+enum class PositionEncoding: uint8_t {
+    Float64 = 0,        // 3 doubles per vertex
+    Float32 = 1,        // 3 floats per vertex
+    Quantized16 = 2,    // per packet AABB as 6 floats, then 3 u16 per vertex relative to it
 };
 
+/* `Append` and `Replace` packets only touch the vertices of the named mesh,
+   type and color are used when the mesh doesn't exist yet.
+
+   A `Transform` packet moves the named mesh without resending it:
+
+    | type byte | transform(12 floats) | name |
+
+   The transform is affine: its 4 columns without the last row, which is
+   always (0, 0, 0, 1). 53 bytes with a declared name, in a 65 byte frame.
+   The mesh keeps its transform when a `Mesh` packet replaces its vertices.
+
+   Bit 6 of the type byte says the name is an id(u32) bound by a `NameDeclaration`.
+   Bit 7 says an attribute byte(`Attr*` bits) follows the type byte;
+   the attributes go between the positions and the color:
+
+    | colors(RGB8 each) | normals(3 floats each) | index count(u32) | indices(u16 or u32 each) |
+*/
 struct Packet final {
+    static constexpr uint8_t AttrColors = 1 << 0;
+    static constexpr uint8_t AttrNormals = 1 << 1;
+    static constexpr uint8_t AttrIndices16 = 1 << 2;
+    static constexpr uint8_t AttrIndices32 = 1 << 3;
+
+    //! no id, the name goes in full
+    static constexpr uint32_t NoNameId = UINT32_MAX;
+
     Mesh::Type type;
     NetData data;
+    PositionEncoding encoding = PositionEncoding::Float64;
+    Opcode opcode = Opcode::Mesh;
+    uint32_t offset = 0;    // first vertex overwritten by `Opcode::Replace`
+    glm::mat4 transform = glm::mat4(1.0f);     // sent by `Opcode::Transform`, in the sender's coordinates, affine
 
     std::vector<uint8_t> Serialize() const;
-    static std::optional<Packet> Deserialize(const uint8_t* beg, const uint8_t* end);
+    //! @brief append the serialized packet to `buf`
+    //! @param nameId send this declared id instead of the name
+    void SerializeTo(std::vector<uint8_t>& buf, uint32_t nameId = NoNameId) const;
+    static std::optional<Packet> Deserialize(const uint8_t* beg, const uint8_t* end, Opcode opcode = Opcode::Mesh);
+};
+
+/* payload of an `Opcode::Declare` frame or batch record:
+
+    | id(u32) | name |
+
+   The id stands for the name in later packets of the same connection. Ids
+   are picked by the sender, small and dense; redeclaring one rebinds it.
+   Receivers refuse ids from `MaxIds` on, past that senders send names in full. */
+struct NameDeclaration final {
+    static constexpr uint32_t MaxIds = 1 << 16;
+
+    uint32_t id = 0;
+    std::string_view name;
+
+    void SerializeTo(std::vector<uint8_t>& buf) const;
+};
+
+/* a `Mesh`, `Append`, `Replace` or `Transform` payload still sitting in the receive buffer,
+   only valid while the handler it was given to runs.
+
+   `Parse` also reads `Declare` payloads into `nameId` and `name`, the
+   receivers apply those and never hand them on.
+
+   Positions stay in wire format until `DecodeTo` converts them straight into
+   their final storage, so a vertex is touched once after it was received.
+*/
+struct PacketView final {
+    Opcode opcode = Opcode::Mesh;
+    Mesh::Type type;
+    PositionEncoding encoding = PositionEncoding::Float64;
+    uint32_t offset = 0;
+    Vec3 color;
+    std::string_view name;
+    uint32_t nameId = Packet::NoNameId;     // the sender's id if the name went as one
+    uint32_t id = NameTable::None;          // `NameTable` id of `name`, set by the receivers
+    const uint8_t* positions = nullptr;     // `count` vertices in `encoding`
+    uint32_t count = 0;
+    uint8_t attributes = 0;                 // `Packet::Attr*` bits
+    const uint8_t* colors = nullptr;
+    const uint8_t* normals = nullptr;
+    const uint8_t* indices = nullptr;
+    uint32_t indexCount = 0;
+    const uint8_t* transform = nullptr;     // `Opcode::Transform` only, 12 floats
+
+    //! @brief `std::nullopt` if the payload is cut short or has an unknown encoding
+    static std::optional<PacketView> Parse(const uint8_t* beg, const uint8_t* end, Opcode opcode = Opcode::Mesh);
+
+    //! @brief convert the positions into viewer coordinates(y and z swapped)
+    //! @param out room for `count` vertices
+    void DecodeTo(Vertex* out) const;
+
+    //! @param out room for `count` colors, only if `colors` is set
+    void DecodeColorsTo(glm::vec3* out) const;
+
+    //! @brief like `DecodeTo`, only if `normals` is set
+    void DecodeNormalsTo(Vec3* out) const;
+
+    //! @brief widen the indices to u32 and add `base` to each
+    //! @return false if one of them isn't below `limit`
+    bool DecodeIndicesTo(uint32_t* out, uint32_t base, uint32_t limit) const;
+
+    //! @brief the transform in viewer coordinates(y and z swapped), only if `transform` is set
+    glm::mat4 DecodeTransform() const;
+
+    //! @brief copy the packet out of the buffer
+    //! @param viewer swap y and z like `DecodeTo`, otherwise keep the sender's coordinates
+    Packet ToPacket(bool viewer) const;
+};
+
+/* payload of an `Opcode::Batch` frame:
+
+    | count(u32) | record ... |    record: | opcode(u8) | length(u32) | payload(length bytes) |
+
+   so lots of small meshes share one frame header and one receive pass. */
+struct Batch final {
+    //! @brief builds a batch payload at the end of a buffer record by record
+    class Writer final {
+    public:
+        explicit Writer(std::vector<uint8_t>& buf);
+
+        void Add(const Packet& packet, uint32_t nameId = Packet::NoNameId);
+        void Add(const NameDeclaration& declaration);
+
+    private:
+        std::vector<uint8_t>& buf_;
+        size_t countPos_;
+        uint32_t count_ = 0;
+
+        size_t beginRecord();
+        void endRecord(size_t recordPos, Opcode opcode);
+    };
+
+    //! @brief append a batch payload holding `packets` to `buf`
+    static void SerializeTo(std::vector<uint8_t>& buf, const Packet* packets, size_t count);
+
+    //! @brief append a view of every record to `views`, bad records are skipped
+    //! @return false if the record list itself is cut short or garbled
+    static bool Parse(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views);
+};
+
+//! a batch counts as one packet
+struct SenderStats final {
+    uint64_t sentPackets = 0;
+    uint64_t sentBytes = 0;
+    uint64_t droppedPackets = 0;
+    uint64_t droppedBytes = 0;
+};
+
+//! @brief where a `NetSender` delivers its frames
+struct Endpoint final {
+    enum class Kind {
+        Tcp,
+        Unix,   // Unix domain stream socket, cheaper than loopback TCP
+        Shm,    // a `ShmRing` created by a debugger on the same host
+        Udp,    // one datagram per packet, lost or late packets are not resent
+    };
+
+    Kind kind = Kind::Tcp;
+    std::string host = "localhost";
+    uint32_t port = 8999;
+    std::string name;   // socket file or shared memory segment name
+
+    static Endpoint Tcp(const std::string& host, uint32_t port) {
+        Endpoint endpoint;
+        endpoint.host = host;
+        endpoint.port = port;
+        return endpoint;
+    }
+
+    static Endpoint Udp(const std::string& host, uint32_t port) {
+        Endpoint endpoint;
+        endpoint.kind = Kind::Udp;
+        endpoint.host = host;
+        endpoint.port = port;
+        return endpoint;
+    }
+
+    static Endpoint Unix(const std::string& path) {
+        Endpoint endpoint;
+        endpoint.kind = Kind::Unix;
+        endpoint.name = path;
+        return endpoint;
+    }
+
+    static Endpoint Shm(const std::string& name) {
+        Endpoint endpoint;
+        endpoint.kind = Kind::Shm;
+        endpoint.name = name;
+        return endpoint;
+    }
 };
 
+/* sends packets to the debugger.
+
+   By default `SendPacket` writes to the socket before returning. With an
+   `AsyncConfig` it only serializes the packet into a bounded lock-free queue,
+   a background thread drains the queue and coalesces frames into large
+   writes, so producer threads never wait for the socket.
+
+   Over UDP each packet is a sequenced datagram of its own; packets bigger
+   than `MaxDatagram` are dropped, send those over a stream endpoint. So are
+   `Append`/`Replace` packets, a lost or reordered one would corrupt the mesh.
+
+   With `SetNameInterning` the first frame using a name declares an id for it
+   (turning into a batch if needed), later packets carry the 4 byte id.
+*/
 class NetSender final {
 public:
+    enum class OverflowPolicy {
+        Block,          // wait until the flusher makes room
+        DropOldest,     // throw away the oldest queued packet
+    };
+
+    //! largest UDP payload over IPv4
+    static constexpr size_t MaxDatagram = 65507;
+
+    struct AsyncConfig {
+        size_t queueCapacity = 4096;
+        OverflowPolicy policy = OverflowPolicy::DropOldest;
+        size_t maxBatchBytes = 256 * 1024;
+    };
+
     NetSender(std::unique_ptr<net::Net>& net, uint32_t port);
+    NetSender(std::unique_ptr<net::Net>& net, uint32_t port, const AsyncConfig& config);
+    NetSender(std::unique_ptr<net::Net>& net, const Endpoint& endpoint);
+    NetSender(std::unique_ptr<net::Net>& net, const Endpoint& endpoint, const AsyncConfig& config);
     ~NetSender();
+
+    //! @brief thread safe in async mode
     void SendPacket(const Packet&);
 
+    //! @brief send many packets as one `Opcode::Batch` frame, thread safe in async mode
+    void SendBatch(const std::vector<Packet>& packets);
+
+    //! @brief wait until every queued packet is sent or dropped, no-op in sync mode
+    void Flush();
+
+    //! @brief compress payloads of at least `threshold` bytes, 0 turns it off.
+    //! Worth it when the link is slower than a few hundred MB/s, e.g. a tunnel to a remote node
+    //! @note call before sending
+    void SetCompression(size_t threshold = BlockCodec::DefaultThreshold) {
+        compressAbove_ = threshold;
+    }
+
+    //! @brief send every name once, then refer to it by id.
+    //! Refused over UDP and with `OverflowPolicy::DropOldest`: a lost declaration would orphan its id
+    //! @note call before sending
+    void SetNameInterning(bool enable);
+
+    SenderStats Stats() const;
+
 private:
-    net::Socket* socket_;
+    // ids handed out by this sender, `declared` once the declaring frame is queued.
+    // Until then other threads still send the name in full
+    struct NameIds {
+        struct Entry {
+            uint32_t id;
+            bool declared;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    // per send bookkeeping of `serialize`, kept so steady state sends don't allocate
+    struct NameScratch {
+        std::vector<uint32_t> ids;      // id each packet is sent with
+        std::vector<size_t> fresh;      // packets that declare their name
+    };
+
+    net::Socket* socket_ = nullptr;
+    std::unique_ptr<ShmRing> shm_;
+    bool datagram_ = false;
+    uint32_t session_ = 0;
+    std::atomic<uint32_t> sequence_ = 0;
+    size_t compressAbove_ = 0;
+    std::vector<uint8_t> sendBuf_;
+    std::vector<uint8_t> compressBuf_;
+    std::unique_ptr<NameIds> names_;
+    NameScratch scratch_;               // of the sync send
+
+    struct AsyncState {
+        AsyncConfig config;
+        BoundedQueue<std::vector<uint8_t>> queue;
+        BoundedQueue<std::vector<uint8_t>> spare;     // recycled frame buffers
+        std::thread flusher;
+        std::atomic<bool> running = true;
+        std::atomic<uint64_t> queued = 0;
+        QueueSignal filled;     // a frame was queued or the sender stops, wakes the flusher
+        QueueSignal drained;    // frames left the queue, wakes blocked producers and `Flush`
+
+        AsyncState(const AsyncConfig& config)
+            : config(config), queue(config.queueCapacity), spare(config.queueCapacity) {}
+    };
+    std::unique_ptr<AsyncState> async_;
+
+    std::atomic<uint64_t> sentPackets_ = 0;
+    std::atomic<uint64_t> sentBytes_ = 0;
+    std::atomic<uint64_t> droppedPackets_ = 0;
+    std::atomic<uint64_t> droppedBytes_ = 0;
+
+    void connect(std::unique_ptr<net::Net>& net, const Endpoint& endpoint);
+    bool write(const net::IoSlice* slices, size_t count);
+    size_t headerSize() const;
+    void writeHeader(uint8_t* buf, Opcode opcode, size_t payloadSize, uint16_t flags);
+    //! @return the opcode the payload really is, declarations turn a single packet into a batch
+    Opcode serialize(std::vector<uint8_t>& buf, Opcode opcode, const Packet* packets, size_t count,
+                     NameScratch& scratch);
+    void markDeclared(const Packet* packets, const std::vector<size_t>& fresh);
+    void send(Opcode opcode, const Packet* packets, size_t count);
+    void enqueue(Opcode opcode, const Packet* packets, size_t count);
+    void flushLoop();
 };
 
 class NetRecv final {
 public:
+    //! sees the packets of one read, the views are only valid during the call
+    using Visitor = std::function<void(const std::vector<PacketView>&)>;
+
     NetRecv(std::unique_ptr<net::Socket>&& client): client_(std::move(client)) { }
     ~NetRecv();
+
+    //! @brief read once from the socket and decode all finished packets
     std::vector<Packet> RecvPacket();
+
+    //! @brief like above, without copying the packets out of the receive buffer
+    void RecvPacket(const Visitor& visit);
+
+    //! @brief like `RecvPacket`, but the bytes come from `fill(buf, size)` instead of the socket
+    //! @param fill writes at most `size` bytes to `buf` and returns how many, <= 0 if none
+    template <typename F>
+    void RecvWith(F&& fill, const Visitor& visit) {
+        // read straight into the buffer, leaving room for the whole unfinished frame
+        uint8_t* ptr = buffer_.Prepare(std::max(MinRead, pendingBytes_.load(std::memory_order_relaxed)));
+        auto len = fill(ptr, buffer_.Writable());
+        if (len <= 0) {
+            return;
+        }
+        buffer_.Commit(len);
+        bytesReceived_ += len;
+
+        // the views point into `buffer_`, visit them before consuming
+        views_.clear();
+        const uint8_t* consumed = splitFrames(buffer_.Data(), buffer_.Data() + buffer_.Size(), views_);
+        if (!views_.empty()) {
+            visit(views_);
+        }
+        buffer_.Consume(consumed - buffer_.Data());
+    }
+
+    //! @brief read once from the socket without decoding, bytes are appended to `out`
+    //! @return bytes read, 0 if nothing available, -1 if the connection is closed
+    int RecvBytes(std::vector<uint8_t>& out);
+
+    //! @brief decode bytes previously read by `RecvBytes`
+    std::vector<Packet> Feed(const uint8_t* beg, const uint8_t* end);
+
+    //! @brief like above, the views may point into `[beg, end)`
+    void Feed(const uint8_t* beg, const uint8_t* end, const Visitor& visit);
+
+    //! @brief start over with a new sender: drop the unfinished frame and the names it declared
+    void Reset();
+
+    //! @brief deserialize a `Mesh`, `Append` or `Replace` payload into viewer coordinates
+    static std::optional<Packet> DecodeMesh(const uint8_t* beg, const uint8_t* end, Opcode opcode = Opcode::Mesh);
+
+    uint64_t BytesReceived() const {
+        return bytesReceived_;
+    }
+
+    net::SocketHandle Handle() const {
+        return client_ ? client_->Handle() : net::InvalidSocket;
+    }
+
     operator bool() const {
         return client_ && client_->Valid();
     }
 
 private:
-    std::vector<uint8_t> cache_;
+    static constexpr size_t MinRead = 64 * 1024;
+
+    RecvBuffer buffer_;
     std::unique_ptr<net::Socket> client_;
+    std::vector<PacketView> views_;     // reused by every read
+    // decompressed payloads of the current read, one each so the views stay valid
+    std::vector<std::vector<uint8_t>> inflated_;
+    size_t inflatedUsed_ = 0;
+    // the sender's name ids, resolved once when declared
+    struct DeclaredName {
+        uint32_t id = NameTable::None;
+        std::string_view name;
+    };
+    std::vector<DeclaredName> names_;
+    uint64_t bytesReceived_ = 0;
+    size_t legacyScanned_ = 0;  // bytes of an unfinished "BEG" frame already searched for "END"
+    // bytes still missing from an unfinished frame. Written by the decoding thread, read by the one receiving
+    std::atomic<size_t> pendingBytes_ = 0;
 
-    std::optional<Packet> analyzePacket(const uint8_t* beg, const uint8_t* end);
-    std::pair<bool, const uint8_t*> splitOnePacket(const uint8_t* beg, const uint8_t* end);
+    int recvInto(uint8_t* buf, size_t size);
+    const uint8_t* splitFrames(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views);
+    void analyzeFrame(const FrameHeader& header, const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views);
+    //! @brief apply the declarations in `views[first..]`, give every packet its `NameTable` id
+    void resolveNames(std::vector<PacketView>& views, size_t first);
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* bulk conversion of wire positions(xyz triples) into packed float triples.
+
+   The y/z swap into viewer coordinates happens in the same pass. On x86-64
+   the SSE2 kernel is always there, the AVX2 one is picked at runtime when
+   the CPU has it; other targets use the scalar loop.
+*/
+enum class DecodeKernel {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+//! @brief the fastest kernel this CPU runs, detected once
+DecodeKernel BestDecodeKernel();
+
+const char* DecodeKernelName(DecodeKernel kernel);
+
+//! @brief convert `count` double triples at `src`(unaligned) to float triples at `dst`
+void DecodeFloat64Positions(const uint8_t* src, size_t count, bool swapYZ, float* dst,
+                            DecodeKernel kernel = BestDecodeKernel());
+
+//! @brief copy `count` float triples at `src`(unaligned) to `dst`
+void DecodeFloat32Positions(const uint8_t* src, size_t count, bool swapYZ, float* dst,
+                            DecodeKernel kernel = BestDecodeKernel());
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "pch.hpp"
+#include "netdata.hpp"
+#include "uring.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//! @brief per-connection counters, a snapshot taken by `Reactor::Stats`
+struct ConnectionStats final {
+    uint64_t id;
+    uint64_t bytes;
+    uint64_t packets;
+    double seconds;       // time since the connection was accepted
+    double avgLatencyMs;  // socket readiness -> packets handled
+    double maxLatencyMs;
+    uint64_t pauses;      // times its reads were paused because its worker fell behind
+
+    double MBPerSecond() const {
+        return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0;
+    }
+};
+
+/* One I/O thread multiplexing the listeners and every client socket.
+
+   Decoded packets are given to `PacketHandler` as views into the receive
+   buffer, copy out whatever must outlive the call. With `decodeThreads == 0`
+   the handler runs on the I/O thread, otherwise raw bytes are handed to a
+   worker pool; a connection always goes to the same worker so its packets
+   keep their order. A worker queues at most `SetWorkerQueueLimit` bytes: past
+   that the reactor stops reading its connections until it has caught up to
+   half of it, and the senders' kernel buffers fill up instead. With
+   `Backend::Uring` the reads already completed when the pause lands are still
+   queued, so the limit is overshot by up to one batch of completions.
+
+   `Backend::Uring` receives through `IoUring` instead of readiness polling
+   plus a `recv` per read, and falls back to `Backend::Poll` when the
+   kernel doesn't support it.
+*/
+class Reactor final {
+public:
+    using PacketHandler = std::function<void(const std::vector<PacketView>&)>;
+    using Clock = std::chrono::steady_clock;
+
+    enum class Backend {
+        Poll,
+        Uring,
+    };
+
+    Reactor(PacketHandler handler, uint32_t decodeThreads = 0, Backend backend = Backend::Poll);
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+    ~Reactor();
+
+    //! @brief accept clients from `listener` on the I/O thread. The reactor doesn't own it
+    //! @note call before `Start`, may be called for several listeners(e.g. a TCP port and a Unix domain socket)
+    bool Listen(net::Socket* listener);
+
+    //! @brief hand an already connected client to the reactor, thread safe
+    void Add(std::unique_ptr<net::Socket>&& client);
+
+    //! @brief bytes a decode worker may have queued before its connections are paused
+    //! @note call before `Start`
+    void SetWorkerQueueLimit(size_t bytes) {
+        queueLimit_ = bytes;
+    }
+
+    void Start();
+    void Stop();
+
+    std::vector<ConnectionStats> Stats() const;
+
+    //! @brief the backend in use, after a possible fallback
+    Backend ActiveBackend() const {
+        return uring_ ? Backend::Uring : Backend::Poll;
+    }
+
+private:
+    struct Connection {
+        uint64_t id;
+        net::SocketHandle handle = net::InvalidSocket;
+        NetRecv recv;
+        Clock::time_point connectedAt;
+        std::atomic<uint64_t> bytes = 0;
+        std::atomic<uint64_t> packets = 0;
+        std::atomic<uint64_t> latencyCount = 0;
+        std::atomic<uint64_t> latencySumUs = 0;
+        std::atomic<uint64_t> latencyMaxUs = 0;
+        std::atomic<uint64_t> pauses = 0;
+        std::atomic<bool> paused = false;   // changed under its worker's mutex
+        bool armed = false;     // a recv is in flight, `Backend::Uring` only, I/O thread only
+
+        Connection(uint64_t id, std::unique_ptr<net::Socket>&& client)
+            : id(id), recv(std::move(client)), connectedAt(Clock::now()) {}
+
+        void RecordLatency(Clock::time_point readyAt);
+    };
+
+    struct Job {
+        std::shared_ptr<Connection> conn;
+        std::vector<uint8_t> bytes;
+        Clock::time_point readyAt;
+    };
+
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<Job> jobs;
+        size_t queuedBytes = 0;
+        std::vector<std::shared_ptr<Connection>> paused;
+    };
+
+    PacketHandler handler_;
+    net::Poller poller_;
+    std::unique_ptr<IoUring> uring_;
+    std::vector<uint64_t> unarmed_;     // connections waiting for their recv to be armed, guarded by `connMutex_`
+    std::vector<net::Socket*> listeners_;
+    std::thread ioThread_;
+    std::atomic<bool> running_ = false;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    size_t queueLimit_ = 16 * 1024 * 1024;
+    int reserveFd_ = -1;    // given up to refuse a client when out of descriptors, POSIX only
+    int wakeFd_ = -1;       // eventfd telling `runUring` about connections to arm again
+
+    mutable std::mutex connMutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<Connection>> conns_;
+    uint64_t nextId_ = 1;
+
+    void run();
+    void runUring();
+    void workerRun(Worker& worker);
+    void acceptAll();
+    bool refuse(net::Socket& listener, int error);
+    //! @brief hand `job` to the connection's worker, pausing the connection if that one is full
+    void queue(const std::shared_ptr<Connection>& conn, Job&& job);
+    void resume(const std::shared_ptr<Connection>& conn);
+    void arm(Connection& conn);
+    void onReadable(const std::shared_ptr<Connection>& conn);
+    void onReceived(const std::shared_ptr<Connection>& conn, const IoUring::Completion& completion,
+                    Clock::time_point readyAt);
+    void close(const std::shared_ptr<Connection>& conn);
+};
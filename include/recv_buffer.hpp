@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/* growable receive buffer.
+
+   Unread bytes are always contiguous in `[Data(), Data() + Size())`, so a
+   whole frame can be decoded in place. Space is taken back lazily: the read
+   and write offsets reset when everything is consumed, and the unread tail is
+   only slid to the front (or the buffer grown) when a read needs more room.
+*/
+class RecvBuffer final {
+public:
+    explicit RecvBuffer(size_t capacity = 64 * 1024)
+        : buf_(new uint8_t[capacity]), capacity_(capacity) {}
+
+    RecvBuffer(const RecvBuffer&) = delete;
+    RecvBuffer& operator=(const RecvBuffer&) = delete;
+    RecvBuffer(RecvBuffer&&) = default;
+    RecvBuffer& operator=(RecvBuffer&&) = default;
+
+    const uint8_t* Data() const { return buf_.get() + read_; }
+    size_t Size() const { return write_ - read_; }
+    bool Empty() const { return read_ == write_; }
+    size_t Capacity() const { return capacity_; }
+
+    //! @brief make sure at least `atLeast` bytes can be written after the unread data
+    //! @return where to write, `Writable()` bytes are available there
+    uint8_t* Prepare(size_t atLeast) {
+        if (capacity_ - write_ >= atLeast) {
+            return buf_.get() + write_;
+        }
+
+        size_t size = Size();
+        if (size + atLeast <= capacity_) {
+            // enough room once the consumed prefix is dropped
+            memmove(buf_.get(), buf_.get() + read_, size);
+        } else {
+            size_t newCapacity = capacity_;
+            while (newCapacity < size + atLeast) {
+                newCapacity *= 2;
+            }
+            std::unique_ptr<uint8_t[]> newBuf(new uint8_t[newCapacity]);
+            memcpy(newBuf.get(), buf_.get() + read_, size);
+            buf_ = std::move(newBuf);
+            capacity_ = newCapacity;
+        }
+        read_ = 0;
+        write_ = size;
+        return buf_.get() + write_;
+    }
+
+    size_t Writable() const { return capacity_ - write_; }
+
+    //! @brief mark `size` bytes written after `Prepare` as readable
+    void Commit(size_t size) { write_ += size; }
+
+    void Append(const uint8_t* data, size_t size) {
+        memcpy(Prepare(size), data, size);
+        Commit(size);
+    }
+
+    void Consume(size_t size) {
+        read_ += size;
+        if (read_ >= write_) {
+            read_ = write_ = 0;
+        }
+    }
+
+private:
+    std::unique_ptr<uint8_t[]> buf_;
+    size_t capacity_;
+    size_t read_ = 0;
+    size_t write_ = 0;
+};
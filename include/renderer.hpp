@@ -21,12 +21,14 @@ public:
 
     void SetLineWidth(int width) { GL_CALL(glLineWidth(width)); }
 
-    void Draw(const Mesh& mesh, const glm::mat4& model, const glm::vec3& color);
+    void Draw(const MeshView& mesh, const glm::mat4& model, const glm::vec3& color);
 
 private:
     std::unique_ptr<Camera> camera_;
     std::unique_ptr<Shader> shader_;
     std::unique_ptr<Buffer> arrayBuffer_;
+    std::unique_ptr<Buffer> colorBuffer_;
+    std::unique_ptr<Buffer> normalBuffer_;
     std::unique_ptr<Buffer> indicesBuffer_;
     GLuint vao_;
 
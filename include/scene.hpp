@@ -0,0 +1,368 @@
+#pragma once
+
+#include "pch.hpp"
+#include "mesh.hpp"
+#include "netdata.hpp"
+#include "bounded_queue.hpp"
+#include "slot_map.hpp"
+#include "scene_cache.hpp"
+#include "geom.hpp"
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+struct SceneGroup;
+
+//! @brief memory of a `Scene`, for monitoring. Approximate: the objects and their meshes, not their
+//! names in `NameTable` nor meshes only older snapshots still hold
+struct SceneMemoryStats final {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+    size_t budget = 0;      // 0 for none
+    size_t spilled = 0;     // objects in the cache file
+    uint64_t cacheBytes = 0;
+};
+
+/* the scene as the render thread sees it, published by `Scene::Publish`.
+
+   Immutable: a snapshot shares every object that didn't change since the
+   previous one, and the meshes with the scene itself. It's freed when the
+   last frame drawing it lets go.
+*/
+struct SceneSnapshot final {
+    struct Object final {
+        // keeps the arrays of `mesh` alive. The scene may append to it meanwhile, read it only through `mesh`
+        std::shared_ptr<const Mesh> storage;
+        MeshView mesh;                      // empty while spilled
+        std::string_view name;              // points into `NameTable`
+        uint32_t id = NameTable::None;
+        glm::vec3 color;
+        glm::mat4 transform = glm::mat4(1.0f);
+        AABB bounds;
+        bool selected = false;
+        bool spilled = false;
+    };
+
+    struct Group final {
+        std::string_view path;  // points into `NameTable`, empty for the root
+        std::string_view name;  // last segment of `path`
+        glm::vec3 color = glm::vec3(1.0f);
+        AABB bounds;
+        bool hidden = false;
+        uint32_t objectBegin = 0;   // its own objects are `objects[objectBegin, objectEnd)`
+        uint32_t objectEnd = 0;
+        uint32_t end = 0;           // the groups below it are `groups[this + 1, end)`
+    };
+
+    std::vector<Group> groups;      // depth first, the root first
+    std::vector<std::shared_ptr<const Object>> objects;    // in the order of their groups
+    SceneMemoryStats memory;
+
+    //! @return nullptr if there is no object named `id`. Walks every object
+    const Object* Find(uint32_t id) const;
+
+    //! @brief call `fn(const Object&)` for every object that is drawn: not spilled, not in a
+    //! hidden group and not certainly outside the clip volume of `clip`(projection * view * model)
+    template <typename Fn>
+    void ForEachVisible(const glm::mat4& clip, Fn&& fn) const {
+        for (uint32_t i = 0; i < groups.size();) {
+            const auto& group = groups[i];
+            if (group.hidden || OutsideClip(group.bounds, clip)) {
+                i = group.end;
+                continue;
+            }
+            for (uint32_t j = group.objectBegin; j < group.objectEnd; j++) {
+                if (!objects[j]->spilled && !OutsideClip(objects[j]->bounds, clip)) {
+                    fn(*objects[j]);
+                }
+            }
+            i++;
+        }
+    }
+};
+
+struct RenderData final {
+    std::string_view name;  // points into `NameTable`
+    uint32_t id = NameTable::None;  // `NameTable` id of `name`
+    // shared with the snapshots showing it. `Scene` only appends to it in place, past what they show
+    // and without reallocating, and copies it for anything else
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    glm::vec3 color;
+    glm::mat4 transform = glm::mat4(1.0f);  // set by `Opcode::Transform`, vertices stay in the mesh's own space
+    bool selected = false;
+
+    // memory accounting, kept up to date by `Scene`
+    size_t cpuBytes = 0;        // this and everything it owns on the heap
+    size_t gpuBytes = 0;        // uploaded to draw it
+    uint64_t updated = 0;       // `Scene` tick of the last change, the oldest are evicted first
+    std::optional<std::list<uint32_t>::iterator> lru;   // place in `Scene`'s eviction order, unless it can't be
+    std::optional<SceneCache::Entry> spilled;  // evicted to the cache, `mesh` is empty until restored
+    bool pinned = false;        // restored by `Scene::Restore`, not evicted again before its next update
+
+    // place in the name hierarchy, kept by `Scene`
+    SceneGroup* group = nullptr;    // "a/b" of "a/b/c"
+    uint32_t groupIndex = 0;        // in `group->objects`
+    AABB bounds;                    // of the mesh moved by `transform`, see `Scene::BoundsOf`
+    bool boundsDirty = true;
+
+    // what the last snapshot shows of it, reset by every change
+    std::shared_ptr<const SceneSnapshot::Object> published;
+
+    RenderData() = default;
+
+    RenderData(Mesh mesh, glm::vec3 color, std::string_view name)
+        : name(name), mesh(std::make_shared<Mesh>(std::move(mesh))), color(color) {}
+};
+
+/* a node of the name hierarchy: "solver/iter12/contacts" is the object
+   "contacts" in group "iter12" in group "solver" in the root. Groups are
+   made for the first object under them and go away with the last one.
+*/
+struct SceneGroup final {
+    std::string name;       // path segment
+    std::string_view path;  // "solver/iter12", empty for the root. Points into `NameTable`
+    SceneGroup* parent = nullptr;
+    std::map<std::string, std::unique_ptr<SceneGroup>, std::less<>> children;   // sorted for the UI
+    std::vector<SlotMap<RenderData>::Handle> objects;
+    bool hidden = false;    // hides everything below
+    glm::vec3 color = glm::vec3(1.0f);  // set by `Scene::RecolorGroup`
+
+    // of everything below, see `Scene::BoundsOf`. A dirty group's parents are dirty too
+    AABB bounds;
+    bool boundsDirty = false;
+};
+
+/* one change to the scene. It owns everything it needs: the thread that
+   received the packet decodes it, the scene thread only moves or copies the
+   result into place.
+*/
+struct SceneCommand final {
+    using Clock = std::chrono::steady_clock;
+
+    enum class Kind: uint8_t {
+        Mesh,       // replace the object with `mesh`, keeping its transform
+        Append,     // add `mesh`'s vertices and attributes after the object's, indices are relative to them
+        Replace,    // overwrite the object's vertices from `offset` on
+        Transform,
+        Remove,
+        Clear,      // remove every object
+        Select,     // the UI's, for an existing object only
+        Deselect,
+        Restore,    // read a spilled mesh back
+        HideGroup,  // of the group at path `name`
+        ShowGroup,
+        RecolorGroup,   // with `color`
+        RemoveGroup,
+    };
+
+    Kind kind = Kind::Mesh;
+    uint32_t id = NameTable::None;
+    std::string_view name;      // points into `NameTable`
+    Mesh mesh;                  // type and color are used when the object doesn't exist yet
+    glm::vec3 color;
+    uint32_t offset = 0;
+    glm::mat4 transform = glm::mat4(1.0f);
+    Clock::time_point queued;   // set by `SceneQueue::Push`
+
+    //! @brief decode a received packet, in viewer coordinates
+    //! @return `std::nullopt` if it's dropped(a mesh with indices out of range)
+    static std::optional<SceneCommand> FromPacket(const PacketView& packet);
+};
+
+/* the debugger's objects, owned by the scene thread(`SceneQueue::Start`).
+
+   They are packed in a `SlotMap`. Names map to handles through an array
+   indexed by `NameTable` id, so applying a command doesn't hash. `Publish`
+   hands the render thread an immutable `SceneSnapshot`: it draws that without
+   any lock while the next commands are applied. Snapshots see a mesh through
+   a `MeshView`, so appending to a published mesh writes past the end of what
+   they show; only a reallocation or an overwrite copies it, with room for
+   the appends to come.
+
+   With a memory budget, the least recently updated meshes are spilled to a
+   `SceneCache` file once the objects take more than that, down to 3/4 of it
+   so not every later update evicts again. A spilled object keeps its name,
+   transform and color and isn't drawn; a command for it or `Restore` reads
+   its mesh back.
+
+   Names are split at '/' into a tree of `SceneGroup`s. Hiding a group is a
+   flag, removing or recoloring one touches only what is below it. Bounds of
+   objects and groups are cached and recomputed when published after a change
+   below them, so drawing skips whole groups that are off screen.
+*/
+class Scene final {
+public:
+    using Handle = SlotMap<RenderData>::Handle;
+
+    Scene();
+
+    void Apply(SceneCommand& command);
+
+    //! @brief make the objects as they are now the `Latest` snapshot
+    void Publish();
+
+    //! @brief the last published snapshot. Thread safe, never waits for the scene thread
+    std::shared_ptr<const SceneSnapshot> Latest() const;
+
+    //! @brief whether `Latest` was called since the last `Publish`, publishing before only costs copies
+    bool LatestTaken() const {
+        return taken_.load(std::memory_order_relaxed);
+    }
+
+    //! @brief every object, packed, in no particular order
+    std::vector<RenderData>& Objects() { return objects_.Values(); }
+
+    //! @brief the object named `id`(a `NameTable` id), a null handle if there is none
+    Handle Find(uint32_t id) const {
+        return id < byName_.size() ? byName_[id] : Handle{};
+    }
+
+    //! @return nullptr once the object was removed
+    RenderData* Get(Handle handle) { return objects_.Get(handle); }
+
+    //! @brief keep the objects under `bytes`, spilling meshes to a new cache file in `cacheDirectory`
+    //! @param bytes 0 for no limit
+    //! @param cacheDirectory only used by the first call with a limit
+    void SetMemoryBudget(size_t bytes, const std::string& cacheDirectory);
+
+    //! @brief read a spilled mesh back, it stays until it's updated again even over the budget:
+    //! what the UI looks at isn't evicted the moment something else is restored
+    //! @return false if the cache couldn't read it, the object is left empty
+    bool Restore(RenderData& data);
+
+    SceneMemoryStats Memory() const;
+
+    SceneGroup& Root() { return root_; }
+
+    //! @return nullptr if there is no object under `path`
+    SceneGroup* FindGroup(std::string_view path);
+
+    //! @brief remove every object below `group`, and the group itself unless it's the root
+    void RemoveGroup(SceneGroup& group);
+
+    //! @brief give every object below `group` the color `color`. Per vertex colors stay
+    void RecolorGroup(SceneGroup& group, const glm::vec3& color);
+
+    //! @brief bounds of everything below `group`, empty if there are no vertices
+    const AABB& BoundsOf(SceneGroup& group);
+    const AABB& BoundsOf(RenderData& data);
+
+private:
+    SlotMap<RenderData> objects_;
+    std::vector<Handle> byName_;    // by `NameTable` id
+
+    size_t budget_ = 0;
+    std::unique_ptr<SceneCache> cache_;
+    size_t cpuBytes_ = 0;
+    size_t gpuBytes_ = 0;
+    size_t spilled_ = 0;
+    uint64_t tick_ = 0;
+    std::list<uint32_t> lru_;       // ids of the objects `evict` may spill, least recently updated first
+
+    SceneGroup root_;
+
+    std::shared_ptr<const SceneSnapshot> latest_;  // only through `std::atomic_load`/`std::atomic_store`
+    mutable std::atomic<bool> taken_ = false;
+
+    //! @brief the object `command` is for, an empty one of its type if there is none
+    RenderData& objectOf(const SceneCommand& command);
+    //! @brief the mesh of `data` to apply the range `command` to, copied first if that would
+    //! change what a snapshot may still show
+    Mesh& editMesh(RenderData& data, const SceneCommand& command);
+    void publish(SceneGroup& group, SceneSnapshot& snapshot);
+    //! @brief the group of `name`, made if there is none
+    SceneGroup& groupOf(std::string_view name);
+    //! @brief forget the object, everything but taking it out of its group
+    void release(RenderData& data);
+    //! @brief drop `group` and its parents while they are empty
+    void prune(SceneGroup* group);
+    void boundsChanged(SceneGroup* group);
+    bool restore(RenderData& data);
+    void drop(RenderData& data);
+    //! @brief recount the object's bytes, `touch` marks it updated
+    void account(RenderData& data, bool touch);
+    //! @brief take the object out of the eviction order, it's back with its next update
+    void unlist(RenderData& data);
+    void evict();
+    //! @brief rewrite the cache file once it's mostly dead records
+    void compactCache();
+};
+
+//! @brief counters of a `SceneQueue`, for monitoring
+struct SceneQueueStats final {
+    size_t depth;           // commands waiting, approximate
+    uint64_t applied;
+    double avgLatencyMs;    // pushed -> applied
+    double maxLatencyMs;
+};
+
+/* carries `SceneCommand`s from the receiving threads and the UI to the scene.
+
+   Receivers push onto a bounded lock-free queue(`BoundedQueue`) and wait
+   while it's full. The UI posts to a small locked list of its own instead,
+   so the render thread never waits for the receivers' backlog. The scene
+   thread started by `Start` applies the posted commands, then drains the
+   queue for at most a time budget at a time. It publishes a snapshot after
+   a round that changed something once the render thread took the previous
+   one, or right away when it runs out of work, and then sleeps until
+   something is pushed or posted. A render thread stuck in a modal dialog
+   doesn't hold up the receivers. Commands of one producer are applied in the
+   order it pushed them. Once closed, pushes fail instead of waiting for a
+   drain that may never come.
+*/
+class SceneQueue final {
+public:
+    explicit SceneQueue(size_t capacity = 4096);
+    SceneQueue(const SceneQueue&) = delete;
+    SceneQueue& operator=(const SceneQueue&) = delete;
+    ~SceneQueue();
+
+    //! @brief thread safe. Waits while the queue is full: a scene thread falling behind
+    //! slows the receivers down, updates are never dropped while it's open
+    //! @return false if the queue is closed, `command` is dropped
+    //! @note never call from the thread that drains, apply its commands with `Scene::Apply`
+    bool Push(SceneCommand command);
+
+    //! @brief thread safe, never waits: for the UI. Unbounded, applied before the pushed commands
+    //! @return false if the queue is closed, `command` is dropped
+    bool Post(SceneCommand command);
+
+    //! @brief drain into `scene` on a thread of its own until `Stop`, `budget` at a time
+    //! @note `scene` then belongs to that thread, others only call `Scene::Latest`
+    void Start(Scene& scene, SceneCommand::Clock::duration budget);
+
+    //! @brief `Close`, then wait for the scene thread to finish its round
+    void Stop();
+
+    //! @brief make every `Push` fail from now on, the ones waiting for room as well.
+    //! Thread safe, close it before stopping the threads that push
+    void Close();
+
+    //! @brief apply the posted commands, then pushed ones until there are none or `budget` is used up,
+    //! at least one
+    //! @return commands applied
+    size_t Drain(Scene& scene, SceneCommand::Clock::duration budget);
+
+    SceneQueueStats Stats() const;
+
+private:
+    BoundedQueue<SceneCommand> queue_;
+    QueueSignal filled_;    // pushed or posted, or closed
+    QueueSignal drained_;   // room in `queue_`, or closed
+    std::mutex postMutex_;
+    std::vector<SceneCommand> posted_;
+    std::atomic<size_t> postedCount_ = 0;
+    std::atomic<bool> closed_ = false;
+    std::thread thread_;
+
+    void apply(Scene& scene, SceneCommand& command);
+
+    std::atomic<uint64_t> applied_ = 0;
+    std::atomic<uint64_t> latencySumUs_ = 0;
+    std::atomic<uint64_t> latencyMaxUs_ = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <fstream>
+#include <string>
+
+/* a file the scene spills evicted meshes to.
+
+   Append only, each mesh is one record:
+
+    | compressed(u8) | type(u8) | attributes(u8) | vertex count(u32) | index count(u32) | arrays |
+
+   with everything after the first byte LZ4 compressed(`BlockCodec`) when it
+   gets smaller. Restored and dropped records are dead space: once there is
+   more of it than of live records `Compact` moves the live ones down, and the
+   file is truncated once nothing in it is live.
+
+   The file gets a random name and is only accessible to this user, nothing
+   can be planted at a known path beforehand.
+*/
+class SceneCache final {
+public:
+    //! @brief where a spilled mesh is
+    struct Entry {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    //! @brief creates a new file `prefix` + random suffix in `directory`, it's removed again on destruction
+    SceneCache(const std::string& directory, const std::string& prefix);
+    SceneCache(const SceneCache&) = delete;
+    SceneCache& operator=(const SceneCache&) = delete;
+    ~SceneCache();
+
+    //! @return std::nullopt if the file can't be written
+    std::optional<Entry> Spill(const Mesh& mesh);
+
+    //! @brief read a mesh back, its record is dropped
+    //! @return std::nullopt if the record can't be read back
+    std::optional<Mesh> Restore(Entry entry);
+
+    //! @brief forget a record that is no longer needed
+    void Drop(Entry entry);
+
+    //! @brief whether dead records take more of the file than live ones
+    bool NeedsCompaction() const { return end_ - live_ > live_; }
+
+    //! @brief move the live records, every one of them in `entries`, to the start of the file and cut it short
+    //! @return false if the file couldn't be rewritten
+    bool Compact(const std::vector<Entry*>& entries);
+
+    //! @brief bytes of records not restored or dropped yet
+    uint64_t LiveBytes() const { return live_; }
+    uint64_t FileBytes() const { return end_; }
+
+    const std::string& Path() const { return path_; }
+
+private:
+    std::string path_;
+    std::fstream file_;
+    uint64_t end_ = 0;
+    uint64_t live_ = 0;
+
+    //! @brief cut the file short at `end_`
+    void truncate();
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "pch.hpp"
+#include "net.hpp"
+#include <atomic>
+#include <functional>
+#include <thread>
+
+struct PacketView;
+
+/* single producer / single consumer byte ring in POSIX shared memory.
+
+   Carries the same frame stream as a TCP connection, so the receiving side
+   decodes it with `NetRecv`. Both sides copy straight into/out of the mapped
+   ring; an empty or full ring is waited on with a futex in the shared header
+   (Linux) or a short sleep elsewhere. Frames bigger than the ring are fine,
+   they just stream through in pieces.
+
+   A producer that dies in the middle of a frame leaves it unfinished. The
+   next producer to attach marks where its bytes start; the consumer reads up
+   to there, then `ProducerChanged` tells it to drop what it was decoding.
+
+   Not available on Windows, `Create`/`Open` return nullptr there.
+*/
+class ShmRing final {
+public:
+    //! @brief create(or replace) the segment, the creator unlinks it on destruction
+    //! @param capacity rounded up to a power of two
+    static std::unique_ptr<ShmRing> Create(const std::string& name, size_t capacity);
+
+    //! @brief attach to a segment made by `Create`, as the producer
+    //! @return nullptr if another producer has it open
+    static std::unique_ptr<ShmRing> Open(const std::string& name);
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+    ~ShmRing();
+
+    //! @brief producer side: copy all slices into the ring, waiting while it's full
+    //! @return false if the consumer closed the ring or died, nothing is written then
+    //! unless it died while the ring was filling up
+    bool Write(const net::IoSlice* slices, size_t count);
+
+    //! @brief consumer side: copy at most `size` bytes out, never past the start of a new producer's bytes
+    //! @param timeoutMs how long to wait when the ring is empty
+    //! @return bytes read, 0 on timeout or when `ProducerChanged`
+    size_t Read(uint8_t* buf, size_t size, int timeoutMs);
+
+    //! @brief consumer side: true once for each new producer, when everything before its bytes is read.
+    //! An unfinished frame of the previous one won't be finished
+    bool ProducerChanged() {
+        return std::exchange(producerChanged_, false);
+    }
+
+    size_t Capacity() const;
+
+private:
+    struct Header;
+
+    std::string name_;
+    Header* header_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t mappedSize_ = 0;
+    bool owner_ = false;
+    bool writer_ = false;
+    uint32_t epoch_ = 0;            // consumer: the producer whose bytes `Read` returns
+    bool producerChanged_ = false;
+
+    ShmRing() = default;
+    static std::unique_ptr<ShmRing> mapSegment(const std::string& name, bool create, size_t capacity);
+    bool claimWriter();
+    bool readerAlive() const;
+    void writeBytes(const uint8_t* src, size_t size);
+};
+
+/* owns a `ShmRing` and a thread decoding it, like `Reactor` does for sockets */
+class ShmReceiver final {
+public:
+    using PacketHandler = std::function<void(const std::vector<PacketView>&)>;
+
+    ShmReceiver(std::unique_ptr<ShmRing>&& ring, PacketHandler handler);
+    ShmReceiver(const ShmReceiver&) = delete;
+    ShmReceiver& operator=(const ShmReceiver&) = delete;
+    ~ShmReceiver();
+
+    void Start();
+    void Stop();
+
+    uint64_t BytesReceived() const { return bytes_; }
+
+private:
+    std::unique_ptr<ShmRing> ring_;
+    PacketHandler handler_;
+    std::thread thread_;
+    std::atomic<bool> running_ = false;
+    std::atomic<uint64_t> bytes_ = 0;
+
+    void run();
+};
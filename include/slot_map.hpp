@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* dense storage with stable handles.
+
+   Values are packed in one array, so walking them is a linear scan with no
+   holes. A handle names a slot that points at its value; removing moves the
+   last value into the hole and repoints its slot, O(1). Each slot counts how
+   often it was reused, a handle to a removed value carries the old count
+   and no longer resolves.
+*/
+template <typename T>
+class SlotMap final {
+public:
+    struct Handle {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const Handle& other) const {
+            return index == other.index && generation == other.generation;
+        }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    Handle Insert(T value) {
+        uint32_t index;
+        if (freeHead_ != None) {
+            index = freeHead_;
+            freeHead_ = slots_[index].dense;
+        } else {
+            index = slots_.size();
+            slots_.push_back(Slot{});
+        }
+        slots_[index].dense = values_.size();
+        values_.push_back(std::move(value));
+        owners_.push_back(index);
+        return Handle{index, slots_[index].generation};
+    }
+
+    //! @return false if `handle` was already removed
+    bool Remove(Handle handle) {
+        if (!Contains(handle)) {
+            return false;
+        }
+        Slot& slot = slots_[handle.index];
+        uint32_t last = values_.size() - 1;
+        if (slot.dense != last) {
+            values_[slot.dense] = std::move(values_[last]);
+            owners_[slot.dense] = owners_[last];
+            slots_[owners_[last]].dense = slot.dense;
+        }
+        values_.pop_back();
+        owners_.pop_back();
+
+        slot.generation ++;
+        slot.dense = freeHead_;
+        freeHead_ = handle.index;
+        return true;
+    }
+
+    bool Contains(Handle handle) const {
+        // a removed value's slot has moved on to the next generation
+        return handle.index < slots_.size() && slots_[handle.index].generation == handle.generation;
+    }
+
+    //! @return nullptr for a removed value, valid until the next `Insert`/`Remove`
+    T* Get(Handle handle) { return Contains(handle) ? &values_[slots_[handle.index].dense] : nullptr; }
+    const T* Get(Handle handle) const { return Contains(handle) ? &values_[slots_[handle.index].dense] : nullptr; }
+
+    //! @brief the handle of `Values()[dense]`
+    Handle HandleAt(size_t dense) const { return Handle{owners_[dense], slots_[owners_[dense]].generation}; }
+
+    //! @brief every value, packed, in no particular order
+    std::vector<T>& Values() { return values_; }
+    const std::vector<T>& Values() const { return values_; }
+
+    size_t Size() const { return values_.size(); }
+
+    void Clear() {
+        while (!values_.empty()) {
+            Remove(HandleAt(values_.size() - 1));
+        }
+    }
+
+private:
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Slot {
+        uint32_t generation = 0;
+        uint32_t dense = None;     // index into `values_`, or the next free slot
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<T> values_;
+    std::vector<uint32_t> owners_;  // slot of each value
+    uint32_t freeHead_ = None;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pch.hpp"
+#include "netdata.hpp"
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <thread>
+
+struct UdpStats final {
+    uint64_t datagrams = 0;
+    uint64_t packets = 0;
+    uint64_t stale = 0;       // older than what was already shown for the same name
+    uint64_t malformed = 0;
+};
+
+/* receives `NetSender` datagrams(`Endpoint::Udp`) on its own thread.
+
+   Every datagram holds one frame, a mesh, a transform or a batch of those;
+   range updates(`Opcode::Append`/`Replace`) count as malformed. A sequenced
+   packet older than the last one accepted for the same name is dropped, so
+   reordered datagrams never roll the scene back.
+*/
+class UdpReceiver final {
+public:
+    using PacketHandler = std::function<void(const std::vector<PacketView>&)>;
+
+    //! @param socket bound UDP socket, the receiver doesn't own it
+    UdpReceiver(net::Socket* socket, PacketHandler handler);
+    UdpReceiver(const UdpReceiver&) = delete;
+    UdpReceiver& operator=(const UdpReceiver&) = delete;
+    ~UdpReceiver();
+
+    void Start();
+    void Stop();
+
+    UdpStats Stats() const;
+
+private:
+    static constexpr size_t BurstBytes = 1024 * 1024;
+
+    net::Socket* socket_;
+    PacketHandler handler_;
+    net::Poller poller_;
+    std::thread thread_;
+    std::atomic<bool> running_ = false;
+
+    // only touched by the receiving thread
+    // a mesh and its transform are ordered apart, a late mesh isn't stale because the transform moved on
+    struct Latest {
+        std::optional<SequenceTag> mesh;
+        std::optional<SequenceTag> transform;
+    };
+    std::vector<Latest> latest_;   // by `NameTable` id
+    // decompressed payloads of the current burst, one per compressed datagram
+    std::vector<std::vector<uint8_t>> inflated_;
+    size_t inflatedUsed_ = 0;
+
+    std::atomic<uint64_t> datagrams_ = 0;
+    std::atomic<uint64_t> packets_ = 0;
+    std::atomic<uint64_t> stale_ = 0;
+    std::atomic<uint64_t> malformed_ = 0;
+
+    void run();
+    void decode(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& packets);
+};
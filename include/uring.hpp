@@ -0,0 +1,66 @@
+#pragma once
+
+#include "pch.hpp"
+#include "net.hpp"
+
+/* minimal io_uring for receiving sockets, Linux only(raw syscalls, no liburing).
+
+   A socket gets one multishot recv that takes its memory from a ring of
+   provided buffers, so a busy connection keeps producing completions without
+   a syscall per read; one `Wait` submits and reaps everything.
+
+   `Create` returns nullptr when the kernel or the build lacks io_uring or
+   multishot recv(Linux 6.0), callers fall back to `net::Poller` then. If the
+   kernel refuses to register the buffer ring, buffers are handed back with
+   `IORING_OP_PROVIDE_BUFFERS` instead, one extra request per read but still
+   no extra syscall.
+   Not thread safe, meant to be owned by one I/O thread.
+*/
+class IoUring final {
+public:
+    struct Completion {
+        uint64_t userData;
+        int result;         // bytes received, 0 on EOF, -errno on error
+        bool more;          // the multishot request stays armed
+        int bufferId;       // >= 0 when `result` bytes are in `Buffer(bufferId)`
+    };
+
+    //! @param bufferCount rounded up to a power of two
+    static std::unique_ptr<IoUring> Create(uint32_t entries = 256, uint32_t bufferCount = 256,
+                                           uint32_t bufferSize = 64 * 1024);
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+    ~IoUring();
+
+    //! @brief arm a multishot recv on `s`, its completions carry `userData`
+    bool Recv(net::SocketHandle s, uint64_t userData);
+
+    //! @brief arm a multishot readability poll on `s`
+    bool PollIn(net::SocketHandle s, uint64_t userData);
+
+    //! @brief cancel every request armed with `userData`, do it before closing the socket
+    bool Cancel(uint64_t userData);
+
+    //! @brief hand queued requests to the kernel now instead of at the next `Wait`
+    void Submit();
+
+    //! @brief submit queued requests and wait for completions
+    //! @param completions cleared first
+    //! @return number of completions, -1 on error
+    int Wait(std::vector<Completion>& completions, int timeoutMs);
+
+    const uint8_t* Buffer(int id) const;
+
+    //! @brief give a buffer back to the kernel once its bytes are consumed
+    void ReleaseBuffer(int id);
+
+    //! @brief whether buffers go back through the registered ring, false with `IORING_OP_PROVIDE_BUFFERS`
+    bool RingBuffers() const;
+
+private:
+    struct Rings;
+    std::unique_ptr<Rings> rings_;
+
+    IoUring() = default;
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* compile time descriptions of the protocol records.
+
+   A `Schema` lists the fields of a fixed size record in wire order and
+   generates its encoder and decoder: the size is a constant, decoding checks
+   the bounds once for the whole record and then copies every field from a
+   constant offset, the same loads a hand-written `memcpy` sequence compiles to.
+   `Reader` walks the variable sized parts with a check on every step.
+
+   All values are little endian, like every host this runs on.
+*/
+namespace wire {
+
+template <typename T>
+struct MemberOf;
+
+template <typename Class, typename T>
+struct MemberOf<T Class::*> {
+    using Type = T;
+};
+
+//! @brief a record member, stored as `Wire`(an enum as its integer, a float as a double, ...)
+template <auto Member, typename Wire = typename MemberOf<decltype(Member)>::Type>
+struct Field final {
+    using Type = typename MemberOf<decltype(Member)>::Type;
+    static_assert(std::is_trivially_copyable_v<Wire>, "wire values are copied bytewise");
+    static constexpr size_t Size = sizeof(Wire);
+
+    template <typename Record>
+    static void Put(const Record& record, uint8_t* ptr) {
+        Wire value = static_cast<Wire>(record.*Member);
+        memcpy(ptr, &value, Size);
+    }
+
+    template <typename Record>
+    static bool Get(Record& record, const uint8_t* ptr) {
+        Wire value;
+        memcpy(&value, ptr, Size);
+        record.*Member = static_cast<Type>(value);
+        return true;
+    }
+};
+
+//! @brief a vector member(`glm::vec3`, ...), its `N` components stored as `Wire` each
+template <auto Member, size_t N, typename Wire>
+struct VecField final {
+    static constexpr size_t Size = sizeof(Wire) * N;
+
+    template <typename Record>
+    static void Put(const Record& record, uint8_t* ptr) {
+        Wire values[N];
+        for (size_t i = 0; i < N; i++) {
+            values[i] = static_cast<Wire>((record.*Member)[i]);
+        }
+        memcpy(ptr, values, Size);
+    }
+
+    template <typename Record>
+    static bool Get(Record& record, const uint8_t* ptr) {
+        Wire values[N];
+        memcpy(values, ptr, Size);
+        for (size_t i = 0; i < N; i++) {
+            auto& component = (record.*Member)[i];
+            component = static_cast<std::remove_reference_t<decltype(component)>>(values[i]);
+        }
+        return true;
+    }
+};
+
+//! @brief a fixed value like a magic number, decoding fails when it doesn't match
+template <typename T, T Value>
+struct Const final {
+    static constexpr size_t Size = sizeof(T);
+
+    template <typename Record>
+    static void Put(const Record&, uint8_t* ptr) {
+        T value = Value;
+        memcpy(ptr, &value, Size);
+    }
+
+    template <typename Record>
+    static bool Get(Record&, const uint8_t* ptr) {
+        T value;
+        memcpy(&value, ptr, Size);
+        return value == Value;
+    }
+};
+
+template <typename Record, typename... Fields>
+class Schema final {
+public:
+    static constexpr size_t Size = (Fields::Size + ... + 0);
+
+    //! @brief unchecked, `buf` must have room for `Size` bytes
+    //! @return the first byte after the record
+    static uint8_t* Write(const Record& record, uint8_t* buf) {
+        write(record, buf, std::index_sequence_for<Fields...>{});
+        return buf + Size;
+    }
+
+    static void Append(const Record& record, std::vector<uint8_t>& buf) {
+        size_t oldSize = buf.size();
+        buf.resize(oldSize + Size);
+        Write(record, buf.data() + oldSize);
+    }
+
+    //! @return the first byte after the record, nullptr if `[beg, end)` is cut short or a `Const` doesn't match
+    static const uint8_t* Read(Record& record, const uint8_t* beg, const uint8_t* end) {
+        if (end - beg < static_cast<ptrdiff_t>(Size)) {
+            return nullptr;
+        }
+        return read(record, beg, std::index_sequence_for<Fields...>{}) ? beg + Size : nullptr;
+    }
+
+private:
+    static constexpr size_t offsetOf(size_t index) {
+        constexpr size_t sizes[] = {Fields::Size..., 0};
+        size_t offset = 0;
+        for (size_t i = 0; i < index; i++) {
+            offset += sizes[i];
+        }
+        return offset;
+    }
+
+    template <size_t I>
+    static constexpr size_t Offset = offsetOf(I);
+
+    template <size_t... I>
+    static void write(const Record& record, uint8_t* buf, std::index_sequence<I...>) {
+        (Fields::Put(record, buf + Offset<I>), ...);
+    }
+
+    template <size_t... I>
+    static bool read(Record& record, const uint8_t* buf, std::index_sequence<I...>) {
+        // `&` rather than `&&`, no branch per field
+        return (Fields::Get(record, buf + Offset<I>) & ... & true);
+    }
+};
+
+/* bounds checked cursor over `[beg, end)`. Once a read fails every later one
+   fails too, so a decoder can check `Ok()` once at the end of a group.
+   A failed cursor is an empty null range, that keeps every step at one compare. */
+class Reader final {
+public:
+    Reader(const uint8_t* beg, const uint8_t* end): ptr_(beg), end_(end) {}
+
+    template <typename T>
+    bool Read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "wire values are copied bytewise");
+        if (const uint8_t* ptr = Take(sizeof(T)); ptr) {
+            memcpy(&value, ptr, sizeof(T));
+            return true;
+        }
+        return false;
+    }
+
+    template <typename S, typename Record>
+    bool ReadRecord(Record& record) {
+        const uint8_t* next = S::Read(record, ptr_, end_);
+        if (!next) {
+            fail();
+            return false;
+        }
+        ptr_ = next;
+        return true;
+    }
+
+    //! @brief skip `size` bytes
+    //! @return where they start, nullptr if there are less
+    const uint8_t* Take(uint64_t size) {
+        if (Remaining() < size) {
+            fail();
+            return nullptr;
+        }
+        const uint8_t* ptr = ptr_;
+        ptr_ += size;
+        return ptr;
+    }
+
+    //! @brief like `Take` for `count` elements. Wire counts are 32 bit, a garbage one can't overflow the size
+    const uint8_t* TakeArray(uint32_t count, uint32_t elementSize) {
+        return Take(static_cast<uint64_t>(count) * elementSize);
+    }
+
+    size_t Remaining() const {
+        return end_ - ptr_;
+    }
+
+    const uint8_t* Ptr() const {
+        return ptr_;
+    }
+
+    bool Ok() const {
+        return ptr_ != nullptr;
+    }
+
+private:
+    const uint8_t* ptr_;
+    const uint8_t* end_;
+
+    void fail() {
+        // `Take(0)` then returns nullptr as well
+        ptr_ = nullptr;
+        end_ = nullptr;
+    }
+};
+
+}
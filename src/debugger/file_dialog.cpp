@@ -5,6 +5,7 @@
 #include <shlobj.h>
 #endif
 
+#ifdef _WIN32
 std::vector<std::string> OpenFileDialog(const std::string& title) {
     OPENFILENAME ofn;
     char szFile[MAX_PATH] = {0};
@@ -24,4 +25,10 @@ std::vector<std::string> OpenFileDialog(const std::string& title) {
     } else {
         return {};
     }
-}
\ No newline at end of file
+}
+#else
+std::vector<std::string> OpenFileDialog([[maybe_unused]] const std::string& title) {
+    // no native dialog on this platform yet
+    return {};
+}
+#endif
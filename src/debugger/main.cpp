@@ -1,9 +1,12 @@
 #include "pch.hpp"
 #include "renderer.hpp"
 #include <thread>
-#include <mutex>
 #include <iostream>
 #include "netdata.hpp"
+#include "reactor.hpp"
+#include "scene.hpp"
+#include "shm.hpp"
+#include "udp.hpp"
 #include "vertex.hpp"
 #include "geom.hpp"
 #include "camera.hpp"
@@ -12,6 +15,7 @@
 #include "backends/imgui_impl_opengl3.h"
 #include "file_dialog.hpp"
 #include "bool_deserialize.hpp"
+#include <filesystem>
 
 float gRotateY = 0;
 float gRotateX = 0;
@@ -19,7 +23,6 @@ glm::vec3 gOrigin;
 float gScale = 1.0;
 bool gShowUI = true;
 bool gQuitApp = false;
-std::mutex m;
 
 void ErrorCallback(int error, const char* description) {
     LOGE("[GLFW]: ", error, " - ", description);
@@ -69,27 +72,14 @@ void ScrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     }
 }
 
-struct RenderData {
-    Mesh mesh;
-    glm::vec3 color;
-    bool selected = false;
-
-    // something for ImGui
-    std::string checkboxName;
-    std::string buttonName;
-    
-    std::vector<RenderData> childrens;
-
-    RenderData() = default;
-
-    RenderData(const Mesh mesh, glm::vec3 color, std::string name): mesh(mesh), color(color) {
-        checkboxName = "##" + name;
-        buttonName = "G##" + name;
-    }
-};
-
-std::unordered_map<std::string, RenderData> gDatas;
-std::vector<std::string> gDataNames;
+// only the scene thread touches the scene, the receivers and the UI queue their changes
+// and the render thread draws `gScene.Latest()`
+Scene gScene;
+SceneQueue gSceneQueue;
+// between two snapshots at most, the rest of the queue waits for the next round
+constexpr auto SceneApplyBudget = std::chrono::milliseconds(4);
+// object the view moves to once its mesh is back from the cache
+std::optional<uint32_t> gGoTo;
 
 void ImGui_ImplGlfw_SetClipbord(void*, const char* text) {
     glfwSetClipboardString(nullptr, text);
@@ -99,37 +89,97 @@ const char* ImGui_ImplGlfw_GetClipbord(void*) {
     return glfwGetClipboardString(nullptr);
 }
 
-void RunThread(std::unique_ptr<net::Socket>&& client) {
-    client->SetNonblock(false);
-    NetRecv recv(std::move(client));
-
-    bool shouldQuit = false;
-
-    while (!shouldQuit && recv) {
-        auto packets = recv.RecvPacket();
-        if (!packets.empty()) {
-            std::unique_lock guard(m, std::defer_lock);
-            guard.lock();
-            for (const auto& packet : packets) {
-                std::vector<Vertex> vertices;
-                for (const auto& pos : packet.data.positions) {
-                    vertices.push_back(Vertex{pos});
-                }
-                Mesh mesh = Mesh::Create(packet.type, vertices);
-                if (auto it = gDatas.find(packet.data.name); it == gDatas.end()) {
-                    gDataNames.push_back(packet.data.name);
-                }
-                gDatas.insert_or_assign(packet.data.name, RenderData(mesh, packet.data.color, packet.data.name));
-            }
-            guard.unlock();
+void CommitPackets(const std::vector<PacketView>& packets) {
+    // decoded on the receiving thread, the render thread only moves the result into place
+    for (const auto& packet : packets) {
+        auto command = SceneCommand::FromPacket(packet);
+        if (command && !gSceneQueue.Push(std::move(command.value()))) {
+            return;     // shutting down
         }
+    }
+}
 
-        std::unique_lock l(m, std::defer_lock);
-        l.lock();
-        shouldQuit = gQuitApp;
-        l.unlock();
+// the UI's edits are commands like the receivers' ones, posted: the render thread never waits behind them
+void PushEdit(SceneCommand::Kind kind, uint32_t id, std::string_view name = {}, glm::vec3 color = {}) {
+    SceneCommand command;
+    command.kind = kind;
+    command.id = id;
+    command.name = name;
+    command.color = color;
+    gSceneQueue.Post(std::move(command));
+}
+
+void ObjectUI(const SceneSnapshot::Object& data, GLFWwindow* window) {
+    ImGui::PushID(static_cast<int>(data.id));
+    bool selected = data.selected;
+    if (ImGui::Checkbox("##selected", &selected)) {
+        PushEdit(selected ? SceneCommand::Kind::Select : SceneCommand::Kind::Deselect, data.id);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("G")) {
+        gGoTo = data.id;
+        if (data.spilled) {
+            PushEdit(SceneCommand::Kind::Restore, data.id);
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("X")) {
+        PushEdit(SceneCommand::Kind::Remove, data.id);
+    }
+    ImGui::SameLine();
+    if (data.spilled) {
+        ImGui::TextDisabled("(on disk)");
+        ImGui::SameLine();
+    }
+    // the group is shown above, only the last segment here. Still NUL terminated, it's the end of the name
+    auto slash = data.name.rfind('/');
+    const char* label = data.name.data() + (slash == std::string_view::npos ? 0 : slash + 1);
+    if (ImGui::CollapsingHeader(label)) {
+        // spilled objects come back when looked at
+        if (data.spilled) {
+            PushEdit(SceneCommand::Kind::Restore, data.id);
+        }
+        for (size_t i = 0; i < data.mesh.vertexCount; i++) {
+            const auto& vertex = data.mesh.vertices[i];
+            static char buf[1024] = {0};
+            snprintf(buf, sizeof(buf), "[%zu]: (%f, %f, %f)", i, vertex.position.x, vertex.position.y, vertex.position.z); 
+            if (ImGui::Button(buf)) {
+                glfwSetClipboardString(window, buf);
+            }
+        }
     }
+    ImGui::PopID();
+}
 
+void GroupUI(const SceneSnapshot& scene, uint32_t index, GLFWwindow* window) {
+    const auto& group = scene.groups[index];
+    for (uint32_t i = index + 1; i < group.end; i = scene.groups[i].end) {
+        const auto& child = scene.groups[i];
+        // path and name point into `NameTable`, NUL terminated
+        ImGui::PushID(child.path.data());
+        bool visible = !child.hidden;
+        if (ImGui::Checkbox("##visible", &visible)) {
+            PushEdit(visible ? SceneCommand::Kind::ShowGroup : SceneCommand::Kind::HideGroup, NameTable::None, child.path);
+        }
+        ImGui::SameLine();
+        glm::vec3 color = child.color;
+        if (ImGui::ColorEdit3("##color", &color.x, ImGuiColorEditFlags_NoInputs)) {
+            PushEdit(SceneCommand::Kind::RecolorGroup, NameTable::None, child.path, color);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("X")) {
+            PushEdit(SceneCommand::Kind::RemoveGroup, NameTable::None, child.path);
+        }
+        ImGui::SameLine();
+        if (ImGui::TreeNode(child.name.data())) {
+            GroupUI(scene, i, window);
+            ImGui::TreePop();
+        }
+        ImGui::PopID();
+    }
+    for (uint32_t i = group.objectBegin; i < group.objectEnd; i++) {
+        ObjectUI(*scene.objects[i], window);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -147,7 +197,7 @@ int main(int argc, char** argv) {
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    GLFWwindow* window = glfwCreateWindow(WindowWidth, WindowHeight, ("VisualDebugger: " + (argc == 2 ? std::string(argv[1]) : std::string("8999"))).c_str(), NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(WindowWidth, WindowHeight, ("VisualDebugger: " + (argc >= 2 ? std::string(argv[1]) : std::string("8999"))).c_str(), NULL, NULL);
     if (!window) {
         LOGE("[GLFW]: create window failed");
     }
@@ -218,7 +268,11 @@ int main(int argc, char** argv) {
     // init net
     auto net = net::Init();
 
-    const uint32_t port = argc == 2 ? std::atoi(argv[1]) : 8999;
+    // usage: debugger [port] [decode threads] [shm name] [unix socket path]
+    const uint32_t port = argc >= 2 ? std::atoi(argv[1]) : 8999;
+    const uint32_t decodeThreads = argc >= 3 ? std::atoi(argv[2]) : 0;
+    const std::string shmName = argc >= 4 ? argv[3] : "";
+    const std::string unixPath = argc >= 5 ? argv[4] : "";
 
     // create socket
     auto result = net::AddrInfoBuilder::CreateTCP("localhost", port).Build();
@@ -228,38 +282,76 @@ int main(int argc, char** argv) {
     }
 
     auto socket = net->CreateSocket(result.value, true);
-    if (socket->Bind() == SOCKET_ERROR) {
-        LOGT("bind failed: ", net::Error2Str(WSAGetLastError()));
+    if (socket->Bind() == net::SocketError) {
+        LOGT("bind failed: ", net::GetLastError());
         return 1;
     }
-    if (socket->Listen(2) != 0) {
-        LOGF("listen failed: ", net::Error2Str(WSAGetLastError()));
+    if (socket->Listen(SOMAXCONN) != 0) {
+        LOGF("listen failed: ", net::GetLastError());
         return 1;
     }
     LOGI("listening on ", port, "...");
-   
-    while (!gQuitApp) {
-        auto client = socket->Accept();
-        if (!client.value) {
-            if (client.result != WSAEWOULDBLOCK) {
-                std::cerr << "accept failed:" << net::Error2Str(client.result) << std::endl;
-            }
+
+    // VDBG_IO=uring receives through io_uring, falls back to polling if the kernel can't
+    const char* ioBackend = std::getenv("VDBG_IO");
+    Reactor reactor(CommitPackets, decodeThreads,
+                    ioBackend && std::string(ioBackend) == "uring" ? Reactor::Backend::Uring : Reactor::Backend::Poll);
+    reactor.Listen(socket);
+
+    // local producers can use a Unix domain socket instead of loopback TCP
+    net::Socket* unixSocket = nullptr;
+    auto unixAddr = net::AddrInfoBuilder::CreateUnix(unixPath).Build();
+    if (!unixPath.empty() && unixAddr.result == 0) {
+        unixSocket = net->CreateSocket(unixAddr.value, true);
+        if (unixSocket->Bind() == net::SocketError || unixSocket->Listen(SOMAXCONN) != 0) {
+            LOGE("listen on ", unixPath, " failed: ", net::GetLastError());
+            unixSocket->Close();
+            unixSocket = nullptr;
         } else {
-            LOGI("connected client");
-            if (!client.value->Valid()) {
-                LOGI("client not valid");
-                client.value = nullptr;
-            } else {
-                std::thread th(RunThread, std::move(client.value));
-                th.detach();
-            }
+            LOGI("listening on ", unixPath, "...");
+            reactor.Listen(unixSocket);
         }
-        
- 
-        std::unique_lock l(m, std::defer_lock);
-        l.lock();
+    } else if (!unixPath.empty()) {
+        LOGE("bad unix socket path ", unixPath, ": ", net::Error2Str(unixAddr.result));
+    }
+    reactor.Start();
+
+    // VDBG_SCENE_BUDGET_MB=n keeps the scene under n MB, the least recently updated meshes go to a cache file
+    if (const char* budget = std::getenv("VDBG_SCENE_BUDGET_MB"); budget && std::atoll(budget) > 0) {
+        std::error_code err;
+        auto dir = std::filesystem::temp_directory_path(err);
+        auto cacheDir = err ? std::filesystem::path(".") : dir;
+        gScene.SetMemoryBudget(std::atoll(budget) * 1024 * 1024, cacheDir.string());
+        LOGI("scene memory budget ", budget, " MB, spilling to ", cacheDir.string());
+    }
+    // from here on the scene belongs to the scene thread
+    gSceneQueue.Start(gScene, SceneApplyBudget);
+
+    // per-tick geometry may come as datagrams on the same port number
+    std::unique_ptr<UdpReceiver> udpReceiver;
+    auto udpAddr = net::AddrInfoBuilder::CreateUDP("localhost", port).Build();
+    if (udpAddr.result == 0) {
+        auto udpSocket = net->CreateSocket(udpAddr.value, true);
+        if (udpSocket->Bind() == net::SocketError) {
+            LOGW("bind udp port ", port, " failed: ", net::GetLastError());
+        } else {
+            udpReceiver = std::make_unique<UdpReceiver>(udpSocket, CommitPackets);
+            udpReceiver->Start();
+        }
+    }
+
+    // producers on this host can skip the socket and write into shared memory
+    std::unique_ptr<ShmReceiver> shmReceiver;
+    if (!shmName.empty()) {
+        if (auto ring = ShmRing::Create(shmName, 64 * 1024 * 1024); ring) {
+            LOGI("shared memory ", shmName, " ready, ", ring->Capacity(), " bytes");
+            shmReceiver = std::make_unique<ShmReceiver>(std::move(ring), CommitPackets);
+            shmReceiver->Start();
+        }
+    }
+   
+    while (!gQuitApp) {
         gQuitApp = glfwWindowShouldClose(window);
-        l.unlock();
 
         glfwPollEvents();
 
@@ -285,12 +377,20 @@ int main(int argc, char** argv) {
         renderer.Draw(zAxis, model, glm::vec3(0, 0, 1));
         renderer.SetLineWidth(1);
 
-        std::unique_lock lock(m, std::defer_lock);
-        lock.lock();
-        for (const auto& name : gDataNames) {
-            if (auto it = gDatas.find(name); it == gDatas.end()) {
-                continue;
+        // no lock: the scene thread publishes the next one meanwhile
+        auto scene = gScene.Latest();
+        if (gGoTo) {
+            // waits while the mesh is read back from the cache
+            auto* data = scene->Find(gGoTo.value());
+            if (!data || !data->spilled) {
+                if (data && data->mesh.vertexCount > 0) {
+                    gOrigin = glm::vec3(data->transform * glm::vec4(data->mesh.vertices[0].position, 1.0));
+                }
+                gGoTo.reset();
             }
+        }
+        // hidden groups and groups off screen are skipped as a whole
+        scene->ForEachVisible(camera.Projection() * camera.View() * model, [&](const SceneSnapshot::Object& data) {
             /*
             const auto& mesh = data.second.mesh;
             for (int i = 0; i < mesh.vertices.size(); i++) {
@@ -310,7 +410,6 @@ int main(int argc, char** argv) {
             }
             */
 
-            auto& data = gDatas[name];
             if (data.selected) {
                 renderer.SetLineWidth(5);
             } else {
@@ -320,9 +419,8 @@ int main(int argc, char** argv) {
             if (data.mesh.type == Mesh::Type::Points && data.selected) {
                 color = glm::vec3(1.0, 1.0, 1.0) - color;
             }
-            renderer.Draw(data.mesh, model, color);
-        }
-        lock.unlock();
+            renderer.Draw(data.mesh, model * data.transform, color);
+        });
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -332,17 +430,20 @@ int main(int argc, char** argv) {
         if (gShowUI) {
             ImGui::Begin("ui", &gShowUI);
             if (ImGui::Button("clear all")) {
-                gDatas.clear();
-                gDataNames.clear();
+                PushEdit(SceneCommand::Kind::Clear, NameTable::None);
             }
             if (ImGui::Button("load body from file")) {
                 auto files = OpenFileDialog("open file");
                 if (!files.empty()) {
                     auto filename = files[0];
                     auto mesh = DeserializeMesh(filename);
-                    gDataNames.push_back(filename);
-                    RenderData data(mesh, {0, 1, 0}, filename);
-                    gDatas[filename] = std::move(data);
+                    uint32_t id = NameTable::Instance().Intern(filename);
+                    SceneCommand load;
+                    load.id = id;
+                    load.name = NameTable::Instance().Name(id);
+                    load.mesh = std::move(mesh);
+                    load.color = glm::vec3{0, 1, 0};
+                    gSceneQueue.Post(std::move(load));
                 }
             }
 
@@ -351,28 +452,29 @@ int main(int argc, char** argv) {
             ImGui::Text("x rotateion: %f", gRotateX);
             ImGui::Text("y rotateion: %f", gRotateY);
             ImGui::Text("scale: %f", gScale);
-            for (const auto& name : gDataNames) {
-                if (auto it = gDatas.find(name); it == gDatas.end()) {
-                    continue;
-                }
-                auto& data = gDatas[name];
-                ImGui::Checkbox(data.checkboxName.c_str(), &data.selected);
-                ImGui::SameLine();
-                if (ImGui::Button(data.buttonName.c_str())) {
-                    gOrigin = data.mesh.vertices[0].position;
+            if (ImGui::CollapsingHeader("connections")) {
+                for (const auto& stat : reactor.Stats()) {
+                    ImGui::Text("#%llu: %.2f MB/s, %llu packets, latency avg %.3f ms / max %.3f ms, paused %llu times",
+                                (unsigned long long)stat.id, stat.MBPerSecond(),
+                                (unsigned long long)stat.packets, stat.avgLatencyMs, stat.maxLatencyMs,
+                                (unsigned long long)stat.pauses);
                 }
-                ImGui::SameLine();
-                if (ImGui::CollapsingHeader(name.c_str())) {
-                    for (int i = 0; i < data.mesh.vertices.size(); i++) {
-                        const auto& vertex = data.mesh.vertices[i];
-                        static char buf[1024] = {0};
-                        snprintf(buf, sizeof(buf), "[%d]: (%f, %f, %f)", i, vertex.position.x, vertex.position.y, vertex.position.z); 
-                        if (ImGui::Button(buf)) {
-                            glfwSetClipboardString(window, buf);
-                        }
-                    }
+                auto queue = gSceneQueue.Stats();
+                ImGui::Text("scene queue: %zu waiting, %llu applied, latency avg %.3f ms / max %.3f ms",
+                            queue.depth, (unsigned long long)queue.applied, queue.avgLatencyMs, queue.maxLatencyMs);
+                const auto& memory = scene->memory;
+                // approximate, names and meshes only older snapshots hold aren't counted
+                ImGui::Text("scene memory: ~%.1f MB cpu, ~%.1f MB gpu, budget %.0f MB, %zu objects spilled(%.1f MB)",
+                            memory.cpuBytes / 1048576.0, memory.gpuBytes / 1048576.0, memory.budget / 1048576.0,
+                            memory.spilled, memory.cacheBytes / 1048576.0);
+                if (udpReceiver) {
+                    auto stat = udpReceiver->Stats();
+                    ImGui::Text("udp: %llu packets, %llu stale, %llu malformed",
+                                (unsigned long long)stat.packets, (unsigned long long)stat.stale,
+                                (unsigned long long)stat.malformed);
                 }
             }
+            GroupUI(*scene, 0, window);
             ImGui::End();
         }
 
@@ -385,7 +487,22 @@ int main(int argc, char** argv) {
         glfwSwapBuffers(window);
     }
 
+    // receivers waiting for room must give up, the scene thread stops with them
+    gSceneQueue.Stop();
+    if (shmReceiver) {
+        shmReceiver->Stop();
+    }
+    if (udpReceiver) {
+        udpReceiver->Stop();
+    }
+    reactor.Stop();
     socket->Close();
+    if (unixSocket) {
+        unixSocket->Close();
+#ifndef _WIN32
+        unlink(unixPath.c_str());
+#endif
+    }
     Renderer::Quit();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,49 @@
+#include "compress.hpp"
+#include "netdata.hpp"
+#include "lz4.h"
+
+bool BlockCodec::Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    int bound = LZ4_compressBound(static_cast<int>(std::min<size_t>(size, LZ4_MAX_INPUT_SIZE + 1ull)));
+    if (bound == 0) {
+        return false;
+    }
+
+    size_t oldSize = out.size();
+    out.resize(oldSize + 4 + bound);
+    uint32_t rawSize = size;
+    memcpy(out.data() + oldSize, &rawSize, 4);
+    // stop as soon as the output isn't smaller than the input
+    int packed = LZ4_compress_default(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(out.data() + oldSize + 4),
+                                      size, std::min<size_t>(bound, size - std::min<size_t>(size, 5)));
+    if (packed <= 0) {
+        out.resize(oldSize);
+        return false;
+    }
+    out.resize(oldSize + 4 + packed);
+    return true;
+}
+
+bool BlockCodec::Decompress(const uint8_t* beg, const uint8_t* end, std::vector<uint8_t>& out) {
+    uint32_t rawSize = 0;
+    if (end - beg < 4) {
+        return false;
+    }
+    memcpy(&rawSize, beg, 4);
+    // the size is untrusted: no block inflates by more than `MaxRatio`, don't allocate for more
+    uint64_t packed = end - beg - 4;
+    if (rawSize > FrameHeader::MaxLength || rawSize > packed * MaxRatio) {
+        return false;
+    }
+    out.resize(rawSize);
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(beg + 4), reinterpret_cast<char*>(out.data()),
+                                   end - beg - 4, rawSize);
+    return size == static_cast<int>(rawSize);
+}
+
+void BlockCodec::TrimPool(std::vector<std::vector<uint8_t>>& buffers) {
+    for (auto& buffer : buffers) {
+        if (buffer.capacity() > KeepCapacity) {
+            std::vector<uint8_t>().swap(buffer);
+        }
+    }
+}
@@ -26,4 +26,38 @@ std::optional<std::pair<float, float>> RaySegNearest(const Linear& ray, const Li
         return std::nullopt;
     }
     return std::pair<float, float>(t1, t2);
-}
\ No newline at end of file
+}
+
+AABB AABB::Transformed(const glm::mat4& transform) const {
+    AABB box;
+    if (Empty()) {
+        return box;
+    }
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        box.Add(glm::vec3(transform * glm::vec4(corner, 1.0)));
+    }
+    return box;
+}
+
+bool OutsideClip(const AABB& box, const glm::mat4& clip) {
+    if (box.Empty()) {
+        return true;
+    }
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = clip * glm::vec4(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z, 1.0);
+    }
+    // -w <= x, y, z <= w inside
+    for (int axis = 0; axis < 3; axis++) {
+        bool allBelow = true, allAbove = true;
+        for (const auto& corner : corners) {
+            allBelow &= corner[axis] < -corner.w;
+            allAbove &= corner[axis] > corner.w;
+        }
+        if (allBelow || allAbove) {
+            return true;
+        }
+    }
+    return false;
+}
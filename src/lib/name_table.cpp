@@ -0,0 +1,27 @@
+#include "name_table.hpp"
+
+NameTable& NameTable::Instance() {
+    static NameTable instance;
+    return instance;
+}
+
+uint32_t NameTable::Intern(std::string_view name) {
+    std::lock_guard guard(mutex_);
+    if (auto it = ids_.find(name); it != ids_.end()) {
+        return it->second;
+    }
+    uint32_t id = names_.size();
+    const auto& stored = names_.emplace_back(name);
+    ids_.emplace(stored, id);
+    return id;
+}
+
+std::string_view NameTable::Name(uint32_t id) const {
+    std::lock_guard guard(mutex_);
+    return id < names_.size() ? std::string_view(names_[id]) : std::string_view();
+}
+
+size_t NameTable::Size() const {
+    std::lock_guard guard(mutex_);
+    return names_.size();
+}
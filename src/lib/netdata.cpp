@@ -1,34 +1,75 @@
 #include "netdata.hpp"
+#include "position_decode.hpp"
+#include <algorithm>
 
-NetSender::NetSender(std::unique_ptr<net::Net>& net, uint32_t port) {
-    auto result = net::AddrInfoBuilder::CreateTCP("localhost", port).Build();
-    if (result.result != 0) {
-        LOGE("create tcp on localhost:", port, " failed!");
+namespace {
+
+using NameDeclarationSchema = wire::Schema<NameDeclaration, wire::Field<&NameDeclaration::id>>;
+
+// in front of every record of a batch
+struct RecordHeader final {
+    Opcode opcode = Opcode::Mesh;
+    uint32_t length = 0;
+};
+
+using RecordHeaderSchema = wire::Schema<RecordHeader,
+                                        wire::Field<&RecordHeader::opcode, uint8_t>,
+                                        wire::Field<&RecordHeader::length>>;
+
+// type byte, attribute byte if the type byte says so, vertex count
+struct PacketHead final {
+    uint8_t type = 0;
+    uint8_t attributes = 0;
+    uint32_t count = 0;
+};
+
+using PacketHeadSchema = wire::Schema<PacketHead,
+                                      wire::Field<&PacketHead::type>,
+                                      wire::Field<&PacketHead::count>>;
+using AttributedPacketHeadSchema = wire::Schema<PacketHead,
+                                                wire::Field<&PacketHead::type>,
+                                                wire::Field<&PacketHead::attributes>,
+                                                wire::Field<&PacketHead::count>>;
+
+// the color of a packet, right before its name
+struct PacketColor final {
+    Vec3 color;
+};
+
+using PacketColorSchema = wire::Schema<PacketColor, wire::VecField<&PacketColor::color, 3, double>>;
+
+// the body of an `Opcode::Transform` packet, between type byte and name:
+// the upper 3 rows of an affine transform, its last row is always (0, 0, 0, 1)
+struct PacketTransform final {
+    glm::vec3 x;
+    glm::vec3 y;
+    glm::vec3 z;
+    glm::vec3 translation;
+
+    PacketTransform() = default;
+    explicit PacketTransform(const glm::mat4& m): x(m[0]), y(m[1]), z(m[2]), translation(m[3]) {}
+
+    glm::mat4 Matrix() const {
+        return glm::mat4(glm::vec4(x, 0), glm::vec4(y, 0), glm::vec4(z, 0), glm::vec4(translation, 1));
     }
+};
 
-    socket_ = net->CreateSocket(result.value);
-    socket_->Bind();
-    socket_->Connect();
-}
+using PacketTransformSchema = wire::Schema<PacketTransform,
+                                           wire::VecField<&PacketTransform::x, 3, float>,
+                                           wire::VecField<&PacketTransform::y, 3, float>,
+                                           wire::VecField<&PacketTransform::z, 3, float>,
+                                           wire::VecField<&PacketTransform::translation, 3, float>>;
+static_assert(PacketTransformSchema::Size == 48);
 
-NetSender::~NetSender() {
-    socket_->Close();
 }
 
-void NetSender::SendPacket(const Packet& packet) {
-    auto buf = packet.Serialize();
-    if (auto result = socket_->Send("BEG", 3); result.result != 0) {
-        LOGI("connect lost: ", net::Error2Str(result.result));
-        return;
-    }
-    if (auto result = socket_->Send((char*)buf.data(), buf.size()); result.result != 0) {
-        LOGI("connect lost: ", net::Error2Str(result.result));
-        return;
-    }
-    if (auto result = socket_->Send("END", 3); result.result != 0) {
-        LOGI("connect lost: ", net::Error2Str(result.result));
-        return;
+bool FrameHeader::StartsWithMagic(const uint8_t* beg, const uint8_t* end) {
+    uint32_t magic = 0;
+    if (end - beg < 4) {
+        return false;
     }
+    memcpy(&magic, beg, 4);
+    return magic == Magic;
 }
 
 NetRecv::~NetRecv() {
@@ -37,198 +78,708 @@ NetRecv::~NetRecv() {
     }
 }
 
+void NetRecv::Reset() {
+    buffer_.Consume(buffer_.Size());
+    legacyScanned_ = 0;
+    pendingBytes_ = 0;
+    names_.clear();
+}
+
+namespace {
+
+void appendPackets(const std::vector<PacketView>& views, std::vector<Packet>& packets) {
+    packets.reserve(packets.size() + views.size());
+    for (const auto& view : views) {
+        packets.push_back(view.ToPacket(true));
+    }
+}
+
+}
+
 std::vector<Packet> NetRecv::RecvPacket() {
+    std::vector<Packet> packets;
+    RecvPacket([&packets](const std::vector<PacketView>& views) {
+        appendPackets(views, packets);
+    });
+    return packets;
+}
+
+void NetRecv::RecvPacket(const Visitor& visit) {
+    RecvWith([this](uint8_t* buf, size_t size) {
+        return recvInto(buf, size);
+    }, visit);
+}
+
+int NetRecv::RecvBytes(std::vector<uint8_t>& out) {
+    size_t oldSize = out.size();
+    size_t readSize = std::max(MinRead, pendingBytes_.load(std::memory_order_relaxed));
+    out.resize(oldSize + readSize);
+    int len = recvInto(out.data() + oldSize, readSize);
+    out.resize(oldSize + std::max(len, 0));
+    if (len > 0) {
+        bytesReceived_ += len;
+    }
+    return len;
+}
+
+int NetRecv::recvInto(uint8_t* buf, size_t size) {
     if (!client_) {
-        return {};
+        return -1;
     }
 
-    uint8_t buf[4096] = {0};
-    auto recvResult = client_->Recv((char*)buf, sizeof(buf));
+    auto recvResult = client_->Recv((char*)buf, size);
 
-    if (recvResult.value<= 0) {
+    if (recvResult.value < 0 && recvResult.result == net::ErrWouldBlock) {
+        return 0;
+    }
+    if (recvResult.value == 0) {
+        // an orderly shutdown, errno says nothing here
+        LOGI("client closed");
+        client_->Close();
+        client_ = nullptr;
+        return -1;
+    }
+    if (recvResult.value < 0) {
         LOGI("client closed: ", net::Error2Str(recvResult.result));
         client_->Close();
         client_ = nullptr;
-        return {};
+        return -1;
     }
 
-    int len = recvResult.value;
+    return recvResult.value;
+}
 
+std::vector<Packet> NetRecv::Feed(const uint8_t* beg, const uint8_t* end) {
     std::vector<Packet> packets;
-    auto [result, nextPtr] = splitOnePacket(buf, buf + len);
-    while (nextPtr < buf + len) {
-        if (result) {
-            auto packet = analyzePacket(cache_.data(), cache_.data() + cache_.size());
-            cache_.clear();
-            if (!packet) {
-                LOGE("analyze packet failed!");
-            } else {
-                if (packet.value().data.name.empty()) {
-                    LOGT("here");
-                }
-                packets.push_back(packet.value());
-            }
+    Feed(beg, end, [&packets](const std::vector<PacketView>& views) {
+        appendPackets(views, packets);
+    });
+    return packets;
+}
+
+void NetRecv::Feed(const uint8_t* buf, const uint8_t* bufEnd, const Visitor& visit) {
+    if (buf == bufEnd) {
+        return;
+    }
+
+    views_.clear();
+    if (buffer_.Empty()) {
+        // decode straight from the caller's bytes, only keep the unfinished tail
+        const uint8_t* consumed = splitFrames(buf, bufEnd, views_);
+        if (!views_.empty()) {
+            visit(views_);
+        }
+        buffer_.Append(consumed, bufEnd - consumed);
+    } else {
+        buffer_.Append(buf, bufEnd - buf);
+        const uint8_t* consumed = splitFrames(buffer_.Data(), buffer_.Data() + buffer_.Size(), views_);
+        if (!views_.empty()) {
+            visit(views_);
         }
-        auto sp = splitOnePacket(nextPtr, buf + len);
-        result = sp.first;
-        nextPtr = sp.second;
+        buffer_.Consume(consumed - buffer_.Data());
     }
-	if (result) {
-		auto packet = analyzePacket(cache_.data(), cache_.data() + cache_.size());
-        cache_.clear();
-		if (!packet) {
-			LOGE("analyze packet failed!");
-		} else {
-                if (packet.value().data.name.empty()) {
-                    LOGT("here");
-                }
-			packets.push_back(packet.value());
-		}
-	}
+}
 
-    return packets;
+const uint8_t* NetRecv::splitFrames(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views) {
+    static const uint8_t LegacyBeg[] = {'B', 'E', 'G'};
+    static const uint8_t LegacyEnd[] = {'E', 'N', 'D'};
+
+    const uint8_t* ptr = beg;
+    size_t pending = 0;
+    // the views of the last call are gone, and with them the need for their payloads
+    BlockCodec::TrimPool(inflated_);
+    inflatedUsed_ = 0;
+    while (end - ptr >= 4) {
+        if (FrameHeader::StartsWithMagic(ptr, end)) {
+            auto header = FrameHeader::Read(ptr, end);
+            if (!header) {
+                break;
+            }
+            if (header->version > FrameHeader::Version || header->length > FrameHeader::MaxLength) {
+                LOGE("[NET]: bad frame header(version ", (int)header->version, ", length ", header->length, ")");
+                ptr ++;
+                continue;
+            }
+            if (static_cast<size_t>(end - ptr) < FrameHeader::Size + header->length) {
+                pending = FrameHeader::Size + header->length - (end - ptr);
+                break;
+            }
+            const uint8_t* payload = ptr + FrameHeader::Size;
+            analyzeFrame(header.value(), payload, payload + header->length, views);
+            ptr = payload + header->length;
+        } else if (memcmp(ptr, LegacyBeg, 3) == 0) {
+            // old "BEG" ... "END" framing, only these frames need scanning
+            const uint8_t* scanFrom = ptr + 3 + legacyScanned_;
+            const uint8_t* endPtr = FindSubStr(scanFrom, end - scanFrom, LegacyEnd, 3);
+            if (!endPtr) {
+                legacyScanned_ = std::max<ptrdiff_t>(end - ptr - 3 - 2, 0);
+                break;
+            }
+            legacyScanned_ = 0;
+            analyzeFrame(FrameHeader{}, ptr + 3, endPtr, views);
+            ptr = endPtr + 3;
+        } else {
+            // lost sync, skip to the next thing that looks like a frame
+            const uint8_t* next = ptr + 1;
+            while (end - next >= 4 && !FrameHeader::StartsWithMagic(next, end) && memcmp(next, LegacyBeg, 3) != 0) {
+                next ++;
+            }
+            LOGE("[NET]: skip ", next - ptr, " bytes of unknown data");
+            ptr = next;
+        }
+    }
+    pendingBytes_.store(pending, std::memory_order_relaxed);
+    return ptr;
 }
 
-std::pair<bool, const uint8_t*> NetRecv::splitOnePacket(const uint8_t* beg, const uint8_t* end) {
-    const uint8_t* begPtr = FindSubStr(beg, end - beg, (uint8_t*)"BEG", 3);
-    const uint8_t* endPtr = FindSubStr(beg, end - beg, (uint8_t*)"END", 3);
+void NetRecv::analyzeFrame(const FrameHeader& header, const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views) {
+    if (header.flags & FrameHeader::FlagSequenced) {
+        // a stream is already in order, the tag only matters on UDP
+        beg = std::min(beg + SequenceTag::Size, end);
+    }
+    if (header.flags & FrameHeader::FlagCompressed) {
+        if (inflatedUsed_ == inflated_.size()) {
+            inflated_.emplace_back();
+        }
+        auto& raw = inflated_[inflatedUsed_++];
+        if (!BlockCodec::Decompress(beg, end, raw)) {
+            LOGE("[NET]: corrupt compressed frame dropped");
+            return;
+        }
+        beg = raw.data();
+        end = raw.data() + raw.size();
+    }
 
-    if (begPtr == nullptr && endPtr == nullptr) {
-        cache_.insert(cache_.end(), beg, end);
-        return {false, end};
-    } else if (begPtr == nullptr && endPtr != nullptr) {
-        cache_.insert(cache_.end(), beg, endPtr);
-        return {true, endPtr + 3};
-    } else if (begPtr != nullptr && endPtr == nullptr) {
-        if (!cache_.empty()) {
-            LOGE("[NET]: last packet in cache not finish, but recv a BEG!");
-            cache_.clear();
+    size_t first = views.size();
+    switch (header.opcode) {
+        case Opcode::Mesh:
+        case Opcode::Append:
+        case Opcode::Replace:
+        case Opcode::Declare:
+        case Opcode::Transform: {
+            if (auto view = PacketView::Parse(beg, end, header.opcode); view) {
+                views.push_back(view.value());
+            } else {
+                LOGE("analyze packet failed!");
+            }
+            break;
         }
-        cache_.insert(cache_.end(), begPtr + 3, end);
-        return {false, end};
-    } else {
-        if (begPtr < endPtr) {
-            if (!cache_.empty()) {
-				LOGE("[NET]: last packet in cache not finish, but recv a BEG!");
-				cache_.clear();
+        case Opcode::Batch:
+            if (!Batch::Parse(beg, end, views)) {
+                LOGE("[NET]: batch frame is cut short");
             }
+            break;
+        default:
+            LOGW("[NET]: unknown opcode ", (int)header.opcode, ", frame dropped");
+            break;
+    }
+    resolveNames(views, first);
+}
 
-            cache_.insert(cache_.end(), begPtr + 3, endPtr);
-            return {true, endPtr + 3};
+void NetRecv::resolveNames(std::vector<PacketView>& views, size_t first) {
+    auto& table = NameTable::Instance();
+    size_t kept = first;
+    for (size_t i = first; i < views.size(); i++) {
+        auto& view = views[i];
+        if (view.opcode == Opcode::Declare) {
+            if (view.nameId >= NameDeclaration::MaxIds) {
+                LOGE("[NET]: name id ", view.nameId, " is too big, declaration dropped");
+                continue;
+            }
+            if (view.nameId >= names_.size()) {
+                names_.resize(view.nameId + 1);
+            }
+            auto& declared = names_[view.nameId];
+            declared.id = table.Intern(view.name);
+            declared.name = table.Name(declared.id);
+            continue;
+        }
+
+        if (view.nameId == Packet::NoNameId) {
+            view.id = table.Intern(view.name);
+        } else if (view.nameId < names_.size() && names_[view.nameId].id != NameTable::None) {
+            // no hashing, the id was resolved when it was declared
+            view.id = names_[view.nameId].id;
+            view.name = names_[view.nameId].name;
         } else {
-            if (begPtr - endPtr != 3) {
-                LOGE("invalid data between END and BEG");
+            LOGW("[NET]: packet with undeclared name id ", view.nameId, " dropped");
+            continue;
+        }
+        views[kept++] = view;
+    }
+    views.resize(kept);
+}
+
+std::optional<Packet> NetRecv::DecodeMesh(const uint8_t* beg, const uint8_t* end, Opcode opcode) {
+    auto view = PacketView::Parse(beg, end, opcode);
+    if (!view) {
+        LOGE("analyze packet failed!");
+        return std::nullopt;
+    }
+    return view->ToPacket(true);
+}
+
+std::vector<uint8_t> Packet::Serialize() const {
+    std::vector<uint8_t> buf;
+    SerializeTo(buf);
+    return buf;
+}
+
+namespace {
+
+constexpr uint8_t TypeMask = 0x0F;
+constexpr uint8_t EncodingShift = 4;
+constexpr uint8_t EncodingMask = 0x03;
+constexpr uint8_t NamedById = 0x40;
+constexpr uint8_t AttributesFollow = 0x80;
+
+template <typename T>
+uint8_t* writeValue(uint8_t* ptr, T value) {
+    memcpy(ptr, &value, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+template <typename T>
+const uint8_t* readValue(const uint8_t* ptr, T& value) {
+    memcpy(&value, ptr, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+size_t positionsSize(PositionEncoding encoding, size_t count) {
+    switch (encoding) {
+        case PositionEncoding::Float32: return count * sizeof(float) * 3;
+        case PositionEncoding::Quantized16: return sizeof(float) * 6 + count * sizeof(uint16_t) * 3;
+        default: return count * sizeof(double) * 3;
+    }
+}
+
+uint8_t* encodePositions(uint8_t* ptr, PositionEncoding encoding, const std::vector<Vec3>& positions) {
+    switch (encoding) {
+        case PositionEncoding::Float32:
+            for (const auto& pos : positions) {
+                ptr = writeValue(ptr, pos.x);
+                ptr = writeValue(ptr, pos.y);
+                ptr = writeValue(ptr, pos.z);
+            }
+            return ptr;
+        case PositionEncoding::Quantized16: {
+            Vec3 min(0), max(0);
+            if (!positions.empty()) {
+                min = max = positions[0];
             }
-            cache_.insert(cache_.end(), beg, endPtr);
-            return {true, begPtr};
+            for (const auto& pos : positions) {
+                min = glm::min(min, pos);
+                max = glm::max(max, pos);
+            }
+            for (int i = 0; i < 3; i++) {
+                ptr = writeValue(ptr, min[i]);
+            }
+            for (int i = 0; i < 3; i++) {
+                ptr = writeValue(ptr, max[i]);
+            }
+            Vec3 extent = max - min;
+            Vec3 scale(0);
+            for (int i = 0; i < 3; i++) {
+                scale[i] = extent[i] > 0 ? 65535.0f / extent[i] : 0;
+            }
+            for (const auto& pos : positions) {
+                Vec3 q = glm::clamp((pos - min) * scale + 0.5f, Vec3(0), Vec3(65535));
+                ptr = writeValue(ptr, static_cast<uint16_t>(q.x));
+                ptr = writeValue(ptr, static_cast<uint16_t>(q.y));
+                ptr = writeValue(ptr, static_cast<uint16_t>(q.z));
+            }
+            return ptr;
         }
+        default:
+            for (const auto& pos : positions) {
+                ptr = writeValue<double>(ptr, pos.x);
+                ptr = writeValue<double>(ptr, pos.y);
+                ptr = writeValue<double>(ptr, pos.z);
+            }
+            return ptr;
     }
 }
 
+Vec3& positionOf(Vec3& pos) {
+    return pos;
+}
 
-std::optional<Packet> NetRecv::analyzePacket(const uint8_t* beg, const uint8_t* end) {
-    if (end - beg <= 3) {
-        LOGE("packet data not enought!");
-        return std::nullopt;
+Vec3& positionOf(Vertex& vertex) {
+    return vertex.position;
+}
+
+//! @brief the one conversion from wire format to storage, `positions` was checked by `PacketView::Parse`
+template <typename T>
+void decodePositions(const uint8_t* ptr, PositionEncoding encoding, uint32_t count, bool swapYZ, T* out) {
+    static_assert(sizeof(T) == sizeof(float) * 3, "positions are decoded as packed float triples");
+    if (count == 0) {
+        return;
+    }
+    // y and z swap as the values are stored, no second pass
+    float* dst = glm::value_ptr(positionOf(out[0]));
+    switch (encoding) {
+        case PositionEncoding::Float32:
+            DecodeFloat32Positions(ptr, count, swapYZ, dst);
+            break;
+        case PositionEncoding::Quantized16: {
+            int y = swapYZ ? 2 : 1;
+            int z = swapYZ ? 1 : 2;
+            Vec3 min, max;
+            for (int i = 0; i < 3; i++) {
+                ptr = readValue(ptr, min[i]);
+            }
+            for (int i = 0; i < 3; i++) {
+                ptr = readValue(ptr, max[i]);
+            }
+            Vec3 step = (max - min) / 65535.0f;
+            for (uint32_t i = 0; i < count; i++) {
+                uint16_t q[3];
+                ptr = readValue(ptr, q);
+                Vec3& pos = positionOf(out[i]);
+                pos.x = min.x + q[0] * step.x;
+                pos[y] = min.y + q[1] * step.y;
+                pos[z] = min.z + q[2] * step.z;
+            }
+            break;
+        }
+        default:
+            DecodeFloat64Positions(ptr, count, swapYZ, dst);
+            break;
     }
-    if (beg[0] == 'B' && beg[1] == 'E' && beg[2] == 'G') {
-        return Packet::Deserialize(beg + 3, end);
+}
+
+//! @brief like `decodePositions` for a transform, checked by `PacketView::Parse` as well
+glm::mat4 decodeTransform(const uint8_t* ptr, bool swapYZ) {
+    PacketTransform record;
+    PacketTransformSchema::Read(record, ptr, ptr + PacketTransformSchema::Size);
+    glm::mat4 transform = record.Matrix();
+    if (!swapYZ) {
+        return transform;
     }
-    auto packet = Packet::Deserialize(beg, end);
-    if (packet) {
-        for (auto& vertex : packet.value().data.positions) {
-            std::swap(vertex.y, vertex.z);
+    // conjugated by the swap, so it moves swapped vertices the way it moved the sender's
+    const int axis[4] = {0, 2, 1, 3};
+    glm::mat4 swapped;
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            swapped[column][row] = transform[axis[column]][axis[row]];
         }
     }
+    return swapped;
+}
 
-    return packet;
 }
 
-std::vector<uint8_t> Packet::Serialize() const {
-    std::vector<uint8_t> buf;
+void Packet::SerializeTo(std::vector<uint8_t>& buf, uint32_t nameId) const {
+    if (opcode == Opcode::Transform) {
+        // no vertices, the type is there for a mesh that doesn't exist yet
+        size_t oldSize = buf.size();
+        buf.resize(oldSize + 1 + PacketTransformSchema::Size +
+                   (nameId != NoNameId ? sizeof(nameId) : data.name.length()));
+        uint8_t* ptr = buf.data() + oldSize;
+        *ptr++ = static_cast<uint8_t>(type) | (nameId != NoNameId ? NamedById : 0);
+        ptr = PacketTransformSchema::Write(PacketTransform{transform}, ptr);
+        if (nameId != NoNameId) {
+            writeValue(ptr, nameId);
+        } else {
+            memcpy(ptr, data.name.data(), data.name.length());
+        }
+        return;
+    }
+    if (opcode == Opcode::Replace) {
+        buf.resize(buf.size() + 4);
+        writeValue(buf.data() + buf.size() - 4, offset);
+    }
 
-    buf.push_back(static_cast<uint8_t>(type));
+    size_t count = data.positions.size();
+    uint8_t attributes = 0;
+    if (!data.colors.empty() && data.colors.size() == count) {
+        attributes |= AttrColors;
+    }
+    if (!data.normals.empty() && data.normals.size() == count) {
+        attributes |= AttrNormals;
+    }
+    size_t indexSize = 0;
+    if (!data.indices.empty()) {
+        // u16 covers most meshes and halves the index bytes. Out of range indices stay
+        // as they are, narrowed they could turn into valid ones the receiver can't reject
+        uint32_t maxIndex = *std::max_element(data.indices.begin(), data.indices.end());
+        indexSize = maxIndex <= UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t);
+        attributes |= indexSize == sizeof(uint16_t) ? AttrIndices16 : AttrIndices32;
+    }
+
+    uint8_t typeByte = static_cast<uint8_t>(type) | (static_cast<uint8_t>(encoding) << EncodingShift);
+    if (nameId != NoNameId) {
+        typeByte |= NamedById;
+    }
+    buf.push_back(attributes ? typeByte | AttributesFollow : typeByte);
+    if (attributes) {
+        buf.push_back(attributes);
+    }
     size_t oldSize = buf.size();
     buf.resize(oldSize +
                4 +
-               data.positions.size() * sizeof(double) * 3 +
-               sizeof(double) * 3 + // color
-               data.name.length() * sizeof(uint8_t));
-    double* ptr = (double*)(buf.data() + oldSize);
-    uint32_t count = data.positions.size();
-    uint32_t* uptr = (uint32_t*)ptr;
-    memcpy(uptr, &count, sizeof(count));
-    ptr = (double*)(uptr + 1);
-    for (const auto& pos: data.positions) {
-        double x = pos.x;
-        double y = pos.y;
-        double z = pos.z;
-        memcpy(ptr, &x, sizeof(double));
-        ptr ++;
-        memcpy(ptr, &y, sizeof(double));
-        ptr ++;
-        memcpy(ptr, &z, sizeof(double));
-        ptr ++;
-    }
-    double r = data.color.r;
-    double g = data.color.g;
-    double b = data.color.b;
-    memcpy(ptr, &r, sizeof(double));
-    ptr ++;
-    memcpy(ptr, &g, sizeof(double));
-    ptr ++;
-    memcpy(ptr, &b, sizeof(double));
-    ptr ++;
-    uint8_t* cp = (uint8_t*)ptr;
-    for (auto c : data.name) {
-        *cp = c;
-        cp ++;
+               positionsSize(encoding, count) +
+               (attributes & AttrColors ? count * 3 : 0) +
+               (attributes & AttrNormals ? count * sizeof(float) * 3 : 0) +
+               (indexSize ? 4 + data.indices.size() * indexSize : 0) +
+               PacketColorSchema::Size +
+               (nameId != NoNameId ? sizeof(nameId) : data.name.length() * sizeof(uint8_t)));
+    uint8_t* ptr = buf.data() + oldSize;
+    ptr = writeValue<uint32_t>(ptr, count);
+    ptr = encodePositions(ptr, encoding, data.positions);
+    if (attributes & AttrColors) {
+        for (const auto& color : data.colors) {
+            glm::vec3 rgb = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+            *ptr++ = static_cast<uint8_t>(rgb.r);
+            *ptr++ = static_cast<uint8_t>(rgb.g);
+            *ptr++ = static_cast<uint8_t>(rgb.b);
+        }
+    }
+    if (attributes & AttrNormals) {
+        ptr = encodePositions(ptr, PositionEncoding::Float32, data.normals);
+    }
+    if (indexSize) {
+        ptr = writeValue<uint32_t>(ptr, data.indices.size());
+        for (uint32_t index : data.indices) {
+            ptr = indexSize == sizeof(uint16_t) ? writeValue<uint16_t>(ptr, index) : writeValue(ptr, index);
+        }
     }
+    ptr = PacketColorSchema::Write(PacketColor{data.color}, ptr);
+    if (nameId != NoNameId) {
+        writeValue(ptr, nameId);
+    } else {
+        memcpy(ptr, data.name.data(), data.name.length());
+    }
+}
 
-    return buf;
+void NameDeclaration::SerializeTo(std::vector<uint8_t>& buf) const {
+    size_t oldSize = buf.size();
+    buf.resize(oldSize + NameDeclarationSchema::Size + name.size());
+    uint8_t* ptr = NameDeclarationSchema::Write(*this, buf.data() + oldSize);
+    memcpy(ptr, name.data(), name.size());
 }
 
-std::optional<Packet> Packet::Deserialize(const uint8_t* beg, const uint8_t* end) {
-    const uint8_t* ptr = beg;
-    Mesh::Type type = static_cast<Mesh::Type>(*ptr);
-    ptr ++;
+std::optional<Packet> Packet::Deserialize(const uint8_t* beg, const uint8_t* end, Opcode opcode) {
+    auto view = PacketView::Parse(beg, end, opcode);
+    if (!view) {
+        return std::nullopt;
+    }
+    return view->ToPacket(false);
+}
+
+std::optional<PacketView> PacketView::Parse(const uint8_t* beg, const uint8_t* end, Opcode opcode) {
+    wire::Reader reader(beg, end);
+    PacketView view;
+    view.opcode = opcode;
+    if (opcode == Opcode::Declare) {
+        NameDeclaration declaration;
+        if (!reader.ReadRecord<NameDeclarationSchema>(declaration)) {
+            return std::nullopt;
+        }
+        view.nameId = declaration.id;
+        view.name = std::string_view(reinterpret_cast<const char*>(reader.Ptr()), reader.Remaining());
+        return view;
+    }
+    if (opcode == Opcode::Transform) {
+        uint8_t typeByte = 0;
+        reader.Read(typeByte);
+        view.type = static_cast<Mesh::Type>(typeByte & TypeMask);
+        view.transform = reader.Take(PacketTransformSchema::Size);
+        if (typeByte & NamedById) {
+            reader.Read(view.nameId);
+        } else {
+            view.name = std::string_view(reinterpret_cast<const char*>(reader.Ptr()), reader.Remaining());
+        }
+        if (!reader.Ok()) {
+            return std::nullopt;
+        }
+        return view;
+    }
+
+    if (opcode == Opcode::Replace) {
+        reader.Read(view.offset);
+    }
+    PacketHead head;
+    bool attributed = reader.Remaining() > 0 && (*reader.Ptr() & AttributesFollow);
+    if (attributed ? !reader.ReadRecord<AttributedPacketHeadSchema>(head) : !reader.ReadRecord<PacketHeadSchema>(head)) {
+        return std::nullopt;
+    }
+    uint8_t typeByte = head.type;
+    view.attributes = head.attributes;
+    view.count = head.count;
+    view.type = static_cast<Mesh::Type>(typeByte & TypeMask);
+    view.encoding = static_cast<PositionEncoding>((typeByte >> EncodingShift) & EncodingMask);
+    if (view.encoding > PositionEncoding::Quantized16 ||
+        ((view.attributes & Packet::AttrIndices16) && (view.attributes & Packet::AttrIndices32))) {
+        return std::nullopt;
+    }
+
+    // every array is checked against what's left, `count` is never trusted
+    size_t fixed = positionsSize(view.encoding, 0);
+    view.positions = reader.Take(fixed + static_cast<uint64_t>(view.count) * (positionsSize(view.encoding, 1) - fixed));
+    if (view.attributes & Packet::AttrColors) {
+        view.colors = reader.TakeArray(view.count, 3);
+    }
+    if (view.attributes & Packet::AttrNormals) {
+        view.normals = reader.TakeArray(view.count, sizeof(float) * 3);
+    }
+    if (view.attributes & (Packet::AttrIndices16 | Packet::AttrIndices32)) {
+        size_t indexSize = view.attributes & Packet::AttrIndices16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        reader.Read(view.indexCount);
+        view.indices = reader.TakeArray(view.indexCount, indexSize);
+    }
+
+    PacketColor color;
+    reader.ReadRecord<PacketColorSchema>(color);
+    view.color = color.color;
+    if (typeByte & NamedById) {
+        reader.Read(view.nameId);
+    } else {
+        view.name = std::string_view(reinterpret_cast<const char*>(reader.Ptr()), reader.Remaining());
+    }
+    if (!reader.Ok()) {
+        return std::nullopt;
+    }
+    return view;
+}
+
+void PacketView::DecodeTo(Vertex* out) const {
+    decodePositions(positions, encoding, count, true, out);
+}
+
+void PacketView::DecodeColorsTo(glm::vec3* out) const {
+    const uint8_t* ptr = colors;
+    for (uint32_t i = 0; i < count; i++, ptr += 3) {
+        out[i] = glm::vec3(ptr[0], ptr[1], ptr[2]) / 255.0f;
+    }
+}
+
+void PacketView::DecodeNormalsTo(Vec3* out) const {
+    decodePositions(normals, PositionEncoding::Float32, count, true, out);
+}
+
+bool PacketView::DecodeIndicesTo(uint32_t* out, uint32_t base, uint32_t limit) const {
+    bool valid = true;
+    bool wide = attributes & Packet::AttrIndices32;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        uint32_t index = 0;
+        if (wide) {
+            memcpy(&index, indices + i * sizeof(uint32_t), sizeof(uint32_t));
+        } else {
+            uint16_t narrow;
+            memcpy(&narrow, indices + i * sizeof(uint16_t), sizeof(uint16_t));
+            index = narrow;
+        }
+        uint64_t value = static_cast<uint64_t>(base) + index;
+        valid &= value < limit;
+        out[i] = static_cast<uint32_t>(value);
+    }
+    return valid;
+}
+
+glm::mat4 PacketView::DecodeTransform() const {
+    return decodeTransform(transform, true);
+}
+
+Packet PacketView::ToPacket(bool viewer) const {
+    Packet packet;
+    packet.type = type;
+    packet.encoding = encoding;
+    packet.opcode = opcode;
+    packet.offset = offset;
+    if (transform) {
+        packet.transform = decodeTransform(transform, viewer);
+    }
+    packet.data.color = color;
+    packet.data.name.assign(name.data(), name.size());
+    packet.data.positions.resize(count);
+    decodePositions(positions, encoding, count, viewer, packet.data.positions.data());
+    if (colors) {
+        packet.data.colors.resize(count);
+        DecodeColorsTo(packet.data.colors.data());
+    }
+    if (normals) {
+        packet.data.normals.resize(count);
+        decodePositions(normals, PositionEncoding::Float32, count, viewer, packet.data.normals.data());
+    }
+    if (indices) {
+        packet.data.indices.resize(indexCount);
+        DecodeIndicesTo(packet.data.indices.data(), 0, UINT32_MAX);
+    }
+    return packet;
+}
+
+Batch::Writer::Writer(std::vector<uint8_t>& buf): buf_(buf), countPos_(buf.size()) {
+    buf_.resize(countPos_ + sizeof(count_));
+    writeValue(buf_.data() + countPos_, count_);
+}
+
+void Batch::Writer::Add(const Packet& packet, uint32_t nameId) {
+    size_t recordPos = beginRecord();
+    packet.SerializeTo(buf_, nameId);
+    endRecord(recordPos, packet.opcode);
+}
+
+void Batch::Writer::Add(const NameDeclaration& declaration) {
+    size_t recordPos = beginRecord();
+    declaration.SerializeTo(buf_);
+    endRecord(recordPos, Opcode::Declare);
+}
+
+size_t Batch::Writer::beginRecord() {
+    // serialize in place, then fill in the record header in front of it
+    size_t recordPos = buf_.size();
+    buf_.resize(recordPos + RecordHeaderSchema::Size);
+    return recordPos;
+}
+
+void Batch::Writer::endRecord(size_t recordPos, Opcode opcode) {
+    RecordHeader header;
+    header.opcode = opcode;
+    header.length = buf_.size() - recordPos - RecordHeaderSchema::Size;
+    RecordHeaderSchema::Write(header, buf_.data() + recordPos);
+    writeValue(buf_.data() + countPos_, ++count_);
+}
+
+void Batch::SerializeTo(std::vector<uint8_t>& buf, const Packet* packets, size_t count) {
+    Writer writer(buf);
+    for (size_t i = 0; i < count; i++) {
+        writer.Add(packets[i]);
+    }
+}
+
+bool Batch::Parse(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views) {
+    wire::Reader reader(beg, end);
     uint32_t count = 0;
-    memcpy(&count, ptr, sizeof(count));
-    ptr += 4;
-
-    std::vector<Vec3> positions;
-    // serialize positions
-    for (int i = 0; i < count; i++) {
-        double x, y, z;
-        memcpy(&x, ptr, sizeof(double));
-        ptr += sizeof(double);
-        memcpy(&y, ptr, sizeof(double));
-        ptr += sizeof(double);
-        memcpy(&z, ptr, sizeof(double));
-        ptr += sizeof(double);
-        positions.push_back(Vec3(x, y, z));
-    }
-
-    // serialize color
-    double x, y, z;
-    memcpy(&x, ptr, sizeof(double));
-    ptr += sizeof(double);
-    memcpy(&y, ptr, sizeof(double));
-    ptr += sizeof(double);
-    memcpy(&z, ptr, sizeof(double));
-    ptr += sizeof(double);
-
-    // serialize name
-    std::string name;
-    while (ptr < end) {
-        name.push_back(*ptr);
-        ptr ++;
-    }
-
-    // compose packet
-    NetData data;
-    data.positions = positions;
-    data.color = Vec3(x, y, z);
-    data.name = name;
-    return Packet {type, data};
-}
\ No newline at end of file
+    if (!reader.Read(count)) {
+        return false;
+    }
+    views.reserve(views.size() + std::min<size_t>(count, reader.Remaining() / RecordHeaderSchema::Size));
+
+    for (uint32_t i = 0; i < count; i++) {
+        RecordHeader header;
+        if (!reader.ReadRecord<RecordHeaderSchema>(header)) {
+            return false;
+        }
+        const uint8_t* record = reader.Take(header.length);
+        if (!record) {
+            return false;
+        }
+
+        switch (header.opcode) {
+            case Opcode::Mesh:
+            case Opcode::Append:
+            case Opcode::Replace:
+            case Opcode::Declare:
+            case Opcode::Transform:
+                if (auto view = PacketView::Parse(record, record + header.length, header.opcode); view) {
+                    views.push_back(view.value());
+                }
+                break;
+            default:
+                LOGW("[NET]: unknown opcode ", (int)header.opcode, " in batch, record dropped");
+                break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,383 @@
+#include "netdata.hpp"
+#include <algorithm>
+#include <random>
+
+namespace {
+
+void serializePayload(std::vector<uint8_t>& buf, Opcode opcode, const Packet* packets, size_t count) {
+    if (opcode == Opcode::Batch) {
+        Batch::SerializeTo(buf, packets, count);
+    } else {
+        packets[0].SerializeTo(buf);
+    }
+}
+
+}
+
+NetSender::NetSender(std::unique_ptr<net::Net>& net, uint32_t port)
+    : NetSender(net, Endpoint::Tcp("localhost", port)) {}
+
+NetSender::NetSender(std::unique_ptr<net::Net>& net, uint32_t port, const AsyncConfig& config)
+    : NetSender(net, Endpoint::Tcp("localhost", port), config) {}
+
+NetSender::NetSender(std::unique_ptr<net::Net>& net, const Endpoint& endpoint) {
+    connect(net, endpoint);
+}
+
+NetSender::NetSender(std::unique_ptr<net::Net>& net, const Endpoint& endpoint, const AsyncConfig& config) {
+    connect(net, endpoint);
+    async_ = std::make_unique<AsyncState>(config);
+    async_->flusher = std::thread(&NetSender::flushLoop, this);
+}
+
+NetSender::~NetSender() {
+    if (async_) {
+        async_->running = false;
+        async_->filled.Notify();
+        async_->flusher.join();
+    }
+    if (socket_) {
+        socket_->Close();
+    }
+}
+
+void NetSender::connect(std::unique_ptr<net::Net>& net, const Endpoint& endpoint) {
+    if (endpoint.kind == Endpoint::Kind::Shm) {
+        shm_ = ShmRing::Open(endpoint.name);
+        if (!shm_) {
+            LOGE("open shared memory ", endpoint.name, " failed!");
+        }
+        return;
+    }
+
+    if (endpoint.kind == Endpoint::Kind::Unix) {
+        auto result = net::AddrInfoBuilder::CreateUnix(endpoint.name).Build();
+        if (result.result != 0) {
+            LOGE("create unix socket ", endpoint.name, " failed!");
+            return;
+        }
+        socket_ = net->CreateSocket(result.value);
+        socket_->Connect();
+        return;
+    }
+
+    if (endpoint.kind == Endpoint::Kind::Udp) {
+        auto result = net::AddrInfoBuilder::CreateUDP(endpoint.host, endpoint.port).Build();
+        if (result.result != 0) {
+            LOGE("create udp on ", endpoint.host, ":", endpoint.port, " failed!");
+            return;
+        }
+        datagram_ = true;
+        session_ = std::random_device{}();
+        // a connected UDP socket can use plain `send`
+        socket_ = net->CreateSocket(result.value);
+        socket_->Connect();
+        return;
+    }
+
+    auto result = net::AddrInfoBuilder::CreateTCP(endpoint.host, endpoint.port).Build();
+    if (result.result != 0) {
+        LOGE("create tcp on ", endpoint.host, ":", endpoint.port, " failed!");
+    }
+
+    socket_ = net->CreateSocket(result.value);
+    socket_->Connect();
+}
+
+bool NetSender::write(const net::IoSlice* slices, size_t count) {
+    if (shm_) {
+        if (!shm_->Write(slices, count)) {
+            LOGI("shared memory reader is gone");
+            shm_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+    if (!socket_) {
+        return false;
+    }
+    if (auto result = socket_->SendV(slices, count); result.result != 0) {
+        // nobody listening is normal for fire-and-forget datagrams
+        if (!datagram_ || result.result != net::ErrConnRefused) {
+            LOGI("connect lost: ", net::Error2Str(result.result));
+        }
+        return false;
+    }
+    return true;
+}
+
+size_t NetSender::headerSize() const {
+    return FrameHeader::Size + (datagram_ ? SequenceTag::Size : 0);
+}
+
+void NetSender::writeHeader(uint8_t* buf, Opcode opcode, size_t payloadSize, uint16_t flags) {
+    FrameHeader header;
+    header.opcode = opcode;
+    header.flags = flags;
+    header.length = payloadSize;
+    if (datagram_) {
+        SequenceTag tag;
+        tag.session = session_;
+        tag.sequence = ++sequence_;
+        tag.Write(buf + FrameHeader::Size);
+        header.flags |= FrameHeader::FlagSequenced;
+        header.length += SequenceTag::Size;
+    }
+    header.Write(buf);
+}
+
+void NetSender::SetNameInterning(bool enable) {
+    if (enable && (datagram_ || (async_ && async_->config.policy == OverflowPolicy::DropOldest))) {
+        LOGW("name interning needs every frame delivered, not available over udp or with DropOldest");
+        return;
+    }
+    names_ = enable ? std::make_unique<NameIds>() : nullptr;
+}
+
+Opcode NetSender::serialize(std::vector<uint8_t>& buf, Opcode opcode, const Packet* packets, size_t count,
+                            NameScratch& scratch) {
+    scratch.fresh.clear();
+    if (!names_) {
+        serializePayload(buf, opcode, packets, count);
+        return opcode;
+    }
+
+    auto& ids = scratch.ids;
+    auto& fresh = scratch.fresh;
+    ids.assign(count, Packet::NoNameId);
+    {
+        std::lock_guard guard(names_->mutex);
+        for (size_t i = 0; i < count; i++) {
+            uint32_t next = names_->entries.size();
+            auto it = names_->entries.find(packets[i].data.name);
+            if (it == names_->entries.end()) {
+                if (next >= NameDeclaration::MaxIds) {
+                    continue;   // out of ids, the name goes in full
+                }
+                it = names_->entries.emplace(packets[i].data.name, NameIds::Entry{next, false}).first;
+                fresh.push_back(i);
+                ids[i] = next;
+            } else if (it->second.declared) {
+                ids[i] = it->second.id;
+            }
+        }
+    }
+
+    if (fresh.empty() && opcode != Opcode::Batch) {
+        packets[0].SerializeTo(buf, ids[0]);
+        return opcode;
+    }
+    // the declarations go first, in the same frame as their first use
+    Batch::Writer writer(buf);
+    for (size_t i : fresh) {
+        writer.Add(NameDeclaration{ids[i], packets[i].data.name});
+    }
+    for (size_t i = 0; i < count; i++) {
+        writer.Add(packets[i], ids[i]);
+    }
+    return Opcode::Batch;
+}
+
+void NetSender::markDeclared(const Packet* packets, const std::vector<size_t>& fresh) {
+    if (fresh.empty()) {
+        return;
+    }
+    std::lock_guard guard(names_->mutex);
+    for (size_t i : fresh) {
+        names_->entries.find(packets[i].data.name)->second.declared = true;
+    }
+}
+
+void NetSender::SendPacket(const Packet& packet) {
+    send(packet.opcode, &packet, 1);
+}
+
+void NetSender::SendBatch(const std::vector<Packet>& packets) {
+    if (!packets.empty()) {
+        send(Opcode::Batch, packets.data(), packets.size());
+    }
+}
+
+void NetSender::send(Opcode opcode, const Packet* packets, size_t count) {
+    // a transform replaces the last one, a lost or late one does no harm
+    if (datagram_ && std::any_of(packets, packets + count, [](const Packet& p) {
+            return p.opcode == Opcode::Append || p.opcode == Opcode::Replace;
+        })) {
+        LOGW("packet ", packets[0].data.name, " updates a vertex range, it can't go over udp");
+        droppedPackets_ ++;
+        if (async_) {
+            async_->queued ++;
+        }
+        return;
+    }
+    if (async_) {
+        enqueue(opcode, packets, count);
+        return;
+    }
+
+    // `sendBuf_` keeps its capacity, steady state sends don't allocate
+    sendBuf_.clear();
+    opcode = serialize(sendBuf_, opcode, packets, count, scratch_);
+    markDeclared(packets, scratch_.fresh);  // a stream keeps the order, nothing can overtake this frame
+    uint16_t flags = 0;
+    if (compressAbove_ && sendBuf_.size() >= compressAbove_) {
+        compressBuf_.clear();
+        if (BlockCodec::Compress(sendBuf_.data(), sendBuf_.size(), compressBuf_)) {
+            std::swap(sendBuf_, compressBuf_);
+            flags |= FrameHeader::FlagCompressed;
+        }
+    }
+
+    uint8_t headerBuf[FrameHeader::Size + SequenceTag::Size];
+    writeHeader(headerBuf, opcode, sendBuf_.size(), flags);
+    uint64_t bytes = headerSize() + sendBuf_.size();
+    if (datagram_ && bytes > MaxDatagram) {
+        LOGW("packet ", packets[0].data.name, " doesn't fit in a datagram, dropped");
+        droppedPackets_ ++;
+        droppedBytes_ += bytes;
+        return;
+    }
+
+    net::IoSlice slices[] = {
+        {headerBuf, headerSize()},
+        {sendBuf_.data(), sendBuf_.size()},
+    };
+    if (write(slices, 2)) {
+        sentPackets_ ++;
+        sentBytes_ += bytes;
+    } else {
+        droppedPackets_ ++;
+        droppedBytes_ += bytes;
+    }
+}
+
+void NetSender::enqueue(Opcode opcode, const Packet* packets, size_t count) {
+    std::vector<uint8_t> frame;
+    if (async_->spare.TryPop(frame)) {
+        frame.clear();
+    }
+    frame.resize(headerSize());
+    // producers enqueue concurrently, each thread reuses its own
+    thread_local NameScratch scratch;
+    opcode = serialize(frame, opcode, packets, count, scratch);
+    uint16_t flags = 0;
+    if (compressAbove_ && frame.size() - headerSize() >= compressAbove_) {
+        // compressed on the producer's thread, so the flusher only writes
+        std::vector<uint8_t> packed;
+        if (async_->spare.TryPop(packed)) {
+            packed.clear();
+        }
+        packed.resize(headerSize());
+        if (BlockCodec::Compress(frame.data() + headerSize(), frame.size() - headerSize(), packed)) {
+            std::swap(frame, packed);
+            flags |= FrameHeader::FlagCompressed;
+        }
+        async_->spare.TryPush(packed);
+    }
+    writeHeader(frame.data(), opcode, frame.size() - headerSize(), flags);
+    async_->queued ++;
+    if (datagram_ && frame.size() > MaxDatagram) {
+        LOGW("packet ", packets[0].data.name, " doesn't fit in a datagram, dropped");
+        droppedPackets_ ++;
+        droppedBytes_ += frame.size();
+        async_->spare.TryPush(frame);
+        async_->drained.Notify();
+        return;
+    }
+
+    while (!async_->queue.TryPush(frame)) {
+        if (async_->config.policy == OverflowPolicy::DropOldest) {
+            std::vector<uint8_t> oldest;
+            if (async_->queue.TryPop(oldest)) {
+                droppedPackets_ ++;
+                droppedBytes_ += oldest.size();
+                async_->spare.TryPush(oldest);
+                async_->drained.Notify();
+            }
+        } else {
+            // the timeout only covers a flusher that pops between our check and its notify
+            async_->drained.Wait([this]() { return async_->queue.Size() < async_->queue.Capacity(); },
+                                 std::chrono::milliseconds(10));
+        }
+    }
+    async_->filled.Notify();
+    // only now can frames of other threads refer to the new ids, they are queued behind this one
+    markDeclared(packets, scratch.fresh);
+}
+
+void NetSender::Flush() {
+    if (!async_) {
+        return;
+    }
+    auto done = [this]() { return sentPackets_ + droppedPackets_ >= async_->queued; };
+    while (!async_->drained.Wait(done, std::chrono::milliseconds(100))) { }
+}
+
+SenderStats NetSender::Stats() const {
+    SenderStats stats;
+    stats.sentPackets = sentPackets_;
+    stats.sentBytes = sentBytes_;
+    stats.droppedPackets = droppedPackets_;
+    stats.droppedBytes = droppedBytes_;
+    return stats;
+}
+
+void NetSender::flushLoop() {
+    std::vector<uint8_t> batch;
+    batch.reserve(async_->config.maxBatchBytes);
+    std::vector<uint8_t> frame;
+
+    while (true) {
+        // copy small frames into one batch, big ones go out as their own slice.
+        // datagrams can't be coalesced, every one goes out alone
+        batch.clear();
+        uint64_t batchPackets = 0;
+        bool sentAny = false;
+        while (batch.size() < async_->config.maxBatchBytes && async_->queue.TryPop(frame)) {
+            // room for a blocked producer, `Flush` waits for the write below
+            async_->drained.Notify();
+            if (!datagram_ && frame.size() < async_->config.maxBatchBytes / 16) {
+                batch.insert(batch.end(), frame.begin(), frame.end());
+                batchPackets ++;
+            } else {
+                net::IoSlice slices[] = {
+                    {batch.data(), batch.size()},
+                    {frame.data(), frame.size()},
+                };
+                uint64_t bytes = batch.size() + frame.size();
+                if (write(slices, 2)) {
+                    sentBytes_ += bytes;
+                    sentPackets_ += batchPackets + 1;
+                } else {
+                    droppedBytes_ += bytes;
+                    droppedPackets_ += batchPackets + 1;
+                }
+                batch.clear();
+                batchPackets = 0;
+                sentAny = true;
+            }
+            async_->spare.TryPush(frame);
+        }
+
+        if (!batch.empty()) {
+            net::IoSlice slice{batch.data(), batch.size()};
+            if (write(&slice, 1)) {
+                sentBytes_ += batch.size();
+                sentPackets_ += batchPackets;
+            } else {
+                droppedBytes_ += batch.size();
+                droppedPackets_ += batchPackets;
+            }
+            sentAny = true;
+        }
+
+        if (sentAny) {
+            async_->drained.Notify();
+        } else if (!async_->running) {
+            return;
+        } else {
+            async_->filled.Wait([this]() { return async_->queue.Size() > 0 || !async_->running; },
+                                std::chrono::milliseconds(100));
+        }
+    }
+}
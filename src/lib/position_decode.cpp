@@ -0,0 +1,183 @@
+#include "position_decode.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define VDBG_DECODE_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+// the helpers must be inlined into the AVX2 kernel even at -O0: called, they are
+// legacy SSE code and every switch from the kernel's VEX code costs a stall
+#define VDBG_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define VDBG_ALWAYS_INLINE inline
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define VDBG_DECODE_AVX2 1
+#define VDBG_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define VDBG_DECODE_AVX2 1
+#define VDBG_TARGET_AVX2
+#endif
+#endif
+
+namespace {
+
+void decodeFloat64Scalar(const uint8_t* src, size_t count, bool swapYZ, float* dst) {
+    int y = swapYZ ? 2 : 1;
+    int z = swapYZ ? 1 : 2;
+    for (size_t i = 0; i < count; i++) {
+        double v[3];
+        memcpy(v, src, sizeof(v));
+        src += sizeof(v);
+        dst[0] = static_cast<float>(v[0]);
+        dst[y] = static_cast<float>(v[1]);
+        dst[z] = static_cast<float>(v[2]);
+        dst += 3;
+    }
+}
+
+void decodeFloat32Scalar(const uint8_t* src, size_t count, bool swapYZ, float* dst) {
+    if (!swapYZ) {
+        memcpy(dst, src, count * sizeof(float) * 3);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        float v[3];
+        memcpy(v, src, sizeof(v));
+        src += sizeof(v);
+        dst[0] = v[0];
+        dst[1] = v[2];
+        dst[2] = v[1];
+        dst += 3;
+    }
+}
+
+#ifdef VDBG_DECODE_SSE2
+
+/* four vertices sit in three registers:
+     a = x0 y0 z0 x1   b = y1 z1 x2 y2   c = z2 x3 y3 z3
+   swap y and z of each without leaving the registers */
+VDBG_ALWAYS_INLINE void swapYZ4(__m128& a, __m128& b, __m128& c) {
+    __m128 b2b3c0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 3, 2));
+    __m128 b3c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 3, 3));
+    a = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 2, 0));
+    c = _mm_shuffle_ps(b3c1, c, _MM_SHUFFLE(2, 3, 2, 0));
+    b = _mm_shuffle_ps(b, b2b3c0, _MM_SHUFFLE(2, 0, 0, 1));
+}
+
+VDBG_ALWAYS_INLINE void store4(float* dst, __m128 a, __m128 b, __m128 c, bool swapYZ) {
+    if (swapYZ) {
+        swapYZ4(a, b, c);
+    }
+    _mm_storeu_ps(dst, a);
+    _mm_storeu_ps(dst + 4, b);
+    _mm_storeu_ps(dst + 8, c);
+}
+
+size_t decodeFloat64SSE2(const uint8_t* src, size_t count, bool swapYZ, float* dst) {
+    const double* s = reinterpret_cast<const double*>(src);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, s += 12, dst += 12) {
+        __m128 a = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s)), _mm_cvtpd_ps(_mm_loadu_pd(s + 2)));
+        __m128 b = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 4)), _mm_cvtpd_ps(_mm_loadu_pd(s + 6)));
+        __m128 c = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(s + 8)), _mm_cvtpd_ps(_mm_loadu_pd(s + 10)));
+        store4(dst, a, b, c, swapYZ);
+    }
+    return i;
+}
+
+size_t decodeFloat32SSE2(const uint8_t* src, size_t count, float* dst) {
+    const float* s = reinterpret_cast<const float*>(src);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, s += 12, dst += 12) {
+        store4(dst, _mm_loadu_ps(s), _mm_loadu_ps(s + 4), _mm_loadu_ps(s + 8), true);
+    }
+    return i;
+}
+
+#endif
+
+#ifdef VDBG_DECODE_AVX2
+
+VDBG_TARGET_AVX2
+size_t decodeFloat64AVX2(const uint8_t* src, size_t count, bool swapYZ, float* dst) {
+    const double* s = reinterpret_cast<const double*>(src);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4, s += 12, dst += 12) {
+        // one 256 bit load converts four doubles at once
+        __m128 a = _mm256_cvtpd_ps(_mm256_loadu_pd(s));
+        __m128 b = _mm256_cvtpd_ps(_mm256_loadu_pd(s + 4));
+        __m128 c = _mm256_cvtpd_ps(_mm256_loadu_pd(s + 8));
+        store4(dst, a, b, c, swapYZ);
+    }
+    // the scalar tail and the caller are SSE code
+    _mm256_zeroupper();
+    return i;
+}
+
+bool cpuHasAVX2() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return true;    // only built when the compiler targets AVX2 anyway
+#endif
+}
+
+#endif
+
+}
+
+DecodeKernel BestDecodeKernel() {
+    static const DecodeKernel best = []() {
+#ifdef VDBG_DECODE_AVX2
+        if (cpuHasAVX2()) {
+            return DecodeKernel::AVX2;
+        }
+#endif
+#ifdef VDBG_DECODE_SSE2
+        return DecodeKernel::SSE2;
+#else
+        return DecodeKernel::Scalar;
+#endif
+    }();
+    return best;
+}
+
+const char* DecodeKernelName(DecodeKernel kernel) {
+    switch (kernel) {
+        case DecodeKernel::Scalar: return "scalar";
+        case DecodeKernel::SSE2: return "sse2";
+        case DecodeKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+void DecodeFloat64Positions(const uint8_t* src, size_t count, bool swapYZ, float* dst, DecodeKernel kernel) {
+    size_t done = 0;
+    switch (kernel) {
+#ifdef VDBG_DECODE_AVX2
+        case DecodeKernel::AVX2:
+            done = decodeFloat64AVX2(src, count, swapYZ, dst);
+            break;
+#endif
+#ifdef VDBG_DECODE_SSE2
+        case DecodeKernel::SSE2:
+            done = decodeFloat64SSE2(src, count, swapYZ, dst);
+            break;
+#endif
+        default:
+            break;
+    }
+    decodeFloat64Scalar(src + done * sizeof(double) * 3, count - done, swapYZ, dst + done * 3);
+}
+
+void DecodeFloat32Positions(const uint8_t* src, size_t count, bool swapYZ, float* dst, DecodeKernel kernel) {
+    size_t done = 0;
+#ifdef VDBG_DECODE_SSE2
+    // nothing to convert, AVX2 wouldn't beat the SSE shuffles
+    if (swapYZ && kernel != DecodeKernel::Scalar) {
+        done = decodeFloat32SSE2(src, count, dst);
+    }
+#endif
+    decodeFloat32Scalar(src + done * sizeof(float) * 3, count - done, swapYZ, dst + done * 3);
+}
@@ -0,0 +1,441 @@
+#include "reactor.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace {
+
+// io_uring user data of listeners, connections use their id
+constexpr uint64_t ListenerUserData = 1ull << 63;
+constexpr uint64_t WakeUserData = 1ull << 62;
+
+}
+
+void Reactor::Connection::RecordLatency(Clock::time_point readyAt) {
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - readyAt).count();
+    latencyCount ++;
+    latencySumUs += us;
+    uint64_t oldMax = latencyMaxUs.load();
+    while (us > oldMax && !latencyMaxUs.compare_exchange_weak(oldMax, us)) { }
+}
+
+Reactor::Reactor(PacketHandler handler, uint32_t decodeThreads, Backend backend): handler_(std::move(handler)) {
+    if (backend == Backend::Uring) {
+        uring_ = IoUring::Create();
+        if (!uring_) {
+            LOGW("[NET]: io_uring unavailable, falling back to polling");
+        }
+    }
+#ifdef __linux__
+    if (uring_) {
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+#endif
+#ifndef _WIN32
+    reserveFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+#endif
+    if (!poller_.Valid()) {
+        LOGE("[NET]: create poller failed: ", net::GetLastError());
+    }
+    for (uint32_t i = 0; i < decodeThreads; i++) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+}
+
+Reactor::~Reactor() {
+    Stop();
+#ifndef _WIN32
+    if (reserveFd_ >= 0) {
+        ::close(reserveFd_);
+    }
+    if (wakeFd_ >= 0) {
+        ::close(wakeFd_);
+    }
+#endif
+}
+
+bool Reactor::Listen(net::Socket* listener) {
+    listener->SetNonblock(true);
+    listeners_.push_back(listener);
+    if (uring_) {
+        // armed by `runUring`
+        return true;
+    }
+    // user data 0 marks a listener, connections use their id
+    return poller_.Add(listener->Handle(), nullptr);
+}
+
+void Reactor::Add(std::unique_ptr<net::Socket>&& client) {
+    client->SetNonblock(true);
+    auto handle = client->Handle();
+
+    std::lock_guard guard(connMutex_);
+    uint64_t id = nextId_++;
+    auto conn = std::make_shared<Connection>(id, std::move(client));
+    conn->handle = handle;
+    conns_.emplace(id, conn);
+    if (uring_) {
+        // the ring belongs to the I/O thread, it arms the recv
+        unarmed_.push_back(id);
+    } else if (!poller_.Add(handle, reinterpret_cast<void*>(id))) {
+        LOGE("[NET]: watch client failed: ", net::GetLastError());
+        conns_.erase(id);
+    }
+}
+
+void Reactor::Start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    for (auto& worker : workers_) {
+        worker->thread = std::thread(&Reactor::workerRun, this, std::ref(*worker));
+    }
+    ioThread_ = std::thread(uring_ ? &Reactor::runUring : &Reactor::run, this);
+}
+
+void Reactor::Stop() {
+    if (!running_) {
+        return;
+    }
+    running_ = false;
+    if (ioThread_.joinable()) {
+        ioThread_.join();
+    }
+    for (auto& worker : workers_) {
+        {
+            std::lock_guard guard(worker->mutex);
+        }
+        worker->cond.notify_all();
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        worker->jobs.clear();
+        worker->queuedBytes = 0;
+        worker->paused.clear();
+    }
+
+    std::lock_guard guard(connMutex_);
+    conns_.clear();
+}
+
+std::vector<ConnectionStats> Reactor::Stats() const {
+    std::vector<ConnectionStats> stats;
+    auto now = Clock::now();
+
+    std::lock_guard guard(connMutex_);
+    for (const auto& [id, conn] : conns_) {
+        ConnectionStats stat;
+        stat.id = id;
+        stat.bytes = conn->bytes;
+        stat.packets = conn->packets;
+        stat.seconds = std::chrono::duration<double>(now - conn->connectedAt).count();
+        uint64_t count = conn->latencyCount;
+        stat.avgLatencyMs = count > 0 ? conn->latencySumUs / double(count) / 1000.0 : 0;
+        stat.maxLatencyMs = conn->latencyMaxUs / 1000.0;
+        stat.pauses = conn->pauses;
+        stats.push_back(stat);
+    }
+    std::sort(stats.begin(), stats.end(), [](const ConnectionStats& a, const ConnectionStats& b) {
+        return a.id < b.id;
+    });
+    return stats;
+}
+
+void Reactor::run() {
+    std::vector<net::Poller::Event> events;
+
+    while (running_) {
+        // wake up now and then to notice `Stop()`
+        if (poller_.Wait(events, 100) <= 0) {
+            continue;
+        }
+
+        for (const auto& event : events) {
+            if (event.userData == nullptr) {
+                acceptAll();
+                continue;
+            }
+
+            std::shared_ptr<Connection> conn;
+            {
+                std::lock_guard guard(connMutex_);
+                auto it = conns_.find(reinterpret_cast<uint64_t>(event.userData));
+                if (it == conns_.end()) {
+                    continue;
+                }
+                conn = it->second;
+            }
+            onReadable(conn);
+        }
+    }
+}
+
+void Reactor::runUring() {
+    for (size_t i = 0; i < listeners_.size(); i++) {
+        uring_->PollIn(listeners_[i]->Handle(), ListenerUserData | i);
+    }
+    if (wakeFd_ >= 0) {
+        uring_->PollIn(wakeFd_, WakeUserData);
+    }
+
+    std::vector<IoUring::Completion> completions;
+    std::vector<uint64_t> unarmed;
+    while (running_) {
+        {
+            std::lock_guard guard(connMutex_);
+            unarmed.swap(unarmed_);
+            for (auto id : unarmed) {
+                // a paused connection whose recv is still being cancelled is armed once that completes
+                if (auto it = conns_.find(id); it != conns_.end() && !it->second->armed && !it->second->paused) {
+                    arm(*it->second);
+                }
+            }
+        }
+        unarmed.clear();
+
+        // wake up now and then to notice `Stop()`
+        if (uring_->Wait(completions, 100) <= 0) {
+            continue;
+        }
+
+        auto readyAt = Clock::now();
+        for (const auto& completion : completions) {
+#ifdef __linux__
+            if (completion.userData == WakeUserData) {
+                uint64_t count;
+                while (read(wakeFd_, &count, sizeof(count)) < 0 && errno == EINTR) { }
+                if (!completion.more) {
+                    uring_->PollIn(wakeFd_, WakeUserData);
+                }
+                continue;
+            }
+#endif
+            if (completion.userData & ListenerUserData) {
+                acceptAll();
+                if (!completion.more) {
+                    auto index = completion.userData & ~ListenerUserData;
+                    uring_->PollIn(listeners_[index]->Handle(), completion.userData);
+                }
+                continue;
+            }
+
+            std::shared_ptr<Connection> conn;
+            {
+                std::lock_guard guard(connMutex_);
+                if (auto it = conns_.find(completion.userData); it != conns_.end()) {
+                    conn = it->second;
+                }
+            }
+            if (conn) {
+                onReceived(conn, completion, readyAt);
+            } else if (completion.bufferId >= 0) {
+                uring_->ReleaseBuffer(completion.bufferId);
+            }
+        }
+    }
+}
+
+void Reactor::acceptAll() {
+    // listeners are few and non-blocking, just try all of them
+    for (auto listener : listeners_) {
+        while (true) {
+            auto client = listener->Accept();
+            if (!client.value) {
+                if (refuse(*listener, client.result)) {
+                    continue;
+                }
+                break;
+            }
+            if (!client.value->Valid()) {
+                LOGI("client not valid");
+                continue;
+            }
+            LOGI("connected client");
+            Add(std::move(client.value));
+        }
+    }
+}
+
+bool Reactor::refuse(net::Socket& listener, int error) {
+#ifdef _WIN32
+    return false;
+#else
+    if (error != EMFILE && error != ENFILE) {
+        return false;
+    }
+    // the pending client keeps the listener readable, so accept it with the reserve
+    // descriptor and close it rather than being woken up for it again and again
+    if (reserveFd_ >= 0) {
+        ::close(reserveFd_);
+        reserveFd_ = -1;
+        auto client = listener.Accept();
+        reserveFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (client.value) {
+            LOGW("[NET]: out of file descriptors, refused a client");
+            return reserveFd_ >= 0;
+        }
+        return false;
+    }
+    // another thread took the reserve, back off instead of spinning
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reserveFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return false;
+#endif
+}
+
+void Reactor::queue(const std::shared_ptr<Connection>& conn, Job&& job) {
+    auto& worker = *workers_[conn->id % workers_.size()];
+    std::lock_guard guard(worker.mutex);
+    worker.queuedBytes += job.bytes.size();
+    worker.jobs.push_back(std::move(job));
+    worker.cond.notify_one();
+    if (worker.queuedBytes < queueLimit_ || conn->paused) {
+        return;
+    }
+
+    // stop reading until the worker resumes it, under its lock so that can't happen first
+    conn->paused = true;
+    conn->pauses ++;
+    worker.paused.push_back(conn);
+    if (!uring_) {
+        poller_.Remove(conn->handle);
+    } else if (conn->armed && uring_->Cancel(conn->id)) {
+        // the multishot recv keeps filling buffers until the kernel sees this
+        uring_->Submit();
+    }
+}
+
+void Reactor::resume(const std::shared_ptr<Connection>& conn) {
+    std::lock_guard guard(connMutex_);
+    if (conns_.find(conn->id) == conns_.end()) {
+        // closed while paused
+        return;
+    }
+    if (!uring_) {
+        if (!poller_.Add(conn->handle, reinterpret_cast<void*>(conn->id))) {
+            LOGE("[NET]: watch client failed: ", net::GetLastError());
+        }
+        return;
+    }
+    unarmed_.push_back(conn->id);
+#ifdef __linux__
+    // otherwise `runUring` notices at its next timeout
+    if (wakeFd_ >= 0) {
+        uint64_t one = 1;
+        while (write(wakeFd_, &one, sizeof(one)) < 0 && errno == EINTR) { }
+    }
+#endif
+}
+
+void Reactor::arm(Connection& conn) {
+    conn.armed = uring_->Recv(conn.handle, conn.id);
+}
+
+void Reactor::onReadable(const std::shared_ptr<Connection>& conn) {
+    auto readyAt = Clock::now();
+
+    if (workers_.empty()) {
+        conn->recv.RecvPacket([&](const std::vector<PacketView>& packets) {
+            conn->packets += packets.size();
+            handler_(packets);
+            conn->RecordLatency(readyAt);
+        });
+        conn->bytes = conn->recv.BytesReceived();
+    } else {
+        Job job{conn, {}, readyAt};
+        int len = conn->recv.RecvBytes(job.bytes);
+        conn->bytes = conn->recv.BytesReceived();
+        if (len > 0) {
+            queue(conn, std::move(job));
+        }
+    }
+
+    if (!conn->recv) {
+        close(conn);
+    }
+}
+
+void Reactor::onReceived(const std::shared_ptr<Connection>& conn, const IoUring::Completion& completion,
+                         Clock::time_point readyAt) {
+    if (completion.bufferId >= 0) {
+        const uint8_t* data = uring_->Buffer(completion.bufferId);
+        conn->bytes += completion.result;
+
+        if (workers_.empty()) {
+            // whole frames are decoded straight from the kernel's buffer, which goes back once they're handled
+            conn->recv.Feed(data, data + completion.result, [&](const std::vector<PacketView>& packets) {
+                conn->packets += packets.size();
+                handler_(packets);
+                conn->RecordLatency(readyAt);
+            });
+            uring_->ReleaseBuffer(completion.bufferId);
+        } else {
+            Job job{conn, std::vector<uint8_t>(data, data + completion.result), readyAt};
+            uring_->ReleaseBuffer(completion.bufferId);
+            queue(conn, std::move(job));
+        }
+    }
+
+    if (!completion.more) {
+        conn->armed = false;
+    }
+    // a paused connection's recv ends with -ECANCELED
+    if (completion.result == 0 ||
+        (completion.result < 0 && completion.result != -ENOBUFS && completion.result != -ECANCELED)) {
+        if (completion.result < 0) {
+            LOGI("client ", conn->id, " recv failed: ", net::Error2Str(-completion.result));
+        }
+        close(conn);
+    } else if (!completion.more && !conn->paused) {
+        // out of buffers or the kernel ended the multishot recv, arm it again
+        arm(*conn);
+    }
+}
+
+void Reactor::workerRun(Worker& worker) {
+    std::vector<std::shared_ptr<Connection>> resumed;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(worker.mutex);
+            worker.cond.wait(lock, [&]() { return !worker.jobs.empty() || !running_; });
+            if (worker.jobs.empty()) {
+                return;
+            }
+            job = std::move(worker.jobs.front());
+            worker.jobs.pop_front();
+            worker.queuedBytes -= job.bytes.size();
+            if (worker.queuedBytes <= queueLimit_ / 2) {
+                for (auto& conn : worker.paused) {
+                    conn->paused = false;
+                }
+                resumed.swap(worker.paused);
+            }
+        }
+        for (auto& conn : resumed) {
+            resume(conn);
+        }
+        resumed.clear();
+
+        job.conn->recv.Feed(job.bytes.data(), job.bytes.data() + job.bytes.size(),
+                            [&](const std::vector<PacketView>& packets) {
+            job.conn->packets += packets.size();
+            handler_(packets);
+            job.conn->RecordLatency(job.readyAt);
+        });
+    }
+}
+
+void Reactor::close(const std::shared_ptr<Connection>& conn) {
+    LOGI("client ", conn->id, " disconnected");
+    if (uring_) {
+        // io_uring holds its own reference to the socket until the recv is cancelled
+        uring_->Cancel(conn->id);
+    } else {
+        poller_.Remove(conn->handle);
+    }
+    std::lock_guard guard(connMutex_);
+    conns_.erase(conn->id);
+}
@@ -17,12 +17,18 @@ Renderer& Renderer::Instance() {
 const char* FragSource = R"(
     #version 410 core
 
-    out vec4 FragColor;
+    in vec3 color;
+    in vec3 normal;
 
-    uniform vec3 color;
+    out vec4 FragColor;
 
     void main() {
-        FragColor = vec4(color, 1.0);
+        // meshes without normals stay unlit
+        float light = 1.0;
+        if (dot(normal, normal) > 0.0) {
+            light = 0.3 + 0.7 * abs(dot(normalize(normal), vec3(0.0, 0.0, 1.0)));
+        }
+        FragColor = vec4(color * light, 1.0);
     }
 )";
 
@@ -30,13 +36,20 @@ const char* VertexSource = R"(
     #version 410 core
 
     layout (location = 0) in vec3 inPosition;
+    layout (location = 1) in vec3 inColor;
+    layout (location = 2) in vec3 inNormal;
 
     uniform mat4 model;
     uniform mat4 view;
     uniform mat4 project;
 
+    out vec3 color;
+    out vec3 normal;
+
     void main() {
         gl_Position = project * view * model * vec4(inPosition, 1.0);
+        color = inColor;
+        normal = mat3(view * model) * inNormal;
     }
 )";
 
@@ -55,15 +68,22 @@ Renderer::Renderer() {
                 ShaderModule(ShaderModule::Type::Fragment, FragSource)); 
 
     arrayBuffer_ = std::make_unique<Buffer>(Buffer::Type::Array);
+    colorBuffer_ = std::make_unique<Buffer>(Buffer::Type::Array);
+    normalBuffer_ = std::make_unique<Buffer>(Buffer::Type::Array);
     indicesBuffer_ = std::make_unique<Buffer>(Buffer::Type::Element);
-    arrayBuffer_->Bind();
     indicesBuffer_->Bind();
 
-    // vertex attributes:
+    // vertex attributes, one buffer each. Colors and normals are only enabled
+    // for meshes that have them, the constant attribute value is used otherwise
     GL_CALL(glGenVertexArrays(1, &vao_));
     GL_CALL(glBindVertexArray(vao_));
+    arrayBuffer_->Bind();
     GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0));
     GL_CALL(glEnableVertexAttribArray(0));
+    colorBuffer_->Bind();
+    GL_CALL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0));
+    normalBuffer_->Bind();
+    GL_CALL(glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0));
     shader_->Use();
 }
 
@@ -89,21 +109,34 @@ GLenum meshtype2gl(Mesh::Type type) {
     }
 }
 
-void Renderer::Draw(const Mesh& mesh, const glm::mat4& model, const glm::vec3& color) {
+void Renderer::Draw(const MeshView& mesh, const glm::mat4& model, const glm::vec3& color) {
     shader_->SetMat4("model", model);
-    shader_->SetVec3("color", color);
 
-    arrayBuffer_->SetData((void*)mesh.vertices.data(), sizeof(Vertex) * mesh.vertices.size());
+    arrayBuffer_->SetData((void*)mesh.vertices, sizeof(Vertex) * mesh.vertexCount);
+    if (mesh.colors) {
+        colorBuffer_->SetData((void*)mesh.colors, sizeof(glm::vec3) * mesh.vertexCount);
+        GL_CALL(glEnableVertexAttribArray(1));
+    } else {
+        GL_CALL(glDisableVertexAttribArray(1));
+        GL_CALL(glVertexAttrib3f(1, color.r, color.g, color.b));
+    }
+    if (mesh.normals) {
+        normalBuffer_->SetData((void*)mesh.normals, sizeof(glm::vec3) * mesh.vertexCount);
+        GL_CALL(glEnableVertexAttribArray(2));
+    } else {
+        GL_CALL(glDisableVertexAttribArray(2));
+        GL_CALL(glVertexAttrib3f(2, 0, 0, 0));
+    }
 
     if (mesh.type == Mesh::Type::Points) {
         GL_CALL(glPointSize(5));
     } else {
         GL_CALL(glPointSize(1));
     }
-    if (mesh.indices) {
-        indicesBuffer_->SetData((void*)mesh.indices.value().data(), mesh.indices.value().size() * sizeof(uint32_t));
-        glDrawElements(meshtype2gl(mesh.type), mesh.indices.value().size(), GL_UNSIGNED_INT, 0);
+    if (mesh.indexed) {
+        indicesBuffer_->SetData((void*)mesh.indices, mesh.indexCount * sizeof(uint32_t));
+        glDrawElements(meshtype2gl(mesh.type), mesh.indexCount, GL_UNSIGNED_INT, 0);
     } else {
-        glDrawArrays(meshtype2gl(mesh.type), 0, mesh.vertices.size());
+        glDrawArrays(meshtype2gl(mesh.type), 0, mesh.vertexCount);
     }
 }
\ No newline at end of file
@@ -0,0 +1,717 @@
+#include "scene.hpp"
+#include <algorithm>
+
+std::optional<SceneCommand> SceneCommand::FromPacket(const PacketView& packet) {
+    auto& table = NameTable::Instance();
+    SceneCommand command;
+    // the receivers already resolved the name, no hashing here
+    command.id = packet.id != NameTable::None ? packet.id : table.Intern(packet.name);
+    command.name = table.Name(command.id);
+    command.color = packet.color;
+    command.mesh.type = packet.type;
+    switch (packet.opcode) {
+        case Opcode::Mesh:
+            command.kind = Kind::Mesh;
+            break;
+        case Opcode::Append:
+            command.kind = Kind::Append;
+            break;
+        case Opcode::Replace:
+            command.kind = Kind::Replace;
+            command.offset = packet.offset;
+            break;
+        case Opcode::Transform:
+            command.kind = Kind::Transform;
+            command.transform = packet.DecodeTransform();
+            return command;
+        default:
+            return std::nullopt;
+    }
+
+    auto& mesh = command.mesh;
+    mesh.vertices.resize(packet.count);
+    packet.DecodeTo(mesh.vertices.data());
+    if (packet.colors) {
+        mesh.colors.emplace(packet.count);
+        packet.DecodeColorsTo(mesh.colors->data());
+    }
+    if (packet.normals) {
+        mesh.normals.emplace(packet.count);
+        packet.DecodeNormalsTo(mesh.normals->data());
+    }
+    if (packet.indices && command.kind == Kind::Replace) {
+        LOGW("[SCENE]: indices of a replaced range are ignored");
+    } else if (packet.indices) {
+        mesh.indices.emplace(packet.indexCount);
+        if (!packet.DecodeIndicesTo(mesh.indices->data(), 0, packet.count)) {
+            if (command.kind == Kind::Mesh) {
+                LOGW("[SCENE]: ", packet.name, " has indices out of range, dropped");
+                return std::nullopt;
+            }
+            LOGW("[SCENE]: ", packet.name, " has indices out of range, they are dropped");
+            mesh.indices.reset();
+        }
+    }
+    return command;
+}
+
+const SceneSnapshot::Object* SceneSnapshot::Find(uint32_t id) const {
+    for (const auto& object : objects) {
+        if (object->id == id) {
+            return object.get();
+        }
+    }
+    return nullptr;
+}
+
+namespace {
+
+//! @brief no published snapshot can reach `ptr` any more, it may be changed in place
+template <typename T>
+bool unshared(const std::shared_ptr<T>& ptr) {
+    if (ptr.use_count() != 1) {
+        return false;
+    }
+    // pairs with the release of the last snapshot that let go, its reads are done
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return true;
+}
+
+//! @brief whether `n` more elements fit in `array` without reallocating, an absent one is made anew
+template <typename T>
+bool fits(const std::optional<std::vector<T>>& array, size_t n) {
+    return !array || array->size() + n <= array->capacity();
+}
+
+//! @brief a copy of `mesh` with room for `vertices` and `indices` more, and as much again
+Mesh copyWithRoom(const Mesh& mesh, size_t vertices, size_t indices) {
+    auto copy = [](auto& to, const auto& from, size_t more) {
+        to.reserve((from.size() + more) * 2);
+        to.assign(from.begin(), from.end());
+    };
+    Mesh result;
+    result.type = mesh.type;
+    copy(result.vertices, mesh.vertices, vertices);
+    if (mesh.indices) {
+        copy(result.indices.emplace(), *mesh.indices, indices);
+    }
+    if (mesh.colors) {
+        copy(result.colors.emplace(), *mesh.colors, vertices);
+    }
+    if (mesh.normals) {
+        copy(result.normals.emplace(), *mesh.normals, vertices);
+    }
+    return result;
+}
+
+//! @brief apply an `Append`/`Replace` command to `mesh` in place
+void applyRange(RenderData& data, Mesh& mesh, const SceneCommand& command) {
+    auto& vertices = mesh.vertices;
+    const auto& range = command.mesh;
+    size_t offset = command.kind == SceneCommand::Kind::Append ? vertices.size() : command.offset;
+    if (offset > vertices.size()) {
+        LOGW("[SCENE]: replace at ", offset, " is past the end of ", command.name, "(", vertices.size(), " vertices), dropped");
+        return;
+    }
+    // only grows when the range runs past the end, `vector` keeps spare capacity for the next append
+    if (offset + range.vertices.size() > vertices.size()) {
+        vertices.resize(offset + range.vertices.size());
+    }
+    std::copy(range.vertices.begin(), range.vertices.end(), vertices.begin() + offset);
+
+    // attributes keep one entry per vertex, vertices without their own get the defaults
+    if (range.colors || mesh.colors) {
+        if (!mesh.colors) {
+            mesh.colors.emplace();
+        }
+        mesh.colors->resize(vertices.size(), data.color);
+        if (range.colors) {
+            std::copy(range.colors->begin(), range.colors->end(), mesh.colors->begin() + offset);
+        }
+    }
+    if (range.normals || mesh.normals) {
+        if (!mesh.normals) {
+            mesh.normals.emplace();
+        }
+        mesh.normals->resize(vertices.size(), glm::vec3(0));
+        if (range.normals) {
+            std::copy(range.normals->begin(), range.normals->end(), mesh.normals->begin() + offset);
+        }
+    }
+
+    // appended indices are relative to the appended vertices
+    if (range.indices) {
+        if (!mesh.indices) {
+            mesh.indices.emplace();
+        }
+        for (uint32_t index : range.indices.value()) {
+            mesh.indices->push_back(index + offset);
+        }
+    }
+}
+
+}
+
+Scene::Scene() {
+    Publish();
+}
+
+void Scene::Apply(SceneCommand& command) {
+    switch (command.kind) {
+        case SceneCommand::Kind::Clear:
+            RemoveGroup(root_);
+            byName_.clear();
+            return;
+        case SceneCommand::Kind::Select:
+        case SceneCommand::Kind::Deselect:
+            if (auto* data = objects_.Get(Find(command.id)); data) {
+                data->selected = command.kind == SceneCommand::Kind::Select;
+                data->published.reset();
+            }
+            return;
+        case SceneCommand::Kind::Restore:
+            if (auto* data = objects_.Get(Find(command.id)); data) {
+                Restore(*data);
+            }
+            return;
+        case SceneCommand::Kind::HideGroup:
+        case SceneCommand::Kind::ShowGroup:
+            if (auto* group = FindGroup(command.name); group) {
+                group->hidden = command.kind == SceneCommand::Kind::HideGroup;
+            }
+            return;
+        case SceneCommand::Kind::RecolorGroup:
+            if (auto* group = FindGroup(command.name); group) {
+                RecolorGroup(*group, command.color);
+            }
+            return;
+        case SceneCommand::Kind::RemoveGroup:
+            if (auto* group = FindGroup(command.name); group) {
+                RemoveGroup(*group);
+            }
+            return;
+        case SceneCommand::Kind::Remove: {
+            auto handle = Find(command.id);
+            if (auto* data = objects_.Get(handle); data) {
+                // the group's last object takes its place
+                auto* group = data->group;
+                auto moved = group->objects.back();
+                group->objects[data->groupIndex] = moved;
+                objects_.Get(moved)->groupIndex = data->groupIndex;
+                group->objects.pop_back();
+                release(*data);
+                objects_.Remove(handle);
+                boundsChanged(group);
+                prune(group);
+            }
+            return;
+        }
+        case SceneCommand::Kind::Mesh: {
+            // new vertices, the object stays where it was moved to and keeps its selection
+            auto& data = objectOf(command);
+            drop(data);
+            data.mesh = std::make_shared<Mesh>(std::move(command.mesh));
+            data.color = command.color;
+            data.boundsDirty = true;
+            account(data, true);
+            break;
+        }
+        case SceneCommand::Kind::Transform: {
+            // something still moving is wanted on screen
+            auto& data = objectOf(command);
+            restore(data);
+            data.transform = command.transform;
+            data.boundsDirty = true;
+            account(data, true);
+            break;
+        }
+        case SceneCommand::Kind::Append:
+        case SceneCommand::Kind::Replace: {
+            auto& data = objectOf(command);
+            restore(data);
+            auto& mesh = editMesh(data, command);
+            size_t oldCount = mesh.vertices.size();
+            applyRange(data, mesh, command);
+            if (command.kind == SceneCommand::Kind::Append && !data.boundsDirty) {
+                // appended vertices only grow the box
+                for (size_t i = oldCount; i < mesh.vertices.size(); i++) {
+                    data.bounds.Add(glm::vec3(data.transform * glm::vec4(mesh.vertices[i].position, 1.0)));
+                }
+            } else {
+                data.boundsDirty = true;
+            }
+            account(data, true);
+            break;
+        }
+    }
+    evict();
+}
+
+RenderData& Scene::objectOf(const SceneCommand& command) {
+    auto* data = objects_.Get(Find(command.id));
+    if (!data) {
+        auto& group = groupOf(command.name);
+        RenderData created(Mesh::Create(command.mesh.type, {}), command.color, command.name);
+        created.id = command.id;
+        created.group = &group;
+        created.groupIndex = group.objects.size();
+        if (command.id >= byName_.size()) {
+            byName_.resize(command.id + 1);
+        }
+        byName_[command.id] = objects_.Insert(std::move(created));
+        group.objects.push_back(byName_[command.id]);
+        data = objects_.Get(byName_[command.id]);
+    }
+    // every command changes what's in the box, and ends a `Restore` pin
+    boundsChanged(data->group);
+    data->published.reset();
+    data->pinned = false;
+    return *data;
+}
+
+Mesh& Scene::editMesh(RenderData& data, const SceneCommand& command) {
+    if (unshared(data.mesh)) {
+        return *data.mesh;
+    }
+
+    // snapshots show at most the vertices there are now, writing past them without a reallocation leaves them be
+    auto& mesh = *data.mesh;
+    size_t vertices = command.mesh.vertices.size();
+    size_t indices = command.mesh.indices ? command.mesh.indices->size() : 0;
+    bool past = command.kind == SceneCommand::Kind::Append || command.offset >= mesh.vertices.size();
+    if (!past || mesh.vertices.size() + vertices > mesh.vertices.capacity() ||
+        !fits(mesh.colors, vertices) || !fits(mesh.normals, vertices) || !fits(mesh.indices, indices)) {
+        data.mesh = std::make_shared<Mesh>(copyWithRoom(mesh, vertices, indices));
+    }
+    return *data.mesh;
+}
+
+SceneGroup& Scene::groupOf(std::string_view name) {
+    SceneGroup* group = &root_;
+    // the last segment is the object's own
+    for (size_t pos = name.find('/'); pos != std::string_view::npos; pos = name.find('/')) {
+        auto segment = name.substr(0, pos);
+        name.remove_prefix(pos + 1);
+        if (segment.empty()) {
+            continue;
+        }
+        auto it = group->children.find(segment);
+        if (it == group->children.end()) {
+            auto child = std::make_unique<SceneGroup>();
+            child->name = segment;
+            // interned, the snapshots keep pointing at it after the group is gone
+            auto& table = NameTable::Instance();
+            child->path = table.Name(table.Intern(group->path.empty() ? child->name
+                                                                     : std::string(group->path) + "/" + child->name));
+            child->parent = group;
+            it = group->children.emplace(child->name, std::move(child)).first;
+        }
+        group = it->second.get();
+    }
+    return *group;
+}
+
+SceneGroup* Scene::FindGroup(std::string_view path) {
+    SceneGroup* group = &root_;
+    while (group && !path.empty()) {
+        size_t pos = std::min(path.find('/'), path.size());
+        auto segment = path.substr(0, pos);
+        path.remove_prefix(std::min(pos + 1, path.size()));
+        if (!segment.empty()) {
+            auto it = group->children.find(segment);
+            group = it == group->children.end() ? nullptr : it->second.get();
+        }
+    }
+    return group;
+}
+
+void Scene::RemoveGroup(SceneGroup& group) {
+    // the groups go as a whole, their objects don't leave them one by one
+    std::vector<SceneGroup*> stack{&group};
+    while (!stack.empty()) {
+        auto* below = stack.back();
+        stack.pop_back();
+        for (auto handle : below->objects) {
+            release(*objects_.Get(handle));
+            objects_.Remove(handle);
+        }
+        for (auto& [name, child] : below->children) {
+            stack.push_back(child.get());
+        }
+    }
+
+    if (&group == &root_) {
+        root_.children.clear();
+        root_.objects.clear();
+        root_.bounds = AABB{};
+        root_.boundsDirty = false;
+        return;
+    }
+    auto* parent = group.parent;
+    parent->children.erase(parent->children.find(group.name));
+    boundsChanged(parent);
+    prune(parent);
+}
+
+void Scene::RecolorGroup(SceneGroup& group, const glm::vec3& color) {
+    std::vector<SceneGroup*> stack{&group};
+    while (!stack.empty()) {
+        auto* below = stack.back();
+        stack.pop_back();
+        below->color = color;
+        for (auto handle : below->objects) {
+            auto& data = *objects_.Get(handle);
+            data.color = color;
+            data.published.reset();
+        }
+        for (auto& [name, child] : below->children) {
+            stack.push_back(child.get());
+        }
+    }
+}
+
+const AABB& Scene::BoundsOf(SceneGroup& group) {
+    if (group.boundsDirty) {
+        // only dirty groups below are walked into, the rest answer from their cache
+        group.bounds = AABB{};
+        for (auto handle : group.objects) {
+            group.bounds.Add(BoundsOf(*objects_.Get(handle)));
+        }
+        for (auto& [name, child] : group.children) {
+            group.bounds.Add(BoundsOf(*child));
+        }
+        group.boundsDirty = false;
+    }
+    return group.bounds;
+}
+
+const AABB& Scene::BoundsOf(RenderData& data) {
+    if (data.boundsDirty) {
+        AABB local;
+        for (const auto& vertex : data.mesh->vertices) {
+            local.Add(vertex.position);
+        }
+        data.bounds = local.Transformed(data.transform);
+        data.boundsDirty = false;
+    }
+    return data.bounds;
+}
+
+void Scene::release(RenderData& data) {
+    drop(data);
+    unlist(data);
+    cpuBytes_ -= data.cpuBytes;
+    gpuBytes_ -= data.gpuBytes;
+    byName_[data.id] = Handle{};
+}
+
+void Scene::prune(SceneGroup* group) {
+    while (group != &root_ && group->objects.empty() && group->children.empty()) {
+        auto* parent = group->parent;
+        parent->children.erase(parent->children.find(group->name));
+        group = parent;
+    }
+}
+
+void Scene::boundsChanged(SceneGroup* group) {
+    // stops at the first dirty one, its parents are dirty already
+    for (; group && !group->boundsDirty; group = group->parent) {
+        group->boundsDirty = true;
+    }
+}
+
+void Scene::SetMemoryBudget(size_t bytes, const std::string& cacheDirectory) {
+    budget_ = bytes;
+    if (budget_ > 0 && !cache_) {
+        cache_ = std::make_unique<SceneCache>(cacheDirectory, "vdbg-scene-");
+    }
+    evict();
+}
+
+bool Scene::Restore(RenderData& data) {
+    if (!data.spilled) {
+        return true;
+    }
+    bool ok = restore(data);
+    data.pinned = true;
+    account(data, true);
+    evict();
+    return ok;
+}
+
+SceneMemoryStats Scene::Memory() const {
+    SceneMemoryStats stats;
+    stats.cpuBytes = cpuBytes_;
+    stats.gpuBytes = gpuBytes_;
+    stats.budget = budget_;
+    stats.spilled = spilled_;
+    stats.cacheBytes = cache_ ? cache_->LiveBytes() : 0;
+    return stats;
+}
+
+bool Scene::restore(RenderData& data) {
+    if (!data.spilled) {
+        return true;
+    }
+    auto mesh = cache_->Restore(data.spilled.value());
+    data.spilled.reset();
+    spilled_ --;
+    compactCache();
+    if (!mesh) {
+        LOGE("[SCENE]: ", data.name, " can't be read back from the cache, it's left empty");
+        data.boundsDirty = true;
+        return false;
+    }
+    data.mesh = std::make_shared<Mesh>(std::move(mesh.value()));
+    data.published.reset();
+    return true;
+}
+
+void Scene::drop(RenderData& data) {
+    if (data.spilled) {
+        cache_->Drop(data.spilled.value());
+        data.spilled.reset();
+        spilled_ --;
+        compactCache();
+    }
+}
+
+void Scene::compactCache() {
+    if (!cache_->NeedsCompaction()) {
+        return;
+    }
+    // at least as many dead bytes as it moves, so it's amortized over the records that died
+    std::vector<SceneCache::Entry*> entries;
+    entries.reserve(spilled_);
+    for (auto& data : objects_.Values()) {
+        if (data.spilled) {
+            entries.push_back(&data.spilled.value());
+        }
+    }
+    cache_->Compact(entries);
+}
+
+void Scene::account(RenderData& data, bool touch) {
+    cpuBytes_ -= data.cpuBytes;
+    gpuBytes_ -= data.gpuBytes;
+    data.cpuBytes = sizeof(RenderData) + data.mesh->HeapBytes();
+    data.gpuBytes = data.spilled ? 0 : data.mesh->UploadBytes();
+    cpuBytes_ += data.cpuBytes;
+    gpuBytes_ += data.gpuBytes;
+    if (!touch) {
+        return;
+    }
+    data.updated = ++tick_;
+    // the newest go last, pinned and spilled ones aren't evicted
+    if (data.pinned || data.spilled) {
+        unlist(data);
+    } else if (data.lru) {
+        lru_.splice(lru_.end(), lru_, data.lru.value());
+    } else {
+        data.lru = lru_.insert(lru_.end(), data.id);
+    }
+}
+
+void Scene::unlist(RenderData& data) {
+    if (data.lru) {
+        lru_.erase(data.lru.value());
+        data.lru.reset();
+    }
+}
+
+void Scene::evict() {
+    if (budget_ == 0 || cpuBytes_ <= budget_) {
+        return;
+    }
+
+    // oldest first, each only looked at once. The object updated last stays, whatever it takes
+    const size_t target = budget_ / 4 * 3;
+    while (!lru_.empty() && cpuBytes_ > target) {
+        auto& data = *objects_.Get(Find(lru_.front()));
+        if (data.updated == tick_) {
+            return;
+        }
+        unlist(data);
+        if (data.mesh->HeapBytes() == 0) {
+            continue;
+        }
+        // a spilled object still has its place on screen
+        BoundsOf(data);
+        auto entry = cache_->Spill(*data.mesh);
+        if (!entry) {
+            LOGE("[SCENE]: can't spill to ", cache_->Path(), ", memory budget disabled");
+            budget_ = 0;
+            return;
+        }
+        data.spilled = entry;
+        spilled_ ++;
+        // a new mesh rather than `clear()`, snapshots may still draw the old one
+        data.mesh = std::make_shared<Mesh>(Mesh::Create(data.mesh->type, {}));
+        data.published.reset();
+        account(data, false);
+    }
+}
+
+void Scene::Publish() {
+    // recomputes the dirty bounds, the snapshot only reads them
+    BoundsOf(root_);
+    auto snapshot = std::make_shared<SceneSnapshot>();
+    snapshot->objects.reserve(objects_.Values().size());
+    snapshot->memory = Memory();
+    publish(root_, *snapshot);
+    std::atomic_store(&latest_, std::shared_ptr<const SceneSnapshot>(std::move(snapshot)));
+    taken_.store(false, std::memory_order_relaxed);
+}
+
+void Scene::publish(SceneGroup& group, SceneSnapshot& snapshot) {
+    uint32_t index = snapshot.groups.size();
+    auto& published = snapshot.groups.emplace_back();
+    published.path = group.path;
+    published.name = group.path.substr(std::min(group.path.size(), group.path.rfind('/') + 1));
+    published.color = group.color;
+    published.bounds = group.bounds;
+    published.hidden = group.hidden;
+    published.objectBegin = snapshot.objects.size();
+    for (auto handle : group.objects) {
+        auto& data = *objects_.Get(handle);
+        // unchanged objects are shared with the previous snapshot
+        if (!data.published) {
+            auto object = std::make_shared<SceneSnapshot::Object>();
+            object->storage = data.mesh;
+            object->mesh = *data.mesh;
+            object->name = data.name;
+            object->id = data.id;
+            object->color = data.color;
+            object->transform = data.transform;
+            object->bounds = data.bounds;
+            object->selected = data.selected;
+            object->spilled = data.spilled.has_value();
+            data.published = std::move(object);
+        }
+        snapshot.objects.push_back(data.published);
+    }
+    snapshot.groups[index].objectEnd = snapshot.objects.size();
+    for (auto& [name, child] : group.children) {
+        publish(*child, snapshot);
+    }
+    snapshot.groups[index].end = snapshot.groups.size();
+}
+
+std::shared_ptr<const SceneSnapshot> Scene::Latest() const {
+    taken_.store(true, std::memory_order_relaxed);
+    return std::atomic_load(&latest_);
+}
+
+SceneQueue::SceneQueue(size_t capacity): queue_(capacity) {}
+
+SceneQueue::~SceneQueue() {
+    Stop();
+}
+
+bool SceneQueue::Push(SceneCommand command) {
+    command.queued = SceneCommand::Clock::now();
+    while (!closed_.load(std::memory_order_acquire)) {
+        if (queue_.TryPush(command)) {
+            filled_.Notify();
+            return true;
+        }
+        // the timeout only covers a drain between our check and its notify
+        drained_.Wait([this]() { return queue_.Size() < queue_.Capacity() || closed_.load(std::memory_order_acquire); },
+                      std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+bool SceneQueue::Post(SceneCommand command) {
+    if (closed_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    command.queued = SceneCommand::Clock::now();
+    {
+        std::lock_guard guard(postMutex_);
+        posted_.push_back(std::move(command));
+        postedCount_.store(posted_.size(), std::memory_order_release);
+    }
+    filled_.Notify();
+    return true;
+}
+
+void SceneQueue::Close() {
+    closed_.store(true, std::memory_order_release);
+    filled_.Notify();
+    drained_.Notify();
+}
+
+void SceneQueue::Start(Scene& scene, SceneCommand::Clock::duration budget) {
+    thread_ = std::thread([this, &scene, budget]() {
+        bool changed = false;
+        auto pending = [this]() {
+            return queue_.Size() > 0 || postedCount_.load(std::memory_order_acquire) > 0 ||
+                   closed_.load(std::memory_order_acquire);
+        };
+        while (!closed_.load(std::memory_order_acquire)) {
+            size_t applied = Drain(scene, budget);
+            changed |= applied > 0;
+            // the render thread draws one snapshot a frame, publishing faster only costs copies.
+            // Out of work, the last changes are published before sleeping, nothing else would
+            if (changed && (scene.LatestTaken() || !pending())) {
+                scene.Publish();
+                changed = false;
+            }
+            if (applied == 0) {
+                filled_.Wait(pending, std::chrono::milliseconds(100));
+            }
+        }
+    });
+}
+
+void SceneQueue::Stop() {
+    Close();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+size_t SceneQueue::Drain(Scene& scene, SceneCommand::Clock::duration budget) {
+    auto deadline = SceneCommand::Clock::now() + budget;
+    size_t applied = 0;
+    std::vector<SceneCommand> posted;
+    if (postedCount_.load(std::memory_order_acquire) > 0) {
+        std::lock_guard guard(postMutex_);
+        posted.swap(posted_);
+        postedCount_.store(0, std::memory_order_release);
+    }
+    for (auto& command : posted) {
+        apply(scene, command);
+        applied ++;
+    }
+
+    SceneCommand command;
+    while ((applied == 0 || SceneCommand::Clock::now() < deadline) && queue_.TryPop(command)) {
+        drained_.Notify();
+        apply(scene, command);
+        applied ++;
+    }
+    return applied;
+}
+
+void SceneQueue::apply(Scene& scene, SceneCommand& command) {
+    scene.Apply(command);
+
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(SceneCommand::Clock::now() - command.queued).count();
+    // only the draining thread writes these
+    applied_.fetch_add(1, std::memory_order_relaxed);
+    latencySumUs_.fetch_add(us, std::memory_order_relaxed);
+    if (us > latencyMaxUs_.load(std::memory_order_relaxed)) {
+        latencyMaxUs_.store(us, std::memory_order_relaxed);
+    }
+}
+
+SceneQueueStats SceneQueue::Stats() const {
+    SceneQueueStats stats;
+    stats.depth = queue_.Size() + postedCount_.load(std::memory_order_relaxed);
+    stats.applied = applied_;
+    stats.avgLatencyMs = stats.applied > 0 ? latencySumUs_ / double(stats.applied) / 1000.0 : 0;
+    stats.maxLatencyMs = latencyMaxUs_ / 1000.0;
+    return stats;
+}
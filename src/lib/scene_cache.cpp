@@ -0,0 +1,231 @@
+#include "scene_cache.hpp"
+#include "compress.hpp"
+#include "netdata.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct SpillHead final {
+    uint8_t type = 0;
+    uint8_t attributes = 0;
+    uint32_t count = 0;
+    uint32_t indexCount = 0;
+};
+
+enum SpillAttribute: uint8_t {
+    Colors = 1,
+    Normals = 2,
+    Indices = 4,
+};
+
+using SpillHeadSchema = wire::Schema<SpillHead,
+                                     wire::Field<&SpillHead::type>,
+                                     wire::Field<&SpillHead::attributes>,
+                                     wire::Field<&SpillHead::count>,
+                                     wire::Field<&SpillHead::indexCount>>;
+
+template <typename T>
+void appendArray(std::vector<uint8_t>& buf, const std::vector<T>& values) {
+    size_t oldSize = buf.size();
+    buf.resize(oldSize + values.size() * sizeof(T));
+    if (!values.empty()) {
+        memcpy(buf.data() + oldSize, values.data(), values.size() * sizeof(T));
+    }
+}
+
+template <typename T>
+bool readArray(wire::Reader& reader, uint32_t count, std::vector<T>& values) {
+    const uint8_t* ptr = reader.TakeArray(count, sizeof(T));
+    if (!ptr) {
+        return false;
+    }
+    values.resize(count);
+    if (count > 0) {
+        memcpy(values.data(), ptr, static_cast<size_t>(count) * sizeof(T));
+    }
+    return true;
+}
+
+}
+
+SceneCache::SceneCache(const std::string& directory, const std::string& prefix) {
+    std::string name = (std::filesystem::path(directory) / (prefix + "XXXXXX")).string();
+    // created exclusively under a name nobody could guess, only this user can open it
+#ifdef _WIN32
+    bool created = _mktemp_s(name.data(), name.size() + 1) == 0 &&
+                   std::ofstream(name, std::ios::binary).is_open();
+#else
+    int fd = mkstemp(name.data());
+    bool created = fd >= 0;
+    if (created) {
+        close(fd);
+    }
+#endif
+    if (!created) {
+        LOGE("[SCENE]: can't create a cache file in ", directory);
+        return;
+    }
+    path_ = name;
+    file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_) {
+        LOGE("[SCENE]: can't open cache file ", path_);
+    }
+}
+
+SceneCache::~SceneCache() {
+    file_.close();
+    if (!path_.empty()) {
+        std::remove(path_.c_str());
+    }
+}
+
+void SceneCache::truncate() {
+    file_.flush();
+    std::error_code err;
+    std::filesystem::resize_file(path_, end_, err);
+    if (err) {
+        LOGW("[SCENE]: can't truncate cache file ", path_, ": ", err.message());
+    }
+}
+
+std::optional<SceneCache::Entry> SceneCache::Spill(const Mesh& mesh) {
+    SpillHead head;
+    head.type = mesh.type;
+    head.count = mesh.vertices.size();
+    // attributes that don't match the vertices aren't drawn, they aren't kept either
+    if (mesh.colors && mesh.colors->size() == mesh.vertices.size()) {
+        head.attributes |= SpillAttribute::Colors;
+    }
+    if (mesh.normals && mesh.normals->size() == mesh.vertices.size()) {
+        head.attributes |= SpillAttribute::Normals;
+    }
+    if (mesh.indices) {
+        head.attributes |= SpillAttribute::Indices;
+        head.indexCount = mesh.indices->size();
+    }
+
+    // the leading byte says whether the rest is compressed
+    std::vector<uint8_t> record(1, 0);
+    SpillHeadSchema::Append(head, record);
+    appendArray(record, mesh.vertices);
+    if (head.attributes & SpillAttribute::Colors) {
+        appendArray(record, mesh.colors.value());
+    }
+    if (head.attributes & SpillAttribute::Normals) {
+        appendArray(record, mesh.normals.value());
+    }
+    if (head.attributes & SpillAttribute::Indices) {
+        appendArray(record, mesh.indices.value());
+    }
+    std::vector<uint8_t> packed(1, 1);
+    size_t rawSize = record.size() - 1;
+    if (rawSize >= BlockCodec::DefaultThreshold && rawSize <= FrameHeader::MaxLength &&
+        BlockCodec::Compress(record.data() + 1, rawSize, packed)) {
+        record.swap(packed);
+    }
+
+    if (!file_.is_open()) {
+        return std::nullopt;
+    }
+    file_.seekp(end_);
+    file_.write(reinterpret_cast<const char*>(record.data()), record.size());
+    if (!file_) {
+        LOGE("[SCENE]: writing cache file ", path_, " failed");
+        file_.clear();
+        return std::nullopt;
+    }
+    Entry entry{end_, record.size()};
+    end_ += record.size();
+    live_ += record.size();
+    return entry;
+}
+
+std::optional<Mesh> SceneCache::Restore(Entry entry) {
+    std::vector<uint8_t> record(entry.size);
+    file_.seekg(entry.offset);
+    file_.read(reinterpret_cast<char*>(record.data()), record.size());
+    bool ok = static_cast<bool>(file_);
+    file_.clear();
+    Drop(entry);
+    if (!ok || record.empty()) {
+        LOGE("[SCENE]: reading cache file ", path_, " failed");
+        return std::nullopt;
+    }
+
+    const uint8_t* beg = record.data() + 1;
+    const uint8_t* end = record.data() + record.size();
+    std::vector<uint8_t> raw;
+    if (record[0] == 1) {
+        if (!BlockCodec::Decompress(beg, end, raw)) {
+            LOGE("[SCENE]: a record of cache file ", path_, " is corrupted");
+            return std::nullopt;
+        }
+        beg = raw.data();
+        end = raw.data() + raw.size();
+    }
+
+    wire::Reader reader(beg, end);
+    SpillHead head;
+    Mesh mesh;
+    if (reader.ReadRecord<SpillHeadSchema>(head) && readArray(reader, head.count, mesh.vertices)) {
+        mesh.type = static_cast<Mesh::Type>(head.type);
+        if (head.attributes & SpillAttribute::Colors) {
+            readArray(reader, head.count, mesh.colors.emplace());
+        }
+        if (head.attributes & SpillAttribute::Normals) {
+            readArray(reader, head.count, mesh.normals.emplace());
+        }
+        if (head.attributes & SpillAttribute::Indices) {
+            readArray(reader, head.indexCount, mesh.indices.emplace());
+        }
+    }
+    if (!reader.Ok()) {
+        LOGE("[SCENE]: a record of cache file ", path_, " is corrupted");
+        return std::nullopt;
+    }
+    return mesh;
+}
+
+void SceneCache::Drop(Entry entry) {
+    live_ -= std::min(live_, entry.size);
+    if (live_ == 0 && end_ > 0) {
+        end_ = 0;
+        truncate();
+    }
+}
+
+bool SceneCache::Compact(const std::vector<Entry*>& entries) {
+    auto sorted = entries;
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->offset < b->offset; });
+    // front to back, a record only ever moves down over dead space or its own old bytes
+    uint64_t end = 0;
+    std::vector<uint8_t> record;
+    for (auto* entry : sorted) {
+        if (entry->offset != end) {
+            record.resize(entry->size);
+            file_.seekg(entry->offset);
+            file_.read(reinterpret_cast<char*>(record.data()), record.size());
+            file_.seekp(end);
+            file_.write(reinterpret_cast<const char*>(record.data()), record.size());
+            if (!file_) {
+                LOGE("[SCENE]: compacting cache file ", path_, " failed");
+                file_.clear();
+                return false;
+            }
+            entry->offset = end;
+        }
+        end += entry->size;
+    }
+    end_ = end;
+    live_ = end;
+    truncate();
+    return true;
+}
@@ -0,0 +1,374 @@
+#include "shm.hpp"
+#include "netdata.hpp"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr uint32_t ShmMagic = 0x4d485356;   // "VSHM"
+constexpr uint32_t ShmVersion = 3;
+
+void futexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs) {
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    // not FUTEX_PRIVATE: the word lives in memory shared between processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    if (word->load() == expected) {
+        poll(nullptr, 0, std::min(timeoutMs, 1));
+    }
+#endif
+}
+
+void futexWake(std::atomic<uint32_t>* word) {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+std::string segmentName(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+}
+
+struct ShmRing::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint32_t> readerPid;        // the consumer that created the ring, 0 once it closed
+    std::atomic<uint32_t> writerPid;        // the producer that opened the ring, 0 if none
+    std::atomic<uint32_t> writerEpoch;      // bumped by each producer that opens the ring
+    std::atomic<uint64_t> writerStart;      // `head` when the current producer opened it
+
+    // written by the producer
+    alignas(64) std::atomic<uint64_t> head;
+    std::atomic<uint32_t> dataSeq;          // futex word the consumer sleeps on
+    std::atomic<uint32_t> writerWaiting;
+
+    // written by the consumer
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> spaceSeq;         // futex word the producer sleeps on
+    std::atomic<uint32_t> readerWaiting;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared memory ring needs address free atomics");
+
+std::unique_ptr<ShmRing> ShmRing::Create(const std::string& name, size_t capacity) {
+    size_t size = 4096;
+    while (size < capacity) {
+        size *= 2;
+    }
+    return mapSegment(name, true, size);
+}
+
+std::unique_ptr<ShmRing> ShmRing::Open(const std::string& name) {
+    return mapSegment(name, false, 0);
+}
+
+std::unique_ptr<ShmRing> ShmRing::mapSegment(const std::string& name, bool create, size_t capacity) {
+    std::string shmName = segmentName(name);
+    size_t headerSize = (sizeof(Header) + 63) / 64 * 64;
+
+    int fd;
+    if (create) {
+        shm_unlink(shmName.c_str());
+        fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd >= 0 && ftruncate(fd, headerSize + capacity) != 0) {
+            LOGE("[SHM]: resize ", shmName, " failed: ", net::GetLastError());
+            close(fd);
+            shm_unlink(shmName.c_str());
+            return nullptr;
+        }
+    } else {
+        fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        LOGE("[SHM]: open ", shmName, " failed: ", net::GetLastError());
+        return nullptr;
+    }
+
+    size_t mappedSize = headerSize + capacity;
+    if (!create) {
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) <= headerSize) {
+            LOGE("[SHM]: ", shmName, " is not a ring");
+            close(fd);
+            return nullptr;
+        }
+        mappedSize = st.st_size;
+    }
+
+    void* addr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        LOGE("[SHM]: map ", shmName, " failed: ", net::GetLastError());
+        return nullptr;
+    }
+
+    std::unique_ptr<ShmRing> ring(new ShmRing());
+    ring->name_ = shmName;
+    ring->header_ = static_cast<Header*>(addr);
+    ring->data_ = static_cast<uint8_t*>(addr) + headerSize;
+    ring->mappedSize_ = mappedSize;
+    ring->owner_ = create;
+
+    Header* header = ring->header_;
+    if (create) {
+        new (header) Header();
+        header->magic = ShmMagic;
+        header->version = ShmVersion;
+        header->capacity = capacity;
+        header->readerPid = static_cast<uint32_t>(getpid());
+    } else if (header->magic != ShmMagic || header->version != ShmVersion ||
+               header->capacity + headerSize > mappedSize) {
+        LOGE("[SHM]: ", shmName, " has an unknown layout");
+        return nullptr;
+    } else if (!ring->claimWriter()) {
+        LOGE("[SHM]: ", shmName, " already has a producer(pid ", header->writerPid.load(), ")");
+        return nullptr;
+    }
+    return ring;
+}
+
+bool ShmRing::claimWriter() {
+    // single producer: concurrent writers would corrupt `head`
+    uint32_t self = static_cast<uint32_t>(getpid());
+    uint32_t holder = 0;
+    while (!header_->writerPid.compare_exchange_strong(holder, self)) {
+        // a producer that died without closing leaves its claim behind
+        if (kill(static_cast<pid_t>(holder), 0) == 0 || errno != ESRCH) {
+            return false;
+        }
+    }
+    writer_ = true;
+    // the consumer reads what earlier producers left before ours, then starts over
+    header_->writerStart.store(header_->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    header_->writerEpoch.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+bool ShmRing::readerAlive() const {
+    uint32_t pid = header_->readerPid.load();
+    // a consumer that crashed never closed the ring
+    return pid != 0 && (kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH);
+}
+
+ShmRing::~ShmRing() {
+    if (!header_) {
+        return;
+    }
+    if (writer_) {
+        header_->writerPid = 0;
+    }
+    if (owner_) {
+        header_->readerPid = 0;
+        futexWake(&header_->spaceSeq);
+        shm_unlink(name_.c_str());
+    }
+    munmap(header_, mappedSize_);
+}
+
+size_t ShmRing::Capacity() const {
+    return header_->capacity;
+}
+
+void ShmRing::writeBytes(const uint8_t* src, size_t size) {
+    uint64_t head = header_->head.load(std::memory_order_relaxed);
+    size_t mask = header_->capacity - 1;
+    size_t offset = head & mask;
+    size_t first = std::min(size, static_cast<size_t>(header_->capacity - offset));
+    memcpy(data_ + offset, src, first);
+    memcpy(data_, src + first, size - first);
+    header_->head.store(head + size, std::memory_order_release);
+}
+
+bool ShmRing::Write(const net::IoSlice* slices, size_t count) {
+    Header* header = header_;
+    uint64_t capacity = header->capacity;
+    if (header->readerPid.load() == 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* src = static_cast<const uint8_t*>(slices[i].data);
+        size_t remain = slices[i].size;
+
+        while (remain > 0) {
+            uint64_t used = header->head.load(std::memory_order_relaxed) - header->tail.load(std::memory_order_acquire);
+            size_t space = capacity - used;
+            if (space == 0) {
+                uint32_t seq = header->spaceSeq.load();
+                header->writerWaiting = 1;
+                if (header->head.load(std::memory_order_relaxed) - header->tail.load() == capacity) {
+                    // a closing consumer wakes us, a crashed one is noticed by the timeout
+                    futexWait(&header->spaceSeq, seq, 100);
+                    if (header->head.load(std::memory_order_relaxed) - header->tail.load() == capacity &&
+                        !readerAlive()) {
+                        header->writerWaiting = 0;
+                        return false;
+                    }
+                }
+                header->writerWaiting = 0;
+                continue;
+            }
+
+            size_t size = std::min(space, remain);
+            writeBytes(src, size);
+            src += size;
+            remain -= size;
+
+            header->dataSeq.fetch_add(1);
+            if (header->readerWaiting) {
+                futexWake(&header->dataSeq);
+            }
+        }
+    }
+    return true;
+}
+
+size_t ShmRing::Read(uint8_t* buf, size_t size, int timeoutMs) {
+    Header* header = header_;
+
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    uint64_t head = header->head.load(std::memory_order_acquire);
+    if (head == tail && header->writerEpoch.load() == epoch_) {
+        uint32_t seq = header->dataSeq.load();
+        header->readerWaiting = 1;
+        if (header->head.load() == tail) {
+            futexWait(&header->dataSeq, seq, timeoutMs);
+        }
+        header->readerWaiting = 0;
+        head = header->head.load(std::memory_order_acquire);
+    }
+
+    // loaded after `head`: bytes of a new producer show its epoch as well
+    uint32_t epoch = header->writerEpoch.load(std::memory_order_acquire);
+    if (epoch != epoch_) {
+        uint64_t start = header->writerStart.load(std::memory_order_relaxed);
+        if (epoch - epoch_ > 1 && tail != start) {
+            // producers came and went in between, drop their leftovers rather than guess where they end
+            tail = start;
+            header->tail.store(tail, std::memory_order_release);
+            header->spaceSeq.fetch_add(1);
+            if (header->writerWaiting) {
+                futexWake(&header->spaceSeq);
+            }
+        }
+        if (tail == start) {
+            // nothing to drop before the first producer
+            bool first = epoch_ == 0 && tail == 0;
+            epoch_ = epoch;
+            if (!first) {
+                producerChanged_ = true;
+                return 0;
+            }
+        } else {
+            head = start;
+        }
+    }
+    if (head == tail) {
+        return 0;
+    }
+
+    size_t mask = header->capacity - 1;
+    size_t len = std::min(size, static_cast<size_t>(head - tail));
+    size_t offset = tail & mask;
+    size_t first = std::min(len, static_cast<size_t>(header->capacity - offset));
+    memcpy(buf, data_ + offset, first);
+    memcpy(buf + first, data_, len - first);
+    header->tail.store(tail + len, std::memory_order_release);
+
+    header->spaceSeq.fetch_add(1);
+    if (header->writerWaiting) {
+        futexWake(&header->spaceSeq);
+    }
+    return len;
+}
+
+#else
+
+struct ShmRing::Header {};
+
+std::unique_ptr<ShmRing> ShmRing::Create(const std::string& name, size_t) {
+    LOGE("[SHM]: shared memory transport is not supported on this platform");
+    return nullptr;
+}
+
+std::unique_ptr<ShmRing> ShmRing::Open(const std::string& name) {
+    return Create(name, 0);
+}
+
+std::unique_ptr<ShmRing> ShmRing::mapSegment(const std::string&, bool, size_t) {
+    return nullptr;
+}
+
+ShmRing::~ShmRing() {}
+
+bool ShmRing::Write(const net::IoSlice*, size_t) {
+    return false;
+}
+
+size_t ShmRing::Read(uint8_t*, size_t, int) {
+    return 0;
+}
+
+size_t ShmRing::Capacity() const {
+    return 0;
+}
+
+void ShmRing::writeBytes(const uint8_t*, size_t) {}
+
+#endif
+
+ShmReceiver::ShmReceiver(std::unique_ptr<ShmRing>&& ring, PacketHandler handler)
+    : ring_(std::move(ring)), handler_(std::move(handler)) {}
+
+ShmReceiver::~ShmReceiver() {
+    Stop();
+}
+
+void ShmReceiver::Start() {
+    if (running_ || !ring_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&ShmReceiver::run, this);
+}
+
+void ShmReceiver::Stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ShmReceiver::run() {
+    NetRecv recv(nullptr);
+
+    while (running_) {
+        recv.RecvWith([this](uint8_t* buf, size_t size) {
+            // wake up now and then to notice `Stop()`
+            return ring_->Read(buf, size, 100);
+        }, handler_);
+        if (ring_->ProducerChanged()) {
+            recv.Reset();
+        }
+        bytes_ = recv.BytesReceived();
+    }
+}
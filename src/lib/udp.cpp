@@ -0,0 +1,152 @@
+#include "udp.hpp"
+
+UdpReceiver::UdpReceiver(net::Socket* socket, PacketHandler handler)
+    : socket_(socket), handler_(std::move(handler)) {
+    socket_->SetNonblock(true);
+    // a burst of datagrams waits in the kernel while the handler runs
+    socket_->SetRecvBufferSize(4 * 1024 * 1024);
+    if (!poller_.Valid() || !poller_.Add(socket_->Handle(), nullptr)) {
+        LOGE("[NET]: watch udp socket failed: ", net::GetLastError());
+    }
+}
+
+UdpReceiver::~UdpReceiver() {
+    Stop();
+}
+
+void UdpReceiver::Start() {
+    if (running_) {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&UdpReceiver::run, this);
+}
+
+void UdpReceiver::Stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+UdpStats UdpReceiver::Stats() const {
+    UdpStats stats;
+    stats.datagrams = datagrams_;
+    stats.packets = packets_;
+    stats.stale = stale_;
+    stats.malformed = malformed_;
+    return stats;
+}
+
+void UdpReceiver::run() {
+    std::vector<uint8_t> buf(BurstBytes);
+    std::vector<PacketView> packets;
+    std::vector<net::Poller::Event> events;
+
+    while (running_) {
+        // wake up now and then to notice `Stop()`
+        if (poller_.Wait(events, 100) <= 0) {
+            continue;
+        }
+
+        // drain everything queued, one handler call per burst. Every datagram
+        // gets its own piece of `buf`, the views stay valid until the handler is done
+        bool drained = false;
+        while (!drained) {
+            size_t used = 0;
+            BlockCodec::TrimPool(inflated_);
+            inflatedUsed_ = 0;
+            while (buf.size() - used >= NetSender::MaxDatagram) {
+                auto result = socket_->Recv((char*)buf.data() + used, buf.size() - used);
+                if (result.value <= 0) {
+                    drained = true;
+                    break;
+                }
+                datagrams_ ++;
+                decode(buf.data() + used, buf.data() + used + result.value, packets);
+                used += result.value;
+            }
+
+            if (!packets.empty()) {
+                packets_ += packets.size();
+                handler_(packets);
+                packets.clear();
+            }
+        }
+    }
+}
+
+void UdpReceiver::decode(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& packets) {
+    // range updates are never sent as datagrams, see `NetSender`, nor inside a batch below
+    auto header = FrameHeader::Read(beg, end);
+    if (!header ||
+        (header->opcode != Opcode::Mesh && header->opcode != Opcode::Transform && header->opcode != Opcode::Batch) ||
+        header->length != static_cast<size_t>(end - beg) - FrameHeader::Size) {
+        malformed_ ++;
+        return;
+    }
+
+    const uint8_t* payload = beg + FrameHeader::Size;
+    std::optional<SequenceTag> tag;
+    if (header->flags & FrameHeader::FlagSequenced) {
+        tag = SequenceTag::Read(payload, end);
+        if (!tag) {
+            malformed_ ++;
+            return;
+        }
+        payload += SequenceTag::Size;
+    }
+    if (header->flags & FrameHeader::FlagCompressed) {
+        if (inflatedUsed_ == inflated_.size()) {
+            inflated_.emplace_back();
+        }
+        auto& raw = inflated_[inflatedUsed_++];
+        if (!BlockCodec::Decompress(payload, end, raw)) {
+            malformed_ ++;
+            return;
+        }
+        payload = raw.data();
+        end = raw.data() + raw.size();
+    }
+
+    size_t first = packets.size();
+    if (header->opcode == Opcode::Batch) {
+        if (!Batch::Parse(payload, end, packets)) {
+            malformed_ ++;
+        }
+    } else if (auto packet = PacketView::Parse(payload, end, header->opcode); packet) {
+        packets.push_back(packet.value());
+    } else {
+        malformed_ ++;
+    }
+
+    // senders don't intern names over UDP, a declaration could get lost, and
+    // a range update applied to whichever version of the mesh arrived last
+    // would be garbage. Every record of a batch shares the datagram's tag
+    auto& table = NameTable::Instance();
+    size_t kept = first;
+    for (size_t i = first; i < packets.size(); i++) {
+        auto& packet = packets[i];
+        if (packet.opcode == Opcode::Declare || packet.opcode == Opcode::Append || packet.opcode == Opcode::Replace ||
+            packet.nameId != Packet::NoNameId) {
+            malformed_ ++;
+            continue;
+        }
+        packet.id = table.Intern(packet.name);
+        if (tag) {
+            if (packet.id >= latest_.size()) {
+                latest_.resize(packet.id + 1);
+            }
+            auto& latest = packet.opcode == Opcode::Transform ? latest_[packet.id].transform : latest_[packet.id].mesh;
+            if (latest && !(latest->session == tag->session && latest->sequence == tag->sequence)) {
+                if (!tag->NewerThan(latest.value())) {
+                    stale_ ++;
+                    continue;
+                }
+            }
+            latest = tag;
+        }
+        packets[kept++] = packet;
+    }
+    packets.erase(packets.begin() + kept, packets.end());
+}
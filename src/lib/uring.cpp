@@ -0,0 +1,397 @@
+#include "uring.hpp"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+
+// multishot recv and buffer rings arrived together with these
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_FEAT_EXT_ARG)
+#define VDBG_HAS_IO_URING
+#endif
+
+#ifdef VDBG_HAS_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <climits>
+
+namespace {
+
+// completions of our own cancel/provide requests, nobody waits for them
+constexpr uint64_t InternalUserData = ~0ull;
+constexpr uint16_t BufferGroup = 0;
+
+int uringSetup(uint32_t entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags, const void* arg, size_t argSize) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+int uringRegister(int fd, uint32_t opcode, const void* arg, uint32_t count) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+bool kernelAtLeast(int major, int minor) {
+    utsname name;
+    int curMajor = 0, curMinor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &curMajor, &curMinor) != 2) {
+        return false;
+    }
+    return curMajor > major || (curMajor == major && curMinor >= minor);
+}
+
+template <typename T>
+T loadAcquire(const T* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void storeRelease(T* ptr, T value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+}
+
+struct IoUring::Rings {
+    int fd = -1;
+
+    void* ringPtr = MAP_FAILED;
+    size_t ringSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    uint32_t* sqHead;
+    uint32_t* sqTail;
+    uint32_t sqMask;
+    uint32_t sqEntries;
+    uint32_t* sqArray;
+    uint32_t sqLocalTail = 0;
+    uint32_t toSubmit = 0;
+
+    uint32_t* cqHead;
+    uint32_t* cqTail;
+    uint32_t cqMask;
+    io_uring_cqe* cqes;
+
+    io_uring_buf_ring* bufRing = static_cast<io_uring_buf_ring*>(MAP_FAILED);
+    size_t bufRingSize = 0;
+    uint16_t bufMask = 0;
+    uint16_t bufTail = 0;
+    uint32_t bufferSize = 0;
+    std::unique_ptr<uint8_t[]> buffers;
+    bool legacyBuffers = false;     // IORING_OP_PROVIDE_BUFFERS instead of the ring
+
+    ~Rings() {
+        if (bufRing != MAP_FAILED) {
+            munmap(bufRing, bufRingSize);
+        }
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (ringPtr != MAP_FAILED) {
+            munmap(ringPtr, ringSize);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    io_uring_sqe* getSqe() {
+        if (sqLocalTail - loadAcquire(sqHead) >= sqEntries) {
+            // full, push what we have to the kernel first
+            submit();
+            if (sqLocalTail - loadAcquire(sqHead) >= sqEntries) {
+                return nullptr;
+            }
+        }
+        uint32_t index = sqLocalTail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        sqLocalTail ++;
+        storeRelease(sqTail, sqLocalTail);
+        toSubmit ++;
+        return sqe;
+    }
+
+    void submit() {
+        while (toSubmit > 0) {
+            int ret = uringEnter(fd, toSubmit, 0, 0, nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOGE("[NET]: io_uring submit failed: ", net::GetLastError());
+                return;
+            }
+            toSubmit -= std::min<uint32_t>(toSubmit, ret);
+            if (ret == 0) {
+                return;
+            }
+        }
+    }
+
+    void addBuffer(uint16_t id) {
+        // the entries start at the ring itself, its tail overlays the first one's reserved field.
+        // `bufs` is a flexible array member that C++ places after the header instead
+        io_uring_buf* buf = reinterpret_cast<io_uring_buf*>(bufRing) + (bufTail & bufMask);
+        buf->addr = reinterpret_cast<uint64_t>(buffers.get() + size_t(id) * bufferSize);
+        buf->len = bufferSize;
+        buf->bid = id;
+        bufTail ++;
+    }
+
+    //! @brief hand `count` buffers starting at `id` to the kernel the old way, one request each time
+    bool provideBuffers(uint16_t id, uint32_t count) {
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = count;
+        sqe->addr = reinterpret_cast<uint64_t>(buffers.get() + size_t(id) * bufferSize);
+        sqe->len = bufferSize;
+        sqe->off = id;
+        sqe->buf_group = BufferGroup;
+        sqe->user_data = InternalUserData;
+        return true;
+    }
+};
+
+std::unique_ptr<IoUring> IoUring::Create(uint32_t entries, uint32_t bufferCount, uint32_t bufferSize) {
+    if (!kernelAtLeast(6, 0)) {
+        LOGI("[NET]: kernel too old for multishot recv, io_uring disabled");
+        return nullptr;
+    }
+
+    auto rings = std::make_unique<Rings>();
+
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    rings->fd = uringSetup(entries, &params);
+    if (rings->fd < 0) {
+        LOGI("[NET]: io_uring_setup failed: ", net::GetLastError());
+        return nullptr;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        LOGI("[NET]: io_uring lacks required features");
+        return nullptr;
+    }
+
+    // submission and completion rings share one mapping
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    rings->ringSize = std::max(sqSize, cqSize);
+    rings->ringPtr = mmap(nullptr, rings->ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          rings->fd, IORING_OFF_SQ_RING);
+    rings->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    rings->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, rings->sqesSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, rings->fd, IORING_OFF_SQES));
+    if (rings->ringPtr == MAP_FAILED || rings->sqes == MAP_FAILED) {
+        LOGE("[NET]: map io_uring failed: ", net::GetLastError());
+        return nullptr;
+    }
+
+    auto base = static_cast<uint8_t*>(rings->ringPtr);
+    rings->sqHead = reinterpret_cast<uint32_t*>(base + params.sq_off.head);
+    rings->sqTail = reinterpret_cast<uint32_t*>(base + params.sq_off.tail);
+    rings->sqMask = *reinterpret_cast<uint32_t*>(base + params.sq_off.ring_mask);
+    rings->sqEntries = params.sq_entries;
+    rings->sqArray = reinterpret_cast<uint32_t*>(base + params.sq_off.array);
+    rings->sqLocalTail = *rings->sqTail;
+    rings->cqHead = reinterpret_cast<uint32_t*>(base + params.cq_off.head);
+    rings->cqTail = reinterpret_cast<uint32_t*>(base + params.cq_off.tail);
+    rings->cqMask = *reinterpret_cast<uint32_t*>(base + params.cq_off.ring_mask);
+    rings->cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // provided buffers: the kernel picks one per completion
+    uint32_t count = 1;
+    while (count < bufferCount) {
+        count *= 2;
+    }
+    count = std::min<uint32_t>(count, 1u << 15);
+    rings->bufRingSize = count * sizeof(io_uring_buf);
+    rings->bufRing = static_cast<io_uring_buf_ring*>(mmap(nullptr, rings->bufRingSize, PROT_READ | PROT_WRITE,
+                                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (rings->bufRing == MAP_FAILED) {
+        LOGE("[NET]: map io_uring buffer ring failed: ", net::GetLastError());
+        return nullptr;
+    }
+
+    rings->bufMask = count - 1;
+    rings->bufferSize = bufferSize;
+    rings->buffers.reset(new uint8_t[size_t(count) * bufferSize]);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(rings->bufRing);
+    reg.ring_entries = count;
+    reg.bgid = BufferGroup;
+    if (uringRegister(rings->fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            rings->addBuffer(i);
+        }
+        storeRelease(&rings->bufRing->tail, rings->bufTail);
+    } else {
+        LOGI("[NET]: io_uring buffer ring unsupported(", net::GetLastError(), "), providing buffers per request");
+        rings->legacyBuffers = true;
+        rings->provideBuffers(0, count);
+        rings->submit();
+    }
+
+    std::unique_ptr<IoUring> uring(new IoUring());
+    uring->rings_ = std::move(rings);
+    return uring;
+}
+
+bool IoUring::RingBuffers() const {
+    return !rings_->legacyBuffers;
+}
+
+IoUring::~IoUring() = default;
+
+bool IoUring::Recv(net::SocketHandle s, uint64_t userData) {
+    io_uring_sqe* sqe = rings_->getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BufferGroup;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::PollIn(net::SocketHandle s, uint64_t userData) {
+    io_uring_sqe* sqe = rings_->getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = s;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::Cancel(uint64_t userData) {
+    io_uring_sqe* sqe = rings_->getSqe();
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = InternalUserData;
+    return true;
+}
+
+void IoUring::Submit() {
+    rings_->submit();
+}
+
+int IoUring::Wait(std::vector<Completion>& completions, int timeoutMs) {
+    completions.clear();
+    Rings& rings = *rings_;
+
+    // only block when nothing is ready yet
+    bool ready = loadAcquire(rings.cqTail) != *rings.cqHead;
+    __kernel_timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    uint32_t flags = ready ? 0 : (IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG);
+    if (!ready || rings.toSubmit > 0) {
+        int ret = uringEnter(rings.fd, rings.toSubmit, ready ? 0 : 1, flags,
+                             ready ? nullptr : &arg, ready ? 0 : sizeof(arg));
+        if (ret >= 0) {
+            rings.toSubmit -= std::min<uint32_t>(rings.toSubmit, ret);
+        } else if (errno != ETIME && errno != EINTR) {
+            LOGE("[NET]: io_uring wait failed: ", net::GetLastError());
+            return -1;
+        }
+    }
+
+    uint32_t head = *rings.cqHead;
+    uint32_t tail = loadAcquire(rings.cqTail);
+    for (; head != tail; head++) {
+        const io_uring_cqe& cqe = rings.cqes[head & rings.cqMask];
+        if (cqe.user_data == InternalUserData) {
+            continue;
+        }
+        Completion completion;
+        completion.userData = cqe.user_data;
+        completion.result = cqe.res;
+        completion.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        completion.bufferId = (cqe.flags & IORING_CQE_F_BUFFER) ? int(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+        completions.push_back(completion);
+    }
+    storeRelease(rings.cqHead, head);
+    return static_cast<int>(completions.size());
+}
+
+const uint8_t* IoUring::Buffer(int id) const {
+    return rings_->buffers.get() + size_t(id) * rings_->bufferSize;
+}
+
+void IoUring::ReleaseBuffer(int id) {
+    if (rings_->legacyBuffers) {
+        // goes to the kernel with the next `Wait`
+        rings_->provideBuffers(static_cast<uint16_t>(id), 1);
+        return;
+    }
+    rings_->addBuffer(static_cast<uint16_t>(id));
+    storeRelease(&rings_->bufRing->tail, rings_->bufTail);
+}
+
+#else
+
+struct IoUring::Rings {};
+
+std::unique_ptr<IoUring> IoUring::Create(uint32_t, uint32_t, uint32_t) {
+    LOGI("[NET]: io_uring is not available in this build");
+    return nullptr;
+}
+
+IoUring::~IoUring() = default;
+
+bool IoUring::Recv(net::SocketHandle, uint64_t) {
+    return false;
+}
+
+bool IoUring::PollIn(net::SocketHandle, uint64_t) {
+    return false;
+}
+
+bool IoUring::Cancel(uint64_t) {
+    return false;
+}
+
+void IoUring::Submit() {}
+
+int IoUring::Wait(std::vector<Completion>& completions, int) {
+    completions.clear();
+    return -1;
+}
+
+bool IoUring::RingBuffers() const {
+    return false;
+}
+
+const uint8_t* IoUring::Buffer(int) const {
+    return nullptr;
+}
+
+void IoUring::ReleaseBuffer(int) {}
+
+#endif
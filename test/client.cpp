@@ -7,7 +7,8 @@
 int main() {
     auto net = net::Init();
 
-    NetSender sender(net, 8999);
+    // queue packets and let a background thread write them, the loop below never waits on the socket
+    NetSender sender(net, 8999, NetSender::AsyncConfig{});
 
     Packet packet;
     packet.type = Mesh::Type::LineLoop;
@@ -21,17 +22,19 @@ int main() {
 
     sender.SendPacket(packet);
 
+    // lots of tiny meshes share one frame
+    std::vector<Packet> points(1000);
     for (int i = 0; i < 1000; i++) {
-        Packet packet2;
-        packet2.type = Mesh::Type::Points;
-        NetData data;
-        data.name = "points" + std::to_string(i);
-        data.positions.push_back(Vec3(-0.5, 0, -1));
-        data.color = Vec3(0.2, 0.5, 0.7);
-        packet2.data = data;
-
-        sender.SendPacket(packet2);
+        points[i].type = Mesh::Type::Points;
+        points[i].data.name = "points" + std::to_string(i);
+        points[i].data.positions.push_back(Vec3(-0.5, 0, -1));
+        points[i].data.color = Vec3(0.2, 0.5, 0.7);
     }
+    sender.SendBatch(points);
+
+    sender.Flush();
+    auto stats = sender.Stats();
+    LOGI("sent ", stats.sentPackets, " packets(", stats.sentBytes, " bytes), dropped ", stats.droppedPackets);
 
     std::this_thread::sleep_for(std::chrono::seconds(5));
 
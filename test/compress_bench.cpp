@@ -0,0 +1,120 @@
+// compression ratio and MB/s of `BlockCodec` on payloads shaped like what gets sent.
+// usage: compress_bench [points]
+#include "pch.hpp"
+#include "netdata.hpp"
+#include "compress.hpp"
+#include <chrono>
+#include <random>
+
+namespace {
+
+std::vector<uint8_t> payloadOf(const std::vector<Packet>& packets) {
+    std::vector<uint8_t> payload;
+    if (packets.size() == 1) {
+        packets[0].SerializeTo(payload);
+    } else {
+        Batch::SerializeTo(payload, packets.data(), packets.size());
+    }
+    return payload;
+}
+
+void report(const char* name, const std::vector<uint8_t>& raw) {
+    const int rounds = 10;
+    std::vector<uint8_t> packed, decoded;
+    auto seconds = [&](auto&& work) {
+        work();     // warm up, fault the pages in
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            work();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / rounds;
+    };
+
+    bool shrinks = true;
+    double compress = seconds([&]() {
+        packed.clear();
+        shrinks = BlockCodec::Compress(raw.data(), raw.size(), packed);
+    });
+    if (!shrinks) {
+        printf("%-28s %9zu bytes  doesn't compress, %8.1f MB/s to find out\n", name, raw.size(),
+               raw.size() / compress / 1e6);
+        return;
+    }
+    double decompress = seconds([&]() {
+        BlockCodec::Decompress(packed.data(), packed.data() + packed.size(), decoded);
+    });
+    if (decoded != raw) {
+        printf("%-28s round trip FAILED\n", name);
+        return;
+    }
+    printf("%-28s %9zu bytes  ratio %5.2f  compress %8.1f MB/s  decompress %8.1f MB/s\n", name, raw.size(),
+           static_cast<double>(raw.size()) / packed.size(), raw.size() / compress / 1e6,
+           raw.size() / decompress / 1e6);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc >= 2 ? std::atoll(argv[1]) : 200000;
+    std::mt19937 rng(42);
+
+    // scattered samples, e.g. a lidar scan: the worst case
+    std::uniform_real_distribution<double> dist(-50, 50);
+    Packet cloud;
+    cloud.type = Mesh::Type::Points;
+    cloud.data.name = "cloud";
+    for (size_t i = 0; i < count; i++) {
+        cloud.data.positions.push_back(Vec3(dist(rng), dist(rng), dist(rng)));
+    }
+    report("point cloud float64", payloadOf({cloud}));
+    cloud.encoding = PositionEncoding::Float32;
+    report("point cloud float32", payloadOf({cloud}));
+    cloud.encoding = PositionEncoding::Quantized16;
+    report("point cloud quantized16", payloadOf({cloud}));
+
+    // a height field: regular x/z, repeated index pattern
+    Packet terrain;
+    terrain.type = Mesh::Type::Triangles;
+    terrain.data.name = "terrain";
+    size_t side = static_cast<size_t>(std::sqrt(static_cast<double>(count)));
+    for (size_t z = 0; z < side; z++) {
+        for (size_t x = 0; x < side; x++) {
+            terrain.data.positions.push_back(Vec3(x * 0.5f, std::sin(x * 0.1f) * std::cos(z * 0.1f), z * 0.5f));
+        }
+    }
+    for (uint32_t z = 0; z + 1 < side; z++) {
+        for (uint32_t x = 0; x + 1 < side; x++) {
+            uint32_t i = z * side + x;
+            terrain.data.indices.insert(terrain.data.indices.end(),
+                                        {i, i + 1, i + uint32_t(side), i + 1, i + uint32_t(side) + 1, i + uint32_t(side)});
+        }
+    }
+    report("terrain float64 + indices", payloadOf({terrain}));
+    terrain.encoding = PositionEncoding::Float32;
+    report("terrain float32 + indices", payloadOf({terrain}));
+
+    // a robot path: smooth, axis aligned most of the time
+    Packet path;
+    path.type = Mesh::Type::LineStrip;
+    path.data.name = "trajectory";
+    Vec3 at(0, 0, 0);
+    for (size_t i = 0; i < count; i++) {
+        at.x += (i / 1000) % 2 ? 0.01f : 0.0f;
+        at.y += (i / 1000) % 2 ? 0.0f : 0.01f;
+        path.data.positions.push_back(at);
+    }
+    report("trajectory float64", payloadOf({path}));
+
+    // many small markers in one batch
+    std::vector<Packet> markers(count / 50);
+    for (size_t i = 0; i < markers.size(); i++) {
+        markers[i].type = Mesh::Type::Lines;
+        markers[i].data.name = "marker" + std::to_string(i);
+        markers[i].data.color = Vec3(1, 0.5, 0);
+        for (int j = 0; j < 8; j++) {
+            markers[i].data.positions.push_back(Vec3(i, j, 0));
+        }
+    }
+    report("batch of markers", payloadOf(markers));
+    return 0;
+}
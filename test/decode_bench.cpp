@@ -0,0 +1,62 @@
+// vertices/second of the position decode kernels on one big packet.
+// usage: decode_bench [points]
+#include "pch.hpp"
+#include "netdata.hpp"
+#include "position_decode.hpp"
+#include <chrono>
+#include <random>
+
+int main(int argc, char** argv) {
+    const size_t count = argc >= 2 ? std::atoll(argv[1]) : 1000000;
+    const int rounds = 20;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(-50, 50);
+    std::vector<uint8_t> src64(count * sizeof(double) * 3);
+    std::vector<uint8_t> src32(count * sizeof(float) * 3);
+    for (size_t i = 0; i < count * 3; i++) {
+        double value = dist(rng);
+        float valuef = static_cast<float>(value);
+        memcpy(src64.data() + i * sizeof(double), &value, sizeof(double));
+        memcpy(src32.data() + i * sizeof(float), &valuef, sizeof(float));
+    }
+    std::vector<float> dst(count * 3);
+
+    auto measure = [&](auto&& decode) {
+        decode();   // warm up, fault the pages in
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            decode();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / rounds;
+        return count / seconds / 1e6;
+    };
+
+    printf("%zu points, best kernel %s\n", count, DecodeKernelName(BestDecodeKernel()));
+    for (auto kernel : {DecodeKernel::Scalar, DecodeKernel::SSE2, DecodeKernel::AVX2}) {
+        if (kernel > BestDecodeKernel()) {
+            break;
+        }
+        for (bool swap : {false, true}) {
+            double f64 = measure([&]() { DecodeFloat64Positions(src64.data(), count, swap, dst.data(), kernel); });
+            double f32 = measure([&]() { DecodeFloat32Positions(src32.data(), count, swap, dst.data(), kernel); });
+            printf("%-6s swap %-3s  float64 %8.1f M vertices/s  float32 %8.1f M vertices/s\n",
+                   DecodeKernelName(kernel), swap ? "yes" : "no", f64, f32);
+        }
+    }
+
+    // the whole receive path: parse a frame payload and decode it into vertex storage
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "bench";
+    packet.data.color = Vec3(1, 0, 0);
+    packet.data.positions.resize(count, Vec3(1, 2, 3));
+    auto payload = packet.Serialize();
+    std::vector<Vertex> vertices(count);
+    double view = measure([&]() {
+        auto parsed = PacketView::Parse(payload.data(), payload.data() + payload.size());
+        parsed->DecodeTo(vertices.data());
+    });
+    printf("PacketView::DecodeTo          %8.1f M vertices/s\n", view);
+    return 0;
+}
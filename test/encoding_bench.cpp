@@ -0,0 +1,64 @@
+// bytes on the wire and encode/decode cost of each position encoding.
+// usage: encoding_bench [points]
+#include "pch.hpp"
+#include "netdata.hpp"
+#include <chrono>
+#include <random>
+
+namespace {
+
+const char* EncodingName(PositionEncoding encoding) {
+    switch (encoding) {
+        case PositionEncoding::Float64: return "float64";
+        case PositionEncoding::Float32: return "float32";
+        case PositionEncoding::Quantized16: return "quantized16";
+    }
+    return "unknown";
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc >= 2 ? std::atoll(argv[1]) : 1000000;
+    const int rounds = 10;
+
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "bench";
+    packet.data.color = Vec3(1, 0, 0);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-50, 50);
+    packet.data.positions.resize(count);
+    for (auto& pos : packet.data.positions) {
+        pos = Vec3(dist(rng), dist(rng), dist(rng) * 0.1f);
+    }
+
+    printf("%zu points\n", count);
+    for (auto encoding : {PositionEncoding::Float64, PositionEncoding::Float32, PositionEncoding::Quantized16}) {
+        packet.encoding = encoding;
+        std::vector<uint8_t> buf;
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            buf.clear();
+            packet.SerializeTo(buf);
+        }
+        auto encoded = std::chrono::steady_clock::now();
+        std::optional<Packet> decoded;
+        for (int i = 0; i < rounds; i++) {
+            decoded = Packet::Deserialize(buf.data(), buf.data() + buf.size());
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        float maxError = 0;
+        for (size_t i = 0; i < count; i++) {
+            Vec3 diff = glm::abs(decoded->data.positions[i] - packet.data.positions[i]);
+            maxError = std::max({maxError, diff.x, diff.y, diff.z});
+        }
+        double encodeMs = std::chrono::duration<double, std::milli>(encoded - begin).count() / rounds;
+        double decodeMs = std::chrono::duration<double, std::milli>(end - encoded).count() / rounds;
+        printf("%-12s %10zu bytes (%5.2f B/vertex)  encode %7.2f ms  decode %7.2f ms  max error %g\n",
+               EncodingName(encoding), buf.size(), buf.size() / double(count), encodeMs, decodeMs, maxError);
+    }
+    return 0;
+}
@@ -0,0 +1,526 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "netdata.hpp"
+#include "reactor.hpp"
+#include "shm.hpp"
+#include "udp.hpp"
+#include "uring.hpp"
+#include <chrono>
+#include <thread>
+
+#ifndef _WIN32
+
+namespace {
+
+// both ends of a connected stream socket, the reactor gets the first
+std::pair<std::unique_ptr<net::Socket>, std::unique_ptr<net::Socket>> SocketPair() {
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    return {std::make_unique<net::Socket>(fds[0]), std::make_unique<net::Socket>(fds[1])};
+}
+
+std::vector<uint8_t> MakeFrame(const std::string& name, size_t vertices = 1) {
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = name;
+    packet.data.positions.resize(vertices, Vec3(1, 2, 3));
+    auto payload = packet.Serialize();
+
+    FrameHeader header;
+    header.length = payload.size();
+    std::vector<uint8_t> frame(FrameHeader::Size);
+    header.Write(frame.data());
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+// no `REQUIRE` in here, senders run on threads of their own
+bool SendAll(net::Socket& socket, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        auto len = ::send(socket.Handle(), data, size, net::SendFlags);
+        if (len <= 0) {
+            return false;
+        }
+        data += len;
+        size -= len;
+    }
+    return true;
+}
+
+template <typename F>
+bool WaitUntil(F&& done, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// a Unix domain socket listening at a fresh path under /tmp
+struct UnixListener {
+    std::string path;
+    net::Socket* socket = nullptr;
+
+    UnixListener(std::unique_ptr<net::Net>& net, const std::string& name)
+        : path("/tmp/" + name + "_" + std::to_string(getpid()) + ".sock") {
+        // the address is a temporary, the socket keeps a copy
+        socket = net->CreateSocket(net::AddrInfoBuilder::CreateUnix(path).Build().value);
+        REQUIRE(socket->Bind() == 0);
+        REQUIRE(socket->Listen(SOMAXCONN) == 0);
+    }
+
+    ~UnixListener() {
+        unlink(path.c_str());
+    }
+};
+
+// counts the packets of a connection until it closes
+struct Drain {
+    std::atomic<uint64_t> packets = 0;
+    std::thread thread;
+
+    void Start(std::unique_ptr<net::Socket>&& client) {
+        thread = std::thread([this, client = std::move(client)]() mutable {
+            NetRecv recv(std::move(client));
+            while (recv) {
+                recv.RecvPacket([this](const std::vector<PacketView>& views) { packets += views.size(); });
+            }
+        });
+    }
+
+    ~Drain() {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+};
+
+Packet MakePacket(size_t vertices) {
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "packet";
+    packet.data.positions.resize(vertices, Vec3(1, 2, 3));
+    return packet;
+}
+
+// names of the packets handed to a reactor, in the order they came
+struct Received {
+    std::mutex mutex;
+    std::vector<std::string> names;
+
+    void operator()(const std::vector<PacketView>& packets) {
+        std::lock_guard guard(mutex);
+        for (const auto& packet : packets) {
+            names.emplace_back(packet.name);
+        }
+    }
+
+    size_t Size() {
+        std::lock_guard guard(mutex);
+        return names.size();
+    }
+};
+
+}
+
+TEST_CASE("Poller") {
+    net::Poller poller;
+    REQUIRE(poller.Valid());
+    auto [a, b] = SocketPair();
+    int tag = 0;
+    REQUIRE(poller.Add(a->Handle(), &tag));
+
+    std::vector<net::Poller::Event> events;
+    REQUIRE(poller.Wait(events, 0) == 0);
+
+    uint8_t byte = 1;
+    REQUIRE(SendAll(*b, &byte, 1));
+    REQUIRE(poller.Wait(events, 1000) == 1);
+    REQUIRE(events[0].userData == &tag);
+    REQUIRE(events[0].readable);
+    REQUIRE_FALSE(events[0].hangup);
+
+    // not watched, however readable it is
+    poller.Remove(a->Handle());
+    REQUIRE(poller.Wait(events, 10) == 0);
+
+    REQUIRE(poller.Add(a->Handle(), &tag));
+    b->Close();
+    REQUIRE(poller.Wait(events, 1000) == 1);
+    REQUIRE(events[0].hangup);
+}
+
+TEST_CASE("Reactor") {
+    // io_uring falls back to polling where the kernel lacks it, the sections hold either way
+    auto backend = GENERATE(Reactor::Backend::Poll, Reactor::Backend::Uring);
+    Received received;
+    auto handler = [&received](const std::vector<PacketView>& packets) { received(packets); };
+
+    SECTION("frames split across reads") {
+        Reactor reactor(handler, 0, backend);
+        auto [server, client] = SocketPair();
+        reactor.Add(std::move(server));
+        reactor.Start();
+
+        auto frame = MakeFrame("split", 100);
+        // cut inside the header, inside the name and inside the positions
+        size_t cuts[] = {0, 5, FrameHeader::Size + 3, frame.size() / 2, frame.size()};
+        for (size_t i = 0; i + 1 < std::size(cuts); i++) {
+            REQUIRE(received.Size() == 0);
+            REQUIRE(SendAll(*client, frame.data() + cuts[i], cuts[i + 1] - cuts[i]));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        REQUIRE(WaitUntil([&]() { return received.Size() == 1; }));
+        REQUIRE(received.names[0] == "split");
+        REQUIRE(reactor.Stats()[0].bytes == frame.size());
+        REQUIRE(reactor.Stats()[0].packets == 1);
+    }
+
+    SECTION("a closed connection is dropped with its unfinished frame") {
+        Reactor reactor(handler, 1, backend);
+        auto [server, client] = SocketPair();
+        reactor.Add(std::move(server));
+        reactor.Start();
+
+        auto frame = MakeFrame("whole");
+        auto unfinished = MakeFrame("unfinished");
+        REQUIRE(SendAll(*client, frame.data(), frame.size()));
+        REQUIRE(SendAll(*client, unfinished.data(), unfinished.size() - 1));
+        REQUIRE(WaitUntil([&]() { return received.Size() == 1; }));
+        REQUIRE(reactor.Stats().size() == 1);
+
+        client->Close();
+        REQUIRE(WaitUntil([&]() { return reactor.Stats().empty(); }));
+        REQUIRE(received.Size() == 1);
+    }
+
+    SECTION("workers keep each connection's packets in order") {
+        constexpr int Connections = 4;
+        constexpr int Frames = 200;
+        Reactor reactor(handler, 2, backend);
+        std::vector<std::unique_ptr<net::Socket>> clients;
+        for (int i = 0; i < Connections; i++) {
+            auto [server, client] = SocketPair();
+            reactor.Add(std::move(server));
+            clients.push_back(std::move(client));
+        }
+        reactor.Start();
+
+        std::vector<std::thread> senders;
+        for (int i = 0; i < Connections; i++) {
+            senders.emplace_back([&clients, i]() {
+                for (int j = 0; j < Frames; j++) {
+                    auto frame = MakeFrame(std::to_string(i) + "/" + std::to_string(j), 10);
+                    SendAll(*clients[i], frame.data(), frame.size());
+                }
+            });
+        }
+        for (auto& sender : senders) {
+            sender.join();
+        }
+        REQUIRE(WaitUntil([&]() { return received.Size() == Connections * Frames; }));
+
+        std::vector<int> next(Connections, 0);
+        bool ordered = true;
+        for (const auto& name : received.names) {
+            auto slash = name.find('/');
+            int conn = std::stoi(name.substr(0, slash));
+            ordered &= std::stoi(name.substr(slash + 1)) == next[conn]++;
+        }
+        REQUIRE(ordered);
+    }
+
+    SECTION("a connection is paused while its worker is behind") {
+        std::atomic<bool> release = false;
+        Reactor reactor([&](const std::vector<PacketView>& packets) {
+            while (!release) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            received(packets);
+        }, 1, backend);
+        reactor.SetWorkerQueueLimit(64 * 1024);
+        auto [server, client] = SocketPair();
+        reactor.Add(std::move(server));
+        reactor.Start();
+
+        constexpr int Frames = 200;
+        std::thread sender([&client = client]() {
+            for (int i = 0; i < Frames; i++) {
+                // 24KB of positions each
+                auto frame = MakeFrame(std::to_string(i), 1000);
+                SendAll(*client, frame.data(), frame.size());
+            }
+        });
+
+        REQUIRE(WaitUntil([&]() { return reactor.Stats()[0].pauses > 0; }));
+        // io_uring may still deliver the reads that completed before the pause
+        uint64_t bytes = 0;
+        REQUIRE(WaitUntil([&]() {
+            auto before = reactor.Stats()[0].bytes;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            bytes = reactor.Stats()[0].bytes;
+            return bytes == before;
+        }));
+        // nothing more is read while the worker is stuck
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(reactor.Stats()[0].bytes == bytes);
+        REQUIRE(bytes < Frames * 24000);
+
+        release = true;
+        sender.join();
+        REQUIRE(WaitUntil([&]() { return received.Size() == Frames; }));
+        bool ordered = true;
+        for (int i = 0; i < Frames; i++) {
+            ordered &= received.names[i] == std::to_string(i);
+        }
+        REQUIRE(ordered);
+    }
+}
+
+TEST_CASE("IoUring buffer ring") {
+    auto uring = IoUring::Create(8, 4, 64);
+    if (!uring) {
+        WARN("io_uring unavailable");
+        return;
+    }
+    REQUIRE(uring->RingBuffers());
+
+    auto [server, client] = SocketPair();
+    REQUIRE(uring->Recv(server->Handle(), 7));
+
+    // more reads than buffers, each one must come back through the ring
+    std::vector<IoUring::Completion> completions;
+    for (int i = 0; i < 20; i++) {
+        std::string msg = "message " + std::to_string(i);
+        REQUIRE(SendAll(*client, reinterpret_cast<const uint8_t*>(msg.data()), msg.size()));
+
+        std::string got;
+        while (got.size() < msg.size()) {
+            REQUIRE(uring->Wait(completions, 1000) > 0);
+            for (auto& c : completions) {
+                REQUIRE(c.userData == 7);
+                REQUIRE(c.more);
+                REQUIRE(c.result > 0);
+                REQUIRE(c.bufferId >= 0);
+                got.append(reinterpret_cast<const char*>(uring->Buffer(c.bufferId)), c.result);
+                uring->ReleaseBuffer(c.bufferId);
+            }
+        }
+        REQUIRE(got == msg);
+    }
+    REQUIRE(uring->Cancel(7));
+}
+
+TEST_CASE("Unix domain socket round trip") {
+    auto net = net::Init();
+    UnixListener listener(net, "visual_debugger_net_test_unix");
+    Received received;
+    Reactor reactor([&received](const std::vector<PacketView>& packets) { received(packets); });
+    REQUIRE(reactor.Listen(listener.socket));
+    reactor.Start();
+
+    NetSender sender(net, Endpoint::Unix(listener.path));
+    auto packet = MakePacket(100);
+    packet.data.name = "over unix";
+    sender.SendPacket(packet);
+    REQUIRE(sender.Stats().sentPackets == 1);
+    REQUIRE(WaitUntil([&]() { return received.Size() == 1; }));
+    REQUIRE(received.names[0] == "over unix");
+    REQUIRE(reactor.Stats().size() == 1);
+}
+
+TEST_CASE("Async sender overflow") {
+    auto net = net::Init();
+    UnixListener listener(net, "visual_debugger_net_test");
+    // big enough to fill the socket buffer in a few packets
+    auto packet = MakePacket(1000);
+    Drain drain;
+
+    SECTION("drop oldest never waits, every packet is sent or dropped") {
+        constexpr uint64_t Count = 2000;
+        NetSender::AsyncConfig config{64, NetSender::OverflowPolicy::DropOldest};
+        {
+            NetSender sender(net, Endpoint::Unix(listener.path), config);
+            auto client = listener.socket->Accept();
+            REQUIRE(client.value);
+
+            // nobody reads yet, the queue overflows as soon as the socket buffer is full
+            for (uint64_t i = 0; i < Count; i++) {
+                sender.SendPacket(packet);
+            }
+            drain.Start(std::move(client.value));
+            sender.Flush();
+
+            auto stats = sender.Stats();
+            REQUIRE(stats.droppedPackets > 0);
+            REQUIRE(stats.sentPackets + stats.droppedPackets == Count);
+            REQUIRE(WaitUntil([&]() { return drain.packets == stats.sentPackets; }));
+        }
+        // closed by the sender
+        drain.thread.join();
+    }
+
+    SECTION("block waits for room, nothing is dropped") {
+        constexpr uint64_t Count = 500;
+        NetSender::AsyncConfig config{4, NetSender::OverflowPolicy::Block};
+        NetSender sender(net, Endpoint::Unix(listener.path), config);
+        auto client = listener.socket->Accept();
+        REQUIRE(client.value);
+
+        std::atomic<uint64_t> pushed = 0;
+        std::thread producer([&]() {
+            for (uint64_t i = 0; i < Count; i++) {
+                sender.SendPacket(packet);
+                pushed ++;
+            }
+        });
+        // stuck behind the full socket buffer and queue
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        REQUIRE(pushed < Count);
+
+        drain.Start(std::move(client.value));
+        producer.join();
+        sender.Flush();
+        auto stats = sender.Stats();
+        REQUIRE(stats.droppedPackets == 0);
+        REQUIRE(stats.sentPackets == Count);
+        REQUIRE(WaitUntil([&]() { return drain.packets == Count; }));
+    }
+}
+
+TEST_CASE("Shared memory producer restart") {
+    const std::string name = "visual_debugger_net_test_" + std::to_string(getpid());
+    auto ring = ShmRing::Create(name, 64 * 1024);
+    REQUIRE(ring);
+    Received received;
+    ShmReceiver receiver(std::move(ring), [&received](const std::vector<PacketView>& packets) { received(packets); });
+    receiver.Start();
+
+    {
+        // dies in the middle of its second frame
+        auto producer = ShmRing::Open(name);
+        REQUIRE(producer);
+        auto whole = MakeFrame("whole");
+        auto cut = MakeFrame("cut", 100);
+        net::IoSlice slices[] = {
+            {whole.data(), whole.size()},
+            {cut.data(), cut.size() / 2},
+        };
+        REQUIRE(producer->Write(slices, 2));
+    }
+    REQUIRE(WaitUntil([&]() { return received.Size() == 1; }));
+
+    auto producer = ShmRing::Open(name);
+    REQUIRE(producer);
+    auto next = MakeFrame("next", 100);
+    net::IoSlice slice{next.data(), next.size()};
+    REQUIRE(producer->Write(&slice, 1));
+    REQUIRE(WaitUntil([&]() { return received.Size() == 2; }));
+    REQUIRE(received.names[0] == "whole");
+    REQUIRE(received.names[1] == "next");
+}
+
+namespace {
+
+std::vector<uint8_t> MakeDatagram(Opcode opcode, const std::vector<Packet>& packets, SequenceTag tag) {
+    std::vector<uint8_t> payload;
+    if (opcode == Opcode::Batch) {
+        Batch::SerializeTo(payload, packets.data(), packets.size());
+    } else {
+        packets[0].SerializeTo(payload);
+    }
+    FrameHeader header;
+    header.opcode = opcode;
+    header.flags = FrameHeader::FlagSequenced;
+    header.length = SequenceTag::Size + payload.size();
+    std::vector<uint8_t> datagram(FrameHeader::Size + SequenceTag::Size);
+    header.Write(datagram.data());
+    tag.Write(datagram.data() + FrameHeader::Size);
+    datagram.insert(datagram.end(), payload.begin(), payload.end());
+    return datagram;
+}
+
+Packet NamedPacket(const std::string& name, Opcode opcode = Opcode::Mesh) {
+    auto packet = MakePacket(1);
+    packet.data.name = name;
+    packet.opcode = opcode;
+    return packet;
+}
+
+}
+
+TEST_CASE("UDP receiver") {
+    auto net = net::Init();
+    auto server = net->CreateSocket(net::AddrInfoBuilder::CreateUDP("127.0.0.1", 0).Build().value);
+    REQUIRE(server->Bind() == 0);
+    sockaddr_in bound{};
+    socklen_t len = sizeof(bound);
+    REQUIRE(getsockname(server->Handle(), reinterpret_cast<sockaddr*>(&bound), &len) == 0);
+    auto client = net->CreateSocket(net::AddrInfoBuilder::CreateUDP("127.0.0.1", ntohs(bound.sin_port)).Build().value);
+    REQUIRE(client->Connect() == 0);
+
+    Received received;
+    UdpReceiver receiver(server, [&received](const std::vector<PacketView>& packets) { received(packets); });
+    receiver.Start();
+
+    // one at a time, so the order they are received in is the order they were sent in.
+    // Each record ends up handed on, stale or malformed, the last after the other two
+    size_t records = 0;
+    auto send = [&](Opcode opcode, const std::vector<Packet>& packets, SequenceTag tag) {
+        auto datagram = MakeDatagram(opcode, packets, tag);
+        REQUIRE(client->Send(datagram) == static_cast<int>(datagram.size()));
+        records += packets.size();
+        REQUIRE(WaitUntil([&]() {
+            auto stats = receiver.Stats();
+            return received.Size() + stats.stale + stats.malformed == records;
+        }));
+    };
+
+    SECTION("reordered datagrams are dropped as stale") {
+        send(Opcode::Mesh, {NamedPacket("udp/reorder")}, {1, 5});
+        send(Opcode::Mesh, {NamedPacket("udp/reorder")}, {1, 3});
+        send(Opcode::Mesh, {NamedPacket("udp/reorder")}, {1, 5});   // a duplicate of the newest is fine
+        send(Opcode::Mesh, {NamedPacket("udp/reorder")}, {1, 6});
+        REQUIRE(received.Size() == 3);
+        REQUIRE(receiver.Stats().stale == 1);
+    }
+
+    SECTION("sequence numbers wrap around") {
+        send(Opcode::Mesh, {NamedPacket("udp/wrap")}, {2, 0xfffffffe});
+        send(Opcode::Mesh, {NamedPacket("udp/wrap")}, {2, 1});
+        send(Opcode::Mesh, {NamedPacket("udp/wrap")}, {2, 0xffffffff});
+        REQUIRE(received.Size() == 2);
+        REQUIRE(receiver.Stats().stale == 1);
+
+        // a restarted sender has a new session, its numbers start over
+        send(Opcode::Mesh, {NamedPacket("udp/wrap")}, {3, 0});
+        REQUIRE(received.Size() == 3);
+    }
+
+    SECTION("meshes and transforms are ordered apart, names each on their own") {
+        send(Opcode::Mesh, {NamedPacket("udp/a")}, {4, 10});
+        send(Opcode::Transform, {NamedPacket("udp/a", Opcode::Transform)}, {4, 5});
+        send(Opcode::Mesh, {NamedPacket("udp/b")}, {4, 7});
+        REQUIRE(received.Size() == 3);
+        send(Opcode::Transform, {NamedPacket("udp/a", Opcode::Transform)}, {4, 4});
+        REQUIRE(received.Size() == 3);
+        REQUIRE(receiver.Stats().stale == 1);
+    }
+
+    SECTION("range updates are refused, even inside a batch") {
+        send(Opcode::Batch, {NamedPacket("udp/batch1"), NamedPacket("udp/batch2", Opcode::Append),
+                             NamedPacket("udp/batch3", Opcode::Replace)}, {5, 1});
+        REQUIRE(received.Size() == 1);
+        REQUIRE(received.names[0] == "udp/batch1");
+        REQUIRE(receiver.Stats().malformed == 2);
+
+        send(Opcode::Append, {NamedPacket("udp/append", Opcode::Append)}, {5, 2});
+        REQUIRE(received.Size() == 1);
+        REQUIRE(receiver.Stats().malformed == 3);
+    }
+}
+
+#endif
@@ -1,6 +1,9 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "netdata.hpp"
+#include "position_decode.hpp"
+#include "wire.hpp"
+#include <random>
 
 TEST_CASE("Packet Serialize and Deserailize") {
     Packet packet;
@@ -23,4 +26,620 @@ TEST_CASE("Packet Serialize and Deserailize") {
     REQUIRE(depacket.data.positions[0] == Vec3(1, 2, 3));
     REQUIRE(depacket.data.positions[1] == Vec3(4, 5, 6));
     REQUIRE(depacket.data.positions[2] == Vec3(7, 8, 9));
-}
\ No newline at end of file
+}
+
+// `tag` goes in front of the payload when `flags` has `FrameHeader::FlagSequenced`
+std::vector<uint8_t> MakeFrame(Opcode opcode, const std::vector<uint8_t>& payload, uint16_t flags = 0,
+                               SequenceTag tag = {}) {
+    size_t tagSize = (flags & FrameHeader::FlagSequenced) ? SequenceTag::Size : 0;
+    FrameHeader header;
+    header.opcode = opcode;
+    header.flags = flags;
+    header.length = tagSize + payload.size();
+    std::vector<uint8_t> frame(FrameHeader::Size + tagSize);
+    header.Write(frame.data());
+    if (tagSize) {
+        tag.Write(frame.data() + FrameHeader::Size);
+    }
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+std::vector<uint8_t> MakeFrame(const Packet& packet) {
+    return MakeFrame(packet.opcode, packet.Serialize());
+}
+
+std::vector<uint8_t> MakeLegacyFrame(const Packet& packet) {
+    auto payload = packet.Serialize();
+    std::vector<uint8_t> frame = {'B', 'E', 'G'};
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    frame.insert(frame.end(), {'E', 'N', 'D'});
+    return frame;
+}
+
+TEST_CASE("Frame split") {
+    Packet packet;
+    packet.type = Mesh::Type::LineStrip;
+    packet.data.name = "BEG-END";
+    packet.data.positions.push_back(Vec3(1, 2, 3));
+    packet.data.positions.push_back(Vec3(4, 5, 6));
+    packet.data.color = Vec3(1, 0, 0);
+
+    SECTION("frames split at every byte") {
+        auto frame = MakeFrame(packet);
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < 3; i++) {
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+
+        NetRecv recv(nullptr);
+        std::vector<Packet> packets;
+        for (auto& byte : stream) {
+            auto result = recv.Feed(&byte, &byte + 1);
+            packets.insert(packets.end(), result.begin(), result.end());
+        }
+        REQUIRE(packets.size() == 3);
+        for (auto& p : packets) {
+            REQUIRE(p.type == Mesh::Type::LineStrip);
+            REQUIRE(p.data.name == "BEG-END");
+            REQUIRE(p.data.positions.size() == 2);
+            // receiver swaps y and z
+            REQUIRE(p.data.positions[1] == Vec3(4, 6, 5));
+        }
+    }
+
+    SECTION("legacy and new frames mixed") {
+        Packet legacy = packet;
+        legacy.data.name = "legacy";
+        auto frame = MakeFrame(packet);
+        auto legacyFrame = MakeLegacyFrame(legacy);
+        std::vector<uint8_t> stream = legacyFrame;
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        stream.insert(stream.end(), legacyFrame.begin(), legacyFrame.end());
+
+        NetRecv recv(nullptr);
+        auto packets = recv.Feed(stream.data(), stream.data() + 5);
+        REQUIRE(packets.empty());
+        packets = recv.Feed(stream.data() + 5, stream.data() + stream.size());
+        REQUIRE(packets.size() == 3);
+        REQUIRE(packets[0].data.name == "legacy");
+        REQUIRE(packets[1].data.name == "BEG-END");
+        REQUIRE(packets[2].data.name == "legacy");
+        REQUIRE(packets[2].data.positions[0] == Vec3(1, 3, 2));
+    }
+}
+
+TEST_CASE("Large frame in small chunks") {
+    Packet packet;
+    packet.type = Mesh::Type::LineStrip;
+    packet.data.name = "polyline";
+    for (int i = 0; i < 100000; i++) {
+        packet.data.positions.push_back(Vec3(i, i + 1, i + 2));
+    }
+    auto frame = MakeFrame(packet);
+
+    NetRecv recv(nullptr);
+    std::vector<Packet> packets;
+    for (size_t i = 0; i < frame.size(); i += 1000) {
+        auto end = std::min(frame.size(), i + 1000);
+        auto result = recv.Feed(frame.data() + i, frame.data() + end);
+        packets.insert(packets.end(), result.begin(), result.end());
+    }
+    REQUIRE(packets.size() == 1);
+    REQUIRE(packets[0].data.positions.size() == 100000);
+    REQUIRE(packets[0].data.positions[99999] == Vec3(99999, 100001, 100000));
+}
+
+TEST_CASE("Sequenced frame") {
+    SequenceTag older{7, 0xfffffffe};
+    SequenceTag newer{7, 1};
+    REQUIRE(newer.NewerThan(older));   // wrapped around
+    REQUIRE_FALSE(older.NewerThan(newer));
+    REQUIRE_FALSE(newer.NewerThan(newer));
+    REQUIRE(SequenceTag{8, 0}.NewerThan(newer)); // restarted sender
+
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "tick";
+    packet.data.color = Vec3(1, 0, 0);
+    packet.data.positions = {Vec3(1, 2, 3)};
+
+    // a sequenced frame on a stream decodes like a plain one
+    auto frame = MakeFrame(packet.opcode, packet.Serialize(), FrameHeader::FlagSequenced, newer);
+
+    NetRecv recv(nullptr);
+    auto packets = recv.Feed(frame.data(), frame.data() + frame.size());
+    REQUIRE(packets.size() == 1);
+    REQUIRE(packets[0].data.name == "tick");
+    REQUIRE(packets[0].data.positions[0] == Vec3(1, 3, 2));
+}
+
+TEST_CASE("Compressed frame") {
+    Packet packet;
+    packet.type = Mesh::Type::Triangles;
+    packet.data.name = "terrain";
+    packet.data.color = Vec3(0, 1, 0);
+    for (int z = 0; z < 100; z++) {
+        for (int x = 0; x < 100; x++) {
+            packet.data.positions.push_back(Vec3(x, 0, z));
+        }
+    }
+    auto payload = packet.Serialize();
+
+    std::vector<uint8_t> packed;
+    REQUIRE(BlockCodec::Compress(payload.data(), payload.size(), packed));
+    REQUIRE(packed.size() < payload.size() / 2);
+
+    auto frame = MakeFrame(packet.opcode, packed, FrameHeader::FlagSequenced | FrameHeader::FlagCompressed,
+                           SequenceTag{3, 9});
+    // two in one read, each view must keep its own decompressed payload
+    frame.insert(frame.end(), frame.begin(), frame.end());
+
+    NetRecv recv(nullptr);
+    std::vector<Packet> packets;
+    for (size_t i = 0; i < frame.size(); i += 777) {
+        auto end = std::min(frame.size(), i + 777);
+        auto result = recv.Feed(frame.data() + i, frame.data() + end);
+        packets.insert(packets.end(), result.begin(), result.end());
+    }
+    REQUIRE(packets.size() == 2);
+    for (auto& decoded : packets) {
+        REQUIRE(decoded.data.name == "terrain");
+        REQUIRE(decoded.data.positions.size() == 10000);
+        REQUIRE(decoded.data.positions[9999] == Vec3(99, 99, 0));
+    }
+
+    // a corrupt one is dropped, the stream goes on
+    frame[frame.size() / 2 + FrameHeader::Size + SequenceTag::Size + 10] ^= 0xff;
+    frame[frame.size() / 2 + FrameHeader::Size + SequenceTag::Size + 11] ^= 0xff;
+    auto views = recv.Feed(frame.data(), frame.data() + frame.size());
+    REQUIRE(views.size() >= 1);
+    REQUIRE(views[0].data.positions.size() == 10000);
+}
+
+TEST_CASE("Name interning") {
+    auto& table = NameTable::Instance();
+    uint32_t first = table.Intern("interning/a");
+    REQUIRE(table.Intern("interning/b") == first + 1);
+    REQUIRE(table.Intern("interning/a") == first);
+    REQUIRE(table.Name(first) == "interning/a");
+    REQUIRE(table.Name(NameTable::None).empty());
+
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "interning/box";
+    packet.data.positions = {Vec3(1, 2, 3)};
+
+    std::vector<uint8_t> declaration, byId, stream;
+    NameDeclaration{7, packet.data.name}.SerializeTo(declaration);
+    packet.SerializeTo(byId, 7);
+    REQUIRE(byId.size() == packet.Serialize().size() - packet.data.name.size() + 4);
+
+    auto undeclared = MakeFrame(Opcode::Mesh, byId);
+    auto declare = MakeFrame(Opcode::Declare, declaration);
+    stream.insert(stream.end(), undeclared.begin(), undeclared.end());
+    stream.insert(stream.end(), declare.begin(), declare.end());
+    stream.insert(stream.end(), undeclared.begin(), undeclared.end());
+
+    NetRecv recv(nullptr);
+    std::vector<PacketView> views;
+    recv.Feed(stream.data(), stream.data() + stream.size(), [&views](const std::vector<PacketView>& got) {
+        views = got;
+    });
+    // the first one comes before its declaration and is dropped
+    REQUIRE(views.size() == 1);
+    REQUIRE(views[0].name == "interning/box");
+    REQUIRE(views[0].id == table.Intern("interning/box"));
+
+    SECTION("declared inside a batch") {
+        std::vector<uint8_t> payload;
+        Batch::Writer writer(payload);
+        writer.Add(NameDeclaration{0, "interning/sphere"});
+        writer.Add(packet, 0);
+        writer.Add(packet);
+        auto frame = MakeFrame(Opcode::Batch, payload);
+
+        NetRecv fresh(nullptr);
+        auto packets = fresh.Feed(frame.data(), frame.data() + frame.size());
+        REQUIRE(packets.size() == 2);
+        REQUIRE(packets[0].data.name == "interning/sphere");
+        REQUIRE(packets[0].data.positions[0] == Vec3(1, 3, 2));
+        REQUIRE(packets[1].data.name == "interning/box");
+
+        // ids belong to the connection
+        auto packetsElsewhere = recv.Feed(frame.data(), frame.data() + frame.size());
+        REQUIRE(packetsElsewhere.size() == 2);
+        REQUIRE(packetsElsewhere[0].data.name == "interning/sphere");
+    }
+
+    SECTION("ids past the cap are refused") {
+        std::vector<uint8_t> payload;
+        Batch::Writer writer(payload);
+        writer.Add(NameDeclaration{NameDeclaration::MaxIds, "interning/far"});
+        writer.Add(packet, NameDeclaration::MaxIds);
+        auto frame = MakeFrame(Opcode::Batch, payload);
+
+        NetRecv fresh(nullptr);
+        REQUIRE(fresh.Feed(frame.data(), frame.data() + frame.size()).empty());
+    }
+
+    SECTION("cut short") {
+        REQUIRE_FALSE(PacketView::Parse(byId.data(), byId.data() + byId.size() - 1));
+        REQUIRE_FALSE(PacketView::Parse(declaration.data(), declaration.data() + 3, Opcode::Declare));
+    }
+}
+
+namespace {
+
+struct WireRecord {
+    uint8_t kind = 0;
+    Opcode opcode = Opcode::Mesh;
+    uint32_t size = 0;
+    Vec3 point;
+};
+
+using WireRecordSchema = wire::Schema<WireRecord,
+                                      wire::Const<uint16_t, 0xBEEF>,
+                                      wire::Field<&WireRecord::kind>,
+                                      wire::Field<&WireRecord::opcode, uint8_t>,
+                                      wire::Field<&WireRecord::size>,
+                                      wire::VecField<&WireRecord::point, 3, double>>;
+
+}
+
+TEST_CASE("Wire schema") {
+    static_assert(WireRecordSchema::Size == 2 + 1 + 1 + 4 + 24);
+
+    WireRecord record;
+    record.kind = 9;
+    record.opcode = Opcode::Batch;
+    record.size = 0x12345678;
+    record.point = Vec3(1.5, -2, 3);
+    std::vector<uint8_t> buf;
+    WireRecordSchema::Append(record, buf);
+    REQUIRE(buf.size() == WireRecordSchema::Size);
+    REQUIRE(buf[0] == 0xEF);
+    REQUIRE(buf[3] == static_cast<uint8_t>(Opcode::Batch));
+
+    WireRecord decoded;
+    REQUIRE(WireRecordSchema::Read(decoded, buf.data(), buf.data() + buf.size()) == buf.data() + buf.size());
+    REQUIRE(decoded.kind == 9);
+    REQUIRE(decoded.opcode == Opcode::Batch);
+    REQUIRE(decoded.size == 0x12345678);
+    REQUIRE(decoded.point == record.point);
+
+    REQUIRE_FALSE(WireRecordSchema::Read(decoded, buf.data(), buf.data() + buf.size() - 1));
+    buf[1] = 0;
+    REQUIRE_FALSE(WireRecordSchema::Read(decoded, buf.data(), buf.data() + buf.size()));
+
+    // a garbage count can't wrap the bounds check around
+    wire::Reader reader(buf.data(), buf.data() + buf.size());
+    REQUIRE_FALSE(reader.TakeArray(UINT32_MAX, UINT32_MAX));
+    uint8_t byte;
+    REQUIRE_FALSE(reader.Read(byte));   // failed once, stays failed
+    REQUIRE_FALSE(reader.Ok());
+}
+
+TEST_CASE("Parse never reads past the payload") {
+    Packet packet;
+    packet.type = Mesh::Type::Triangles;
+    packet.data.name = "mesh";
+    packet.data.positions = {Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 1, 0)};
+    packet.data.colors = {Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1)};
+    packet.data.normals = packet.data.colors;
+    packet.data.indices = {0, 1, 2};
+
+    std::mt19937 rng(7);
+    for (auto encoding : {PositionEncoding::Float64, PositionEncoding::Float32, PositionEncoding::Quantized16}) {
+        packet.encoding = encoding;
+        auto payload = packet.Serialize();
+        // every prefix without the name is cut short
+        for (size_t size = 0; size + packet.data.name.size() < payload.size(); size++) {
+            // a copy of exactly `size` bytes, so a sanitizer catches any overread
+            std::vector<uint8_t> cut(payload.begin(), payload.begin() + size);
+            REQUIRE_FALSE(PacketView::Parse(cut.data(), cut.data() + cut.size()));
+        }
+        // garbage counts
+        for (int i = 0; i < 2000; i++) {
+            auto garbled = payload;
+            garbled[rng() % garbled.size()] = static_cast<uint8_t>(rng());
+            garbled[rng() % garbled.size()] = static_cast<uint8_t>(rng());
+            if (auto view = PacketView::Parse(garbled.data(), garbled.data() + garbled.size()); view) {
+                REQUIRE(view->positions + view->count * 3 <= garbled.data() + garbled.size());
+            }
+        }
+    }
+}
+
+TEST_CASE("Position encodings") {
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "cloud";
+    packet.data.color = Vec3(0.1, 0.2, 0.3);
+    for (int i = 0; i < 1000; i++) {
+        packet.data.positions.push_back(Vec3(i * 0.01f, -i * 0.5f, 3.0f));
+    }
+
+    SECTION("float32 is exact") {
+        packet.encoding = PositionEncoding::Float32;
+        auto buf = packet.Serialize();
+        REQUIRE(buf.size() == 1 + 4 + 1000 * 12 + 24 + 5);
+        auto depacket = Packet::Deserialize(buf.data(), buf.data() + buf.size());
+        REQUIRE(depacket);
+        REQUIRE(depacket->type == Mesh::Type::Points);
+        REQUIRE(depacket->encoding == PositionEncoding::Float32);
+        REQUIRE(depacket->data.positions == packet.data.positions);
+        REQUIRE(depacket->data.name == "cloud");
+    }
+
+    SECTION("quantized is within half a step of the AABB") {
+        packet.encoding = PositionEncoding::Quantized16;
+        auto buf = packet.Serialize();
+        REQUIRE(buf.size() == 1 + 4 + 24 + 1000 * 6 + 24 + 5);
+        auto depacket = Packet::Deserialize(buf.data(), buf.data() + buf.size());
+        REQUIRE(depacket);
+        REQUIRE(depacket->data.positions.size() == 1000);
+        Vec3 step = Vec3(9.99f, 499.5f, 0) / 65535.0f;
+        for (size_t i = 0; i < 1000; i++) {
+            Vec3 diff = glm::abs(depacket->data.positions[i] - packet.data.positions[i]);
+            REQUIRE(diff.x <= step.x * 0.5f + 1e-5f);
+            REQUIRE(diff.y <= step.y * 0.5f + 1e-4f);
+            REQUIRE(diff.z == 0);   // flat axis
+        }
+        REQUIRE(depacket->data.color.g == Approx(0.2));
+    }
+}
+
+TEST_CASE("Range update frames") {
+    Packet append;
+    append.opcode = Opcode::Append;
+    append.type = Mesh::Type::LineStrip;
+    append.data.name = "trajectory";
+    append.data.color = Vec3(0, 1, 0);
+    append.data.positions = {Vec3(1, 2, 3)};
+
+    Packet replace = append;
+    replace.opcode = Opcode::Replace;
+    replace.offset = 41;
+    replace.encoding = PositionEncoding::Float32;
+    replace.data.positions = {Vec3(4, 5, 6), Vec3(7, 8, 9)};
+
+    auto buf = replace.Serialize();
+    REQUIRE(buf.size() == 4 + 1 + 4 + 2 * 12 + 24 + 10);
+    REQUIRE_FALSE(NetRecv::DecodeMesh(buf.data(), buf.data() + 7, Opcode::Replace));
+
+    std::vector<uint8_t> stream = MakeFrame(append);
+    auto frame = MakeFrame(replace);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+
+    NetRecv recv(nullptr);
+    auto packets = recv.Feed(stream.data(), stream.data() + stream.size());
+    REQUIRE(packets.size() == 2);
+    REQUIRE(packets[0].opcode == Opcode::Append);
+    REQUIRE(packets[0].data.positions[0] == Vec3(1, 3, 2));
+    REQUIRE(packets[1].opcode == Opcode::Replace);
+    REQUIRE(packets[1].offset == 41);
+    REQUIRE(packets[1].type == Mesh::Type::LineStrip);
+    REQUIRE(packets[1].data.name == "trajectory");
+    REQUIRE(packets[1].data.positions.size() == 2);
+    REQUIRE(packets[1].data.positions[1] == Vec3(7, 9, 8));
+}
+
+TEST_CASE("Transform frames") {
+    Packet move;
+    move.opcode = Opcode::Transform;
+    move.type = Mesh::Type::Lines;
+    move.data.name = "box";
+    move.transform = glm::translate(glm::mat4(1.0f), glm::vec3(1, 2, 3)) *
+                     glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0, 0, 1));
+
+    auto buf = move.Serialize();
+    REQUIRE(buf.size() == 1 + 48 + 3);
+    std::vector<uint8_t> byId;
+    move.SerializeTo(byId, 7);
+    REQUIRE(byId.size() == 1 + 48 + 4);
+    REQUIRE(MakeFrame(Opcode::Transform, byId).size() == 65);
+    REQUIRE_FALSE(PacketView::Parse(buf.data(), buf.data() + 48, Opcode::Transform));
+
+    auto copy = Packet::Deserialize(buf.data(), buf.data() + buf.size(), Opcode::Transform);
+    REQUIRE(copy);
+    REQUIRE(copy->transform == move.transform);
+    REQUIRE(copy->type == Mesh::Type::Lines);
+    REQUIRE(copy->data.name == "box");
+    REQUIRE(copy->data.positions.empty());
+
+    // moves a vertex in viewer coordinates where the original moved it in the sender's
+    std::vector<uint8_t> batch;
+    Batch::Writer writer(batch);
+    writer.Add(move);
+    auto views = std::vector<PacketView>();
+    REQUIRE(Batch::Parse(batch.data(), batch.data() + batch.size(), views));
+    REQUIRE(views.size() == 1);
+    REQUIRE(views[0].opcode == Opcode::Transform);
+    glm::vec4 moved = move.transform * glm::vec4(4, 5, 6, 1);
+    glm::vec4 viewerMoved = views[0].DecodeTransform() * glm::vec4(4, 6, 5, 1);
+    REQUIRE(viewerMoved.x == Approx(moved.x));
+    REQUIRE(viewerMoved.y == Approx(moved.z));
+    REQUIRE(viewerMoved.z == Approx(moved.y));
+    REQUIRE(viewerMoved.w == Approx(1));
+
+    auto frame = MakeFrame(move);
+    NetRecv recv(nullptr);
+    auto packets = recv.Feed(frame.data(), frame.data() + frame.size());
+    REQUIRE(packets.size() == 1);
+    REQUIRE(packets[0].transform == views[0].DecodeTransform());
+}
+
+TEST_CASE("Batch frame") {
+    std::vector<Packet> packets(100);
+    for (int i = 0; i < 100; i++) {
+        packets[i].type = Mesh::Type::Points;
+        packets[i].data.name = "points" + std::to_string(i);
+        packets[i].data.positions = {Vec3(i, 0, 1)};
+        packets[i].data.color = Vec3(0.2, 0.5, 0.7);
+    }
+    packets[7].opcode = Opcode::Append;
+
+    std::vector<uint8_t> payload;
+    Batch::SerializeTo(payload, packets.data(), packets.size());
+    auto frame = MakeFrame(Opcode::Batch, payload);
+
+    SECTION("decoded in one pass") {
+        NetRecv recv(nullptr);
+        auto decoded = recv.Feed(frame.data(), frame.data() + frame.size());
+        REQUIRE(decoded.size() == 100);
+        REQUIRE(decoded[7].opcode == Opcode::Append);
+        REQUIRE(decoded[99].data.name == "points99");
+        REQUIRE(decoded[99].data.positions[0] == Vec3(99, 1, 0));
+    }
+
+    SECTION("cut short") {
+        std::vector<PacketView> views;
+        REQUIRE_FALSE(Batch::Parse(payload.data(), payload.data() + payload.size() - 1, views));
+        REQUIRE(views.size() == 99);
+        REQUIRE(views[98].name == "points98");
+    }
+}
+
+TEST_CASE("Packet view") {
+    Packet packet;
+    packet.type = Mesh::Type::LineStrip;
+    packet.data.name = "view";
+    packet.data.color = Vec3(1, 0.5, 0);
+    packet.data.positions = {Vec3(1, 2, 3), Vec3(4, 5, 6)};
+
+    for (auto encoding : {PositionEncoding::Float64, PositionEncoding::Float32}) {
+        packet.encoding = encoding;
+        auto buf = packet.Serialize();
+        auto view = PacketView::Parse(buf.data(), buf.data() + buf.size());
+        REQUIRE(view);
+        REQUIRE(view->type == Mesh::Type::LineStrip);
+        REQUIRE(view->name == "view");
+        REQUIRE(view->color == Vec3(1, 0.5, 0));
+        REQUIRE(view->count == 2);
+
+        // straight into vertex storage, in viewer coordinates
+        std::vector<Vertex> vertices(view->count);
+        view->DecodeTo(vertices.data());
+        REQUIRE(vertices[0].position == Vec3(1, 3, 2));
+        REQUIRE(vertices[1].position == Vec3(4, 6, 5));
+
+        // a count bigger than the payload is clamped, a missing color is an error
+        REQUIRE_FALSE(PacketView::Parse(buf.data(), buf.data() + buf.size() - 4 - 24));
+    }
+}
+
+TEST_CASE("Position decode kernels") {
+    std::vector<DecodeKernel> kernels = {DecodeKernel::Scalar};
+    if (BestDecodeKernel() != DecodeKernel::Scalar) {
+        kernels.push_back(DecodeKernel::SSE2);
+    }
+    if (BestDecodeKernel() == DecodeKernel::AVX2) {
+        kernels.push_back(DecodeKernel::AVX2);
+    }
+
+    // odd counts leave a tail for the scalar loop, the offset makes the source unaligned
+    for (size_t count : {0, 1, 3, 4, 7, 8, 1003}) {
+        std::vector<double> doubles(count * 3);
+        std::vector<float> floats(count * 3);
+        for (size_t i = 0; i < doubles.size(); i++) {
+            doubles[i] = i * 0.25 - 7.0;
+            floats[i] = static_cast<float>(doubles[i]);
+        }
+        std::vector<uint8_t> src64(1 + doubles.size() * sizeof(double));
+        std::vector<uint8_t> src32(1 + floats.size() * sizeof(float));
+        memcpy(src64.data() + 1, doubles.data(), doubles.size() * sizeof(double));
+        memcpy(src32.data() + 1, floats.data(), floats.size() * sizeof(float));
+
+        for (auto kernel : kernels) {
+            for (bool swap : {false, true}) {
+                std::vector<float> expected(floats);
+                if (swap) {
+                    for (size_t i = 0; i < count; i++) {
+                        std::swap(expected[i * 3 + 1], expected[i * 3 + 2]);
+                    }
+                }
+                std::vector<float> out(count * 3 + 1, -1.0f);
+                DecodeFloat64Positions(src64.data() + 1, count, swap, out.data(), kernel);
+                REQUIRE(out.back() == -1.0f);
+                out.pop_back();
+                REQUIRE(out == expected);
+
+                out.assign(count * 3, -1.0f);
+                DecodeFloat32Positions(src32.data() + 1, count, swap, out.data(), kernel);
+                REQUIRE(out == expected);
+            }
+        }
+    }
+}
+
+TEST_CASE("Vertex attributes") {
+    Packet packet;
+    packet.type = Mesh::Type::Triangles;
+    packet.data.name = "quad";
+    packet.data.color = Vec3(1, 1, 1);
+    packet.data.positions = {Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(1, 1, 0), Vec3(0, 1, 0)};
+    packet.data.colors = {Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1), Vec3(1, 1, 1)};
+    packet.data.normals.assign(4, Vec3(0, 0, 1));
+    packet.data.indices = {0, 1, 2, 0, 2, 3};
+
+    SECTION("round trip with u16 indices") {
+        auto buf = packet.Serialize();
+        REQUIRE(buf.size() == 2 + 4 + 4 * 24 + 4 * 3 + 4 * 12 + 4 + 6 * 2 + 24 + 4);
+        auto view = PacketView::Parse(buf.data(), buf.data() + buf.size());
+        REQUIRE(view);
+        REQUIRE(view->type == Mesh::Type::Triangles);
+        REQUIRE(view->indexCount == 6);
+        REQUIRE(view->name == "quad");
+
+        auto depacket = view->ToPacket(false);
+        REQUIRE(depacket.data.positions == packet.data.positions);
+        REQUIRE(depacket.data.colors == packet.data.colors);
+        REQUIRE(depacket.data.normals == packet.data.normals);
+        REQUIRE(depacket.data.indices == packet.data.indices);
+
+        // normals turn into viewer coordinates like the positions
+        std::vector<Vec3> normals(4);
+        view->DecodeNormalsTo(normals.data());
+        REQUIRE(normals[0] == Vec3(0, 1, 0));
+
+        std::vector<uint32_t> indices(6);
+        REQUIRE(view->DecodeIndicesTo(indices.data(), 10, 14));
+        REQUIRE(indices[5] == 13);
+        REQUIRE_FALSE(view->DecodeIndicesTo(indices.data(), 0, 3));
+
+        REQUIRE_FALSE(PacketView::Parse(buf.data(), buf.data() + 2 + 4 + 4 * 24 + 10));
+    }
+
+    SECTION("u32 indices past 65536 vertices") {
+        packet.encoding = PositionEncoding::Float32;
+        packet.data.positions.resize(70000, Vec3(2, 2, 2));
+        packet.data.colors.clear();
+        packet.data.normals.clear();
+        packet.data.indices.push_back(69999);
+        auto buf = packet.Serialize();
+        auto depacket = Packet::Deserialize(buf.data(), buf.data() + buf.size());
+        REQUIRE(depacket);
+        REQUIRE(depacket->data.colors.empty());
+        REQUIRE(depacket->data.indices.back() == 69999);
+    }
+
+    SECTION("an index past u16 isn't narrowed") {
+        packet.data.indices.push_back(65536);
+        auto buf = packet.Serialize();
+        auto view = PacketView::Parse(buf.data(), buf.data() + buf.size());
+        REQUIRE(view);
+        REQUIRE(view->attributes & Packet::AttrIndices32);
+        std::vector<uint32_t> indices(7);
+        REQUIRE_FALSE(view->DecodeIndicesTo(indices.data(), 0, 4));
+    }
+
+    SECTION("plain packets keep the old layout") {
+        packet.data.colors.clear();
+        packet.data.normals.clear();
+        packet.data.indices.clear();
+        auto buf = packet.Serialize();
+        REQUIRE(buf[0] == Mesh::Type::Triangles);
+        REQUIRE(buf.size() == 1 + 4 + 4 * 24 + 24 + 4);
+    }
+}
@@ -0,0 +1,623 @@
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "scene.hpp"
+#include <filesystem>
+#include <thread>
+
+namespace {
+
+SceneCommand commandOf(SceneCommand::Kind kind, uint32_t id, std::vector<Vertex> vertices) {
+    SceneCommand command;
+    command.kind = kind;
+    command.id = id;
+    command.name = "scene/object";
+    command.mesh = Mesh::Create(Mesh::Type::Lines, std::move(vertices));
+    command.color = glm::vec3(1, 0, 0);
+    return command;
+}
+
+std::string cacheDirectory() {
+    return std::filesystem::temp_directory_path().string();
+}
+
+}
+
+TEST_CASE("Scene commands") {
+    Scene scene;
+    auto mesh = commandOf(SceneCommand::Kind::Mesh, 2, {Vertex{glm::vec3(0)}, Vertex{glm::vec3(1)}});
+    scene.Apply(mesh);
+    REQUIRE(scene.Objects().size() == 1);
+    REQUIRE(scene.Get(scene.Find(0)) == nullptr);
+    auto* data = scene.Get(scene.Find(2));
+    REQUIRE(data);
+    REQUIRE(data->id == 2);
+    REQUIRE(data->mesh->vertices.size() == 2);
+
+    SECTION("appended indices are relative to the appended vertices") {
+        auto append = commandOf(SceneCommand::Kind::Append, 2, {Vertex{glm::vec3(2)}, Vertex{glm::vec3(3)}});
+        append.mesh.indices = std::vector<uint32_t>{0, 1};
+        scene.Apply(append);
+        REQUIRE(data->mesh->vertices.size() == 4);
+        REQUIRE(data->mesh->vertices[3].position == glm::vec3(3));
+        REQUIRE(data->mesh->indices.value() == std::vector<uint32_t>{2, 3});
+    }
+
+    SECTION("replace past the end is dropped") {
+        auto replace = commandOf(SceneCommand::Kind::Replace, 2, {Vertex{glm::vec3(5)}});
+        replace.offset = 3;
+        scene.Apply(replace);
+        REQUIRE(data->mesh->vertices.size() == 2);
+        replace.offset = 1;
+        scene.Apply(replace);
+        REQUIRE(data->mesh->vertices[1].position == glm::vec3(5));
+    }
+
+    SECTION("a new mesh keeps the transform") {
+        SceneCommand move;
+        move.kind = SceneCommand::Kind::Transform;
+        move.id = 2;
+        move.transform = glm::translate(glm::mat4(1.0f), glm::vec3(1, 2, 3));
+        scene.Apply(move);
+        auto again = commandOf(SceneCommand::Kind::Mesh, 2, {Vertex{glm::vec3(7)}});
+        scene.Apply(again);
+        REQUIRE(data->mesh->vertices.size() == 1);
+        REQUIRE(data->transform == move.transform);
+    }
+
+    SECTION("remove") {
+        auto other = commandOf(SceneCommand::Kind::Mesh, 5, {});
+        scene.Apply(other);
+        auto handle = scene.Find(2);
+        SceneCommand remove;
+        remove.kind = SceneCommand::Kind::Remove;
+        remove.id = 2;
+        scene.Apply(remove);
+        REQUIRE(scene.Objects().size() == 1);
+        REQUIRE(scene.Objects()[0].id == 5);
+        REQUIRE(scene.Get(handle) == nullptr);
+        REQUIRE(scene.Get(scene.Find(2)) == nullptr);
+
+        // the name comes back as a new object
+        scene.Apply(mesh);
+        REQUIRE(scene.Find(2) != handle);
+        REQUIRE(scene.Get(scene.Find(2))->id == 2);
+    }
+
+    SECTION("clear") {
+        auto handle = scene.Find(2);
+        SceneCommand clear;
+        clear.kind = SceneCommand::Kind::Clear;
+        scene.Apply(clear);
+        REQUIRE(scene.Objects().empty());
+        REQUIRE(scene.Get(handle) == nullptr);
+    }
+}
+
+TEST_CASE("Command from a packet") {
+    Packet packet;
+    packet.opcode = Opcode::Append;
+    packet.type = Mesh::Type::Triangles;
+    packet.data.name = "scene/packet";
+    packet.data.positions = {Vec3(1, 2, 3), Vec3(4, 5, 6), Vec3(7, 8, 9)};
+    packet.data.indices = {0, 1, 3};
+    auto buf = packet.Serialize();
+    auto view = PacketView::Parse(buf.data(), buf.data() + buf.size(), Opcode::Append);
+    REQUIRE(view);
+
+    // a bad index only drops the indices of a range, the whole of a mesh
+    auto command = SceneCommand::FromPacket(view.value());
+    REQUIRE(command);
+    REQUIRE(command->kind == SceneCommand::Kind::Append);
+    REQUIRE(command->name == "scene/packet");
+    REQUIRE(command->id == NameTable::Instance().Intern("scene/packet"));
+    REQUIRE(command->mesh.vertices[1].position == glm::vec3(4, 6, 5));
+    REQUIRE_FALSE(command->mesh.indices);
+
+    view->opcode = Opcode::Mesh;
+    REQUIRE_FALSE(SceneCommand::FromPacket(view.value()));
+}
+
+TEST_CASE("Scene queue") {
+    Scene scene;
+    SceneQueue queue(64);
+
+    SECTION("each producer's commands are applied in order") {
+        const uint32_t producers = 4;
+        const int count = 2000;
+        std::vector<std::thread> threads;
+        for (uint32_t p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, p]() {
+                queue.Push(commandOf(SceneCommand::Kind::Mesh, p, {}));
+                for (int i = 0; i < count; i++) {
+                    queue.Push(commandOf(SceneCommand::Kind::Append, p, {Vertex{glm::vec3(i)}}));
+                }
+            });
+        }
+        // the queue holds 64, the producers wait on the drain
+        size_t applied = 0;
+        while (applied < producers * (count + 1)) {
+            applied += queue.Drain(scene, std::chrono::milliseconds(1));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        REQUIRE(scene.Objects().size() == producers);
+        for (const auto& data : scene.Objects()) {
+            REQUIRE(data.mesh->vertices.size() == count);
+            bool ordered = true;
+            for (int i = 0; i < count; i++) {
+                ordered &= data.mesh->vertices[i].position.x == i;
+            }
+            REQUIRE(ordered);
+        }
+        auto stats = queue.Stats();
+        REQUIRE(stats.depth == 0);
+        REQUIRE(stats.applied == producers * (count + 1));
+        REQUIRE(stats.maxLatencyMs >= stats.avgLatencyMs);
+    }
+
+    SECTION("the budget leaves the rest for the next frame") {
+        for (int i = 0; i < 10; i++) {
+            queue.Push(commandOf(SceneCommand::Kind::Mesh, i, {}));
+        }
+        REQUIRE(queue.Stats().depth == 10);
+        // always at least one, so the queue can't stall
+        REQUIRE(queue.Drain(scene, std::chrono::seconds(0)) == 1);
+        REQUIRE(queue.Stats().depth == 9);
+        REQUIRE(queue.Drain(scene, std::chrono::seconds(1)) == 9);
+        REQUIRE(scene.Objects().size() == 10);
+    }
+
+    SECTION("closing lets a producer waiting for room give up") {
+        for (int i = 0; i < 64; i++) {
+            REQUIRE(queue.Push(commandOf(SceneCommand::Kind::Mesh, i, {})));
+        }
+        bool pushed = true;
+        std::thread producer([&queue, &pushed]() {
+            pushed = queue.Push(commandOf(SceneCommand::Kind::Mesh, 64, {}));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.Close();
+        producer.join();
+        REQUIRE_FALSE(pushed);
+        REQUIRE_FALSE(queue.Push(commandOf(SceneCommand::Kind::Mesh, 65, {})));
+        REQUIRE(queue.Stats().depth == 64);
+    }
+
+    SECTION("the UI's posts don't wait for room and go first") {
+        for (int i = 0; i < 64; i++) {
+            REQUIRE(queue.Push(commandOf(SceneCommand::Kind::Mesh, i, {})));
+        }
+        REQUIRE(queue.Post(commandOf(SceneCommand::Kind::Mesh, 64, {})));
+        REQUIRE(queue.Stats().depth == 65);
+        REQUIRE(queue.Drain(scene, std::chrono::seconds(0)) == 1);
+        REQUIRE(scene.Get(scene.Find(64)));
+        REQUIRE_FALSE(scene.Get(scene.Find(0)));
+        REQUIRE(queue.Drain(scene, std::chrono::seconds(1)) == 64);
+
+        queue.Close();
+        REQUIRE_FALSE(queue.Post(commandOf(SceneCommand::Kind::Mesh, 65, {})));
+    }
+}
+
+TEST_CASE("Scene snapshots") {
+    Scene scene;
+    REQUIRE(scene.Latest()->groups.size() == 1);
+    REQUIRE(scene.Latest()->objects.empty());
+
+    auto mesh = commandOf(SceneCommand::Kind::Mesh, 0, {Vertex{glm::vec3(1)}});
+    scene.Apply(mesh);
+    auto other = commandOf(SceneCommand::Kind::Mesh, 1, {Vertex{glm::vec3(2)}});
+    other.name = "scene/group/other";
+    scene.Apply(other);
+    scene.Publish();
+    auto first = scene.Latest();
+    REQUIRE(scene.LatestTaken());
+
+    // root, "scene", "scene/group", each group's own objects in a row
+    REQUIRE(first->groups.size() == 3);
+    REQUIRE(first->groups[0].end == 3);
+    REQUIRE(first->groups[1].path == "scene");
+    REQUIRE(first->groups[2].path == "scene/group");
+    REQUIRE(first->groups[2].name == "group");
+    REQUIRE(first->objects[first->groups[1].objectBegin]->id == 0);
+    REQUIRE(first->objects[first->groups[2].objectBegin]->id == 1);
+    REQUIRE(first->groups[0].bounds.max == glm::vec3(2));
+
+    SECTION("a snapshot doesn't change, the next one shares what didn't") {
+        auto append = commandOf(SceneCommand::Kind::Append, 0, {Vertex{glm::vec3(3)}});
+        scene.Apply(append);
+        SceneCommand select;
+        select.kind = SceneCommand::Kind::Select;
+        select.id = 1;
+        scene.Apply(select);
+        REQUIRE(first->Find(0)->mesh.vertexCount == 1);
+        REQUIRE_FALSE(first->Find(1)->selected);
+
+        scene.Publish();
+        REQUIRE_FALSE(scene.LatestTaken());
+        auto second = scene.Latest();
+        REQUIRE(second->Find(0)->mesh.vertexCount == 2);
+        REQUIRE(second->Find(1)->selected);
+        // selecting doesn't copy the vertices
+        REQUIRE(second->Find(1)->storage == first->Find(1)->storage);
+
+        auto move = commandOf(SceneCommand::Kind::Transform, 1, {});
+        move.transform = glm::translate(glm::mat4(1.0f), glm::vec3(1, 0, 0));
+        scene.Apply(move);
+        scene.Publish();
+        auto third = scene.Latest();
+        REQUIRE(third->Find(0) == second->Find(0));
+        REQUIRE(third->Find(1)->storage == second->Find(1)->storage);
+        REQUIRE(third->groups[0].bounds.max == glm::vec3(3, 3, 3));
+    }
+
+    SECTION("appends after a publish write past what it shows") {
+        // the first one copies the mesh with room to spare
+        auto append = commandOf(SceneCommand::Kind::Append, 0, {Vertex{glm::vec3(1)}});
+        scene.Apply(append);
+        const auto& vertices = scene.Get(scene.Find(0))->mesh->vertices;
+        const Vertex* storage = vertices.data();
+        REQUIRE(vertices.capacity() > vertices.size());
+
+        std::vector<std::shared_ptr<const SceneSnapshot>> snapshots;
+        while (vertices.size() < vertices.capacity()) {
+            scene.Publish();
+            snapshots.push_back(scene.Latest());
+            append = commandOf(SceneCommand::Kind::Append, 0, {Vertex{glm::vec3(vertices.size())}});
+            scene.Apply(append);
+            REQUIRE(scene.Get(scene.Find(0))->mesh->vertices.data() == storage);
+        }
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            REQUIRE(snapshots[i]->Find(0)->mesh.vertexCount == i + 2);
+            REQUIRE(snapshots[i]->Find(0)->storage == snapshots[0]->Find(0)->storage);
+        }
+
+        // overwriting what a snapshot shows copies
+        auto replace = commandOf(SceneCommand::Kind::Replace, 0, {Vertex{glm::vec3(7)}});
+        scene.Apply(replace);
+        REQUIRE(scene.Get(scene.Find(0))->mesh->vertices.data() != storage);
+        REQUIRE(snapshots[0]->Find(0)->mesh.vertices[0].position == glm::vec3(1));
+    }
+
+    SECTION("group edits") {
+        SceneCommand recolor;
+        recolor.kind = SceneCommand::Kind::RecolorGroup;
+        recolor.name = "scene/group";
+        recolor.color = glm::vec3(0, 0, 1);
+        scene.Apply(recolor);
+        SceneCommand remove;
+        remove.kind = SceneCommand::Kind::RemoveGroup;
+        remove.name = "scene/none";
+        scene.Apply(remove);
+        scene.Publish();
+        REQUIRE(scene.Latest()->Find(1)->color == glm::vec3(0, 0, 1));
+        REQUIRE(scene.Latest()->Find(0)->color == glm::vec3(1, 0, 0));
+
+        remove.name = "scene/group";
+        scene.Apply(remove);
+        scene.Publish();
+        REQUIRE(scene.Latest()->groups.size() == 2);
+        REQUIRE_FALSE(scene.Latest()->Find(1));
+        // the old snapshot still has its names
+        REQUIRE(first->groups[2].path == "scene/group");
+    }
+}
+
+TEST_CASE("Scene thread") {
+    Scene scene;
+    SceneQueue queue(64);
+    queue.Start(scene, std::chrono::milliseconds(1));
+
+    const uint32_t producers = 4;
+    const int count = 500;
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++) {
+        threads.emplace_back([&queue, p]() {
+            queue.Push(commandOf(SceneCommand::Kind::Mesh, p, {}));
+            for (int i = 0; i < count; i++) {
+                queue.Push(commandOf(SceneCommand::Kind::Append, p, {Vertex{glm::vec3(i)}}));
+            }
+        });
+    }
+
+    // whatever snapshot the reader gets, each object is a prefix of what was pushed
+    bool consistent = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    size_t done = 0;
+    while (done < producers && std::chrono::steady_clock::now() < deadline) {
+        auto snapshot = scene.Latest();
+        done = 0;
+        for (const auto& object : snapshot->objects) {
+            const auto& mesh = object->mesh;
+            for (size_t i = 0; i < mesh.vertexCount; i++) {
+                consistent &= mesh.vertices[i].position.x == i;
+            }
+            done += mesh.vertexCount == count;
+        }
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    queue.Stop();
+    REQUIRE(consistent);
+    REQUIRE(done == producers);
+    REQUIRE_FALSE(queue.Push(commandOf(SceneCommand::Kind::Mesh, 9, {})));
+}
+
+TEST_CASE("Scene thread publishes once it runs out of work") {
+    Scene scene;
+    SceneQueue queue(64);
+    queue.Start(scene, std::chrono::milliseconds(1));
+
+    // nobody takes a snapshot meanwhile, the last one would never be published otherwise
+    for (uint32_t i = 0; i < 10; i++) {
+        REQUIRE(queue.Push(commandOf(SceneCommand::Kind::Mesh, i, {})));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (queue.Stats().applied < 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    REQUIRE(scene.Latest()->objects.size() == 10);
+
+    // and a post wakes it up
+    REQUIRE(queue.Post(commandOf(SceneCommand::Kind::Remove, 0, {})));
+    while (scene.Latest()->objects.size() != 9 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(scene.Latest()->objects.size() == 9);
+    queue.Stop();
+}
+
+TEST_CASE("Scene cache") {
+    std::string path;
+    {
+        SceneCache cache(cacheDirectory(), "scene_test-");
+        path = cache.Path();
+        REQUIRE(std::filesystem::path(path).filename().string().rfind("scene_test-", 0) == 0);
+        // a random name nobody else can open
+        REQUIRE(std::filesystem::exists(path));
+        auto others = std::filesystem::perms::group_all | std::filesystem::perms::others_all;
+        REQUIRE((std::filesystem::status(path).permissions() & others) == std::filesystem::perms::none);
+        REQUIRE(SceneCache(cacheDirectory(), "scene_test-").Path() != path);
+
+        auto small = Mesh::Create(Mesh::Type::Lines, {Vertex{glm::vec3(1, 2, 3)}, Vertex{glm::vec3(4, 5, 6)}});
+        small.colors = std::vector<glm::vec3>{glm::vec3(1, 0, 0), glm::vec3(0, 1, 0)};
+        small.normals = std::vector<glm::vec3>{glm::vec3(0, 0, 1)};   // doesn't match, not kept
+        // big enough to be compressed
+        std::vector<Vertex> vertices(20000, Vertex{glm::vec3(7)});
+        std::vector<uint32_t> indices(30000, 1);
+        auto big = Mesh::CreateWithIndices(Mesh::Type::Triangles, vertices, indices);
+
+        auto smallEntry = cache.Spill(small);
+        auto bigEntry = cache.Spill(big);
+        REQUIRE(smallEntry);
+        REQUIRE(bigEntry);
+        REQUIRE(bigEntry->size < big.UploadBytes());
+        REQUIRE(cache.LiveBytes() == smallEntry->size + bigEntry->size);
+
+        auto restored = cache.Restore(bigEntry.value());
+        REQUIRE(restored);
+        REQUIRE(restored->type == Mesh::Type::Triangles);
+        REQUIRE(restored->vertices.size() == vertices.size());
+        REQUIRE(restored->vertices.back().position == glm::vec3(7));
+        REQUIRE(restored->indices.value() == indices);
+        REQUIRE(cache.LiveBytes() == smallEntry->size);
+
+        restored = cache.Restore(smallEntry.value());
+        REQUIRE(restored);
+        REQUIRE(restored->vertices[1].position == glm::vec3(4, 5, 6));
+        REQUIRE(restored->colors.value() == small.colors.value());
+        REQUIRE_FALSE(restored->normals);
+        REQUIRE_FALSE(restored->indices);
+        // nothing live, the file starts over
+        REQUIRE(cache.FileBytes() == 0);
+
+        SECTION("compaction") {
+            auto first = cache.Spill(small);
+            bigEntry = cache.Spill(big);
+            auto last = cache.Spill(small);
+            REQUIRE_FALSE(cache.NeedsCompaction());
+            cache.Drop(bigEntry.value());
+            REQUIRE(cache.NeedsCompaction());
+
+            REQUIRE(cache.Compact({&first.value(), &last.value()}));
+            REQUIRE(cache.FileBytes() == first->size + last->size);
+            REQUIRE(std::filesystem::file_size(path) == cache.FileBytes());
+            REQUIRE(last->offset == first->size);
+            REQUIRE_FALSE(cache.NeedsCompaction());
+            restored = cache.Restore(last.value());
+            REQUIRE(restored);
+            REQUIRE(restored->vertices[1].position == glm::vec3(4, 5, 6));
+        }
+    }
+    REQUIRE_FALSE(std::filesystem::exists(path));
+}
+
+TEST_CASE("Memory budget") {
+    Scene scene;
+    std::vector<Vertex> vertices(1000, Vertex{glm::vec3(1)});
+    for (uint32_t i = 0; i < 4; i++) {
+        auto command = commandOf(SceneCommand::Kind::Mesh, i, vertices);
+        scene.Apply(command);
+    }
+    const size_t objectBytes = sizeof(RenderData) + vertices.size() * sizeof(Vertex);
+    REQUIRE(scene.Objects()[0].cpuBytes == objectBytes);
+    REQUIRE(scene.Objects()[0].gpuBytes == vertices.size() * sizeof(Vertex));
+    REQUIRE(scene.Memory().cpuBytes == 4 * objectBytes);
+    REQUIRE(scene.Memory().gpuBytes == 4 * vertices.size() * sizeof(Vertex));
+
+    // room for 3, evicted down to 3/4 of that
+    scene.SetMemoryBudget(3 * objectBytes, cacheDirectory());
+    auto memory = scene.Memory();
+    REQUIRE(memory.cpuBytes <= 3 * objectBytes / 4 * 3);
+    REQUIRE(memory.spilled == 2);
+    REQUIRE(memory.cacheBytes > 0);
+    // the least recently updated went first
+    REQUIRE(scene.Get(scene.Find(0))->spilled);
+    REQUIRE(scene.Get(scene.Find(1))->spilled);
+    REQUIRE(scene.Get(scene.Find(0))->mesh->vertices.empty());
+    REQUIRE(scene.Get(scene.Find(0))->gpuBytes == 0);
+    REQUIRE_FALSE(scene.Get(scene.Find(3))->spilled);
+
+    SECTION("an update reads the mesh back first") {
+        auto append = commandOf(SceneCommand::Kind::Append, 0, {Vertex{glm::vec3(2)}});
+        scene.Apply(append);
+        auto* data = scene.Get(scene.Find(0));
+        REQUIRE_FALSE(data->spilled);
+        REQUIRE(data->mesh->vertices.size() == vertices.size() + 1);
+        REQUIRE(data->mesh->vertices.back().position == glm::vec3(2));
+        // and something older makes room for it
+        REQUIRE(scene.Get(scene.Find(2))->spilled);
+        REQUIRE(scene.Memory().cpuBytes <= 3 * objectBytes);
+    }
+
+    SECTION("restore") {
+        auto* data = scene.Get(scene.Find(1));
+        REQUIRE(scene.Restore(*data));
+        REQUIRE(data->mesh->vertices.size() == vertices.size());
+        REQUIRE(data->gpuBytes == vertices.size() * sizeof(Vertex));
+
+        // what was looked at stays while the others make room, until it's updated again
+        SceneCommand restore;
+        restore.kind = SceneCommand::Kind::Restore;
+        restore.id = 0;
+        scene.Apply(restore);
+        auto another = commandOf(SceneCommand::Kind::Mesh, 4, vertices);
+        scene.Apply(another);
+        REQUIRE_FALSE(scene.Get(scene.Find(0))->spilled);
+        REQUIRE_FALSE(scene.Get(scene.Find(1))->spilled);
+        REQUIRE(scene.Get(scene.Find(2))->spilled);
+
+        auto append = commandOf(SceneCommand::Kind::Append, 1, {Vertex{glm::vec3(2)}});
+        scene.Apply(append);
+        REQUIRE_FALSE(scene.Get(scene.Find(1))->pinned);
+    }
+
+    SECTION("removing drops the spilled mesh") {
+        SceneCommand remove;
+        remove.kind = SceneCommand::Kind::Remove;
+        remove.id = 0;
+        scene.Apply(remove);
+        REQUIRE(scene.Memory().spilled == 1);
+        SceneCommand clear;
+        clear.kind = SceneCommand::Kind::Clear;
+        scene.Apply(clear);
+        memory = scene.Memory();
+        REQUIRE(memory.spilled == 0);
+        REQUIRE(memory.cacheBytes == 0);
+        REQUIRE(memory.cpuBytes == 0);
+    }
+}
+
+TEST_CASE("Name groups") {
+    Scene scene;
+    auto add = [&scene](uint32_t id, std::string_view name, glm::vec3 position) {
+        auto command = commandOf(SceneCommand::Kind::Mesh, id, {Vertex{position}});
+        command.name = name;
+        scene.Apply(command);
+    };
+    add(0, "solver/iter12/contacts", glm::vec3(1, 0, 0));
+    add(1, "solver/iter12/forces", glm::vec3(2, 0, 0));
+    add(2, "solver/iter13/contacts", glm::vec3(0, 5, 0));
+    add(3, "body", glm::vec3(0, 0, -3));
+
+    auto& root = scene.Root();
+    REQUIRE(root.objects.size() == 1);
+    REQUIRE(root.children.size() == 1);
+    auto* iter12 = scene.FindGroup("solver/iter12");
+    REQUIRE(iter12);
+    REQUIRE(iter12->path == "solver/iter12");
+    REQUIRE(iter12->objects.size() == 2);
+    REQUIRE(scene.Get(scene.Find(0))->group == iter12);
+    REQUIRE(scene.FindGroup("") == &root);
+    REQUIRE_FALSE(scene.FindGroup("solver/iter14"));
+
+    auto& bounds = scene.BoundsOf(root);
+    REQUIRE(bounds.min == glm::vec3(0, 0, -3));
+    REQUIRE(bounds.max == glm::vec3(2, 5, 0));
+
+    SECTION("bounds follow changes below") {
+        auto append = commandOf(SceneCommand::Kind::Append, 1, {Vertex{glm::vec3(2, -1, 0)}});
+        append.name = "solver/iter12/forces";
+        scene.Apply(append);
+        REQUIRE(scene.BoundsOf(*iter12).min == glm::vec3(1, -1, 0));
+
+        SceneCommand move;
+        move.kind = SceneCommand::Kind::Transform;
+        move.id = 2;
+        move.transform = glm::translate(glm::mat4(1.0f), glm::vec3(10, 0, 0));
+        scene.Apply(move);
+        REQUIRE(scene.BoundsOf(root).max == glm::vec3(10, 5, 0));
+    }
+
+    SECTION("remove a group") {
+        scene.RemoveGroup(*scene.FindGroup("solver/iter12"));
+        REQUIRE(scene.Objects().size() == 2);
+        REQUIRE(scene.Get(scene.Find(0)) == nullptr);
+        REQUIRE_FALSE(scene.FindGroup("solver/iter12"));
+        REQUIRE(scene.FindGroup("solver/iter13"));
+        REQUIRE(scene.BoundsOf(root).max == glm::vec3(0, 5, 0));
+
+        // the last object of a group takes the group with it
+        SceneCommand remove;
+        remove.kind = SceneCommand::Kind::Remove;
+        remove.id = 2;
+        scene.Apply(remove);
+        REQUIRE(root.children.empty());
+        REQUIRE(scene.Memory().cpuBytes == scene.Get(scene.Find(3))->cpuBytes);
+    }
+
+    SECTION("remove an object in the middle of its group") {
+        add(4, "solver/iter12/velocities", glm::vec3(0));
+        SceneCommand remove;
+        remove.kind = SceneCommand::Kind::Remove;
+        remove.id = 0;
+        scene.Apply(remove);
+        REQUIRE(iter12->objects.size() == 2);
+        for (uint32_t i = 0; i < iter12->objects.size(); i++) {
+            REQUIRE(scene.Get(iter12->objects[i])->groupIndex == i);
+        }
+    }
+
+    SECTION("recolor") {
+        scene.RecolorGroup(*scene.FindGroup("solver"), glm::vec3(0, 0, 1));
+        REQUIRE(scene.Get(scene.Find(0))->color == glm::vec3(0, 0, 1));
+        REQUIRE(scene.Get(scene.Find(2))->color == glm::vec3(0, 0, 1));
+        REQUIRE(scene.Get(scene.Find(3))->color == glm::vec3(1, 0, 0));
+    }
+
+    SECTION("hidden and culled groups aren't visited") {
+        auto visible = [&scene](const glm::mat4& clip) {
+            std::vector<uint32_t> ids;
+            scene.Publish();
+            scene.Latest()->ForEachVisible(clip, [&ids](const SceneSnapshot::Object& data) { ids.push_back(data.id); });
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        // (0, 5, 0) is outside of -1 <= x, y, z <= 1
+        auto clip = glm::scale(glm::mat4(1.0f), glm::vec3(0.25f));
+        REQUIRE(visible(clip) == std::vector<uint32_t>{0, 1, 3});
+        SceneCommand hide;
+        hide.kind = SceneCommand::Kind::HideGroup;
+        hide.name = "solver/iter12";
+        scene.Apply(hide);
+        REQUIRE(visible(clip) == std::vector<uint32_t>{3});
+        hide.kind = SceneCommand::Kind::ShowGroup;
+        scene.Apply(hide);
+        REQUIRE(visible(glm::translate(glm::mat4(1.0f), glm::vec3(2.5, 0, 0))).empty());
+        // one object of a group in view
+        REQUIRE(visible(glm::translate(glm::mat4(1.0f), glm::vec3(-2.5, 0, 0))) == std::vector<uint32_t>{1});
+    }
+
+    SECTION("clear") {
+        SceneCommand clear;
+        clear.kind = SceneCommand::Kind::Clear;
+        scene.Apply(clear);
+        REQUIRE(root.children.empty());
+        REQUIRE(root.objects.empty());
+        REQUIRE(scene.Memory().cpuBytes == 0);
+    }
+}
@@ -0,0 +1,266 @@
+// generated record codecs(`wire::Schema`, `wire::Reader`) against the hand-written
+// pointer arithmetic they replaced, in M records/s.
+// usage: schema_bench [records]
+#include "pch.hpp"
+#include "netdata.hpp"
+#include <chrono>
+
+namespace handwritten {
+
+// the codecs as they were before the schemas, copied verbatim to compare against
+
+std::optional<FrameHeader> ReadHeader(const uint8_t* beg, const uint8_t* end) {
+    if (end - beg < static_cast<ptrdiff_t>(FrameHeader::Size)) {
+        return std::nullopt;
+    }
+    uint32_t magic;
+    memcpy(&magic, beg, 4);
+    if (magic != FrameHeader::Magic) {
+        return std::nullopt;
+    }
+    FrameHeader header;
+    header.version = beg[4];
+    header.opcode = static_cast<Opcode>(beg[5]);
+    memcpy(&header.flags, beg + 6, 2);
+    memcpy(&header.length, beg + 8, 4);
+    return header;
+}
+
+void WriteHeader(const FrameHeader& header, uint8_t* buf) {
+    uint32_t magic = FrameHeader::Magic;
+    memcpy(buf, &magic, 4);
+    buf[4] = header.version;
+    buf[5] = static_cast<uint8_t>(header.opcode);
+    memcpy(buf + 6, &header.flags, 2);
+    memcpy(buf + 8, &header.length, 4);
+}
+
+template <typename T>
+const uint8_t* readValue(const uint8_t* ptr, T& value) {
+    memcpy(&value, ptr, sizeof(T));
+    return ptr + sizeof(T);
+}
+
+size_t positionsSize(PositionEncoding encoding, size_t count) {
+    switch (encoding) {
+        case PositionEncoding::Float32: return count * sizeof(float) * 3;
+        case PositionEncoding::Quantized16: return sizeof(float) * 6 + count * sizeof(uint16_t) * 3;
+        default: return count * sizeof(double) * 3;
+    }
+}
+
+std::optional<PacketView> Parse(const uint8_t* beg, const uint8_t* end, Opcode opcode) {
+    const uint8_t* ptr = beg;
+    PacketView view;
+    view.opcode = opcode;
+    if (opcode == Opcode::Declare) {
+        if (end - ptr < 4) {
+            return std::nullopt;
+        }
+        ptr = readValue(ptr, view.nameId);
+        view.name = std::string_view(reinterpret_cast<const char*>(ptr), end - ptr);
+        return view;
+    }
+    if (opcode == Opcode::Replace) {
+        if (end - ptr < 4) {
+            return std::nullopt;
+        }
+        ptr = readValue(ptr, view.offset);
+    }
+    if (end - ptr < 5) {
+        return std::nullopt;
+    }
+    view.type = static_cast<Mesh::Type>(*ptr & 0x0F);
+    view.encoding = static_cast<PositionEncoding>((*ptr >> 4) & 0x03);
+    bool namedById = *ptr & 0x40;
+    if (view.encoding > PositionEncoding::Quantized16) {
+        return std::nullopt;
+    }
+    if (*ptr++ & 0x80) {
+        view.attributes = *ptr++;
+        if ((view.attributes & Packet::AttrIndices16) && (view.attributes & Packet::AttrIndices32)) {
+            return std::nullopt;
+        }
+        if (end - ptr < 4) {
+            return std::nullopt;
+        }
+    }
+    ptr = readValue(ptr, view.count);
+
+    // never trust `count` further than the payload goes
+    size_t fixed = positionsSize(view.encoding, 0);
+    size_t vertexSize = positionsSize(view.encoding, 1) - fixed;
+    if (static_cast<size_t>(end - ptr) < fixed) {
+        return std::nullopt;
+    }
+    size_t available = (end - ptr - fixed) / vertexSize;
+    if (view.attributes && view.count > available) {
+        // the attributes can't be found behind cut short positions
+        return std::nullopt;
+    }
+    view.count = std::min<size_t>(view.count, available);
+    view.positions = ptr;
+    ptr += positionsSize(view.encoding, view.count);
+
+    if (view.attributes & Packet::AttrColors) {
+        if (static_cast<size_t>(end - ptr) < view.count * 3ull) {
+            return std::nullopt;
+        }
+        view.colors = ptr;
+        ptr += view.count * 3ull;
+    }
+    if (view.attributes & Packet::AttrNormals) {
+        if (static_cast<size_t>(end - ptr) < view.count * sizeof(float) * 3) {
+            return std::nullopt;
+        }
+        view.normals = ptr;
+        ptr += view.count * sizeof(float) * 3;
+    }
+    if (view.attributes & (Packet::AttrIndices16 | Packet::AttrIndices32)) {
+        size_t indexSize = view.attributes & Packet::AttrIndices16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        if (end - ptr < 4) {
+            return std::nullopt;
+        }
+        ptr = readValue(ptr, view.indexCount);
+        if (static_cast<size_t>(end - ptr) / indexSize < view.indexCount) {
+            return std::nullopt;
+        }
+        view.indices = ptr;
+        ptr += view.indexCount * indexSize;
+    }
+
+    double color[3];
+    if (end - ptr < static_cast<ptrdiff_t>(sizeof(color))) {
+        return std::nullopt;
+    }
+    ptr = readValue(ptr, color);
+    view.color = Vec3(color[0], color[1], color[2]);
+    if (namedById) {
+        if (end - ptr < static_cast<ptrdiff_t>(sizeof(view.nameId))) {
+            return std::nullopt;
+        }
+        readValue(ptr, view.nameId);
+    } else {
+        view.name = std::string_view(reinterpret_cast<const char*>(ptr), end - ptr);
+    }
+    return view;
+}
+
+bool ParseBatch(const uint8_t* beg, const uint8_t* end, std::vector<PacketView>& views) {
+    if (end - beg < 4) {
+        return false;
+    }
+    uint32_t count = 0;
+    const uint8_t* ptr = readValue(beg, count);
+    views.reserve(views.size() + std::min<size_t>(count, (end - ptr) / 5));
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t opcode = 0;
+        uint32_t length = 0;
+        if (end - ptr < 5) {
+            return false;
+        }
+        ptr = readValue(ptr, opcode);
+        ptr = readValue(ptr, length);
+        if (length > static_cast<size_t>(end - ptr)) {
+            return false;
+        }
+
+        switch (static_cast<Opcode>(opcode)) {
+            case Opcode::Mesh:
+            case Opcode::Append:
+            case Opcode::Replace:
+            case Opcode::Declare:
+                if (auto view = Parse(ptr, ptr + length, static_cast<Opcode>(opcode)); view) {
+                    views.push_back(view.value());
+                }
+                break;
+            default:
+                LOGW("[NET]: unknown opcode ", (int)opcode, " in batch, record dropped");
+                break;
+        }
+        ptr += length;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc >= 2 ? std::atoll(argv[1]) : 100000;
+    const int rounds = 50;
+
+    // best of `rounds`, the two sides take turns so the machine's noise and clock drift hit both alike
+    auto measure = [&](auto&& hand, auto&& generated) {
+        hand();     // warm up
+        generated();
+        double best[2] = {1e30, 1e30};
+        auto time = [](auto&& work, double& best) {
+            auto begin = std::chrono::steady_clock::now();
+            work();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+        };
+        for (int i = 0; i < rounds; i++) {
+            time(hand, best[0]);
+            time(generated, best[1]);
+        }
+        return std::pair(count / best[0] / 1e6, count / best[1] / 1e6);
+    };
+    auto report = [](const char* name, double hand, double generated) {
+        printf("%-22s hand-written %8.1f M/s  generated %8.1f M/s  (%+.1f%%)\n", name, hand, generated,
+               (generated / hand - 1) * 100);
+    };
+
+    // frame headers back to back, like a stream of small frames
+    std::vector<uint8_t> headers(count * FrameHeader::Size);
+    uint64_t sink = 0;
+    auto [handWrite, genWrite] = measure([&]() {
+        for (size_t i = 0; i < count; i++) {
+            FrameHeader header;
+            header.length = i;
+            handwritten::WriteHeader(header, headers.data() + i * FrameHeader::Size);
+        }
+    }, [&]() {
+        for (size_t i = 0; i < count; i++) {
+            FrameHeader header;
+            header.length = i;
+            header.Write(headers.data() + i * FrameHeader::Size);
+        }
+    });
+    report("FrameHeader write", handWrite, genWrite);
+
+    const uint8_t* end = headers.data() + headers.size();
+    auto [handRead, genRead] = measure([&]() {
+        for (size_t i = 0; i < count; i++) {
+            sink += handwritten::ReadHeader(headers.data() + i * FrameHeader::Size, end)->length;
+        }
+    }, [&]() {
+        for (size_t i = 0; i < count; i++) {
+            sink += FrameHeader::Read(headers.data() + i * FrameHeader::Size, end)->length;
+        }
+    });
+    report("FrameHeader read", handRead, genRead);
+
+    // a batch of small meshes, record headers and packet fields dominate
+    std::vector<Packet> packets(count);
+    for (size_t i = 0; i < count; i++) {
+        packets[i].type = Mesh::Type::Lines;
+        packets[i].data.name = "marker" + std::to_string(i);
+        packets[i].data.positions = {Vec3(i, 0, 0), Vec3(i, 1, 0)};
+    }
+    std::vector<uint8_t> batch;
+    Batch::SerializeTo(batch, packets.data(), packets.size());
+    std::vector<PacketView> views;
+    views.reserve(count);
+    auto [handBatch, genBatch] = measure([&]() {
+        views.clear();
+        handwritten::ParseBatch(batch.data(), batch.data() + batch.size(), views);
+    }, [&]() {
+        views.clear();
+        Batch::Parse(batch.data(), batch.data() + batch.size(), views);
+    });
+    report("Batch parse", handBatch, genBatch);
+
+    printf("(%llu)\n", (unsigned long long)(sink & 1));
+    return 0;
+}
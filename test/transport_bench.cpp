@@ -0,0 +1,97 @@
+// small packet throughput over loopback TCP vs a Unix domain socket.
+// usage: transport_bench [packets] [vertices per packet] [poll|uring]
+#include "pch.hpp"
+#include "net.hpp"
+#include "netdata.hpp"
+#include "reactor.hpp"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+Reactor::Backend gBackend = Reactor::Backend::Poll;
+
+struct BenchResult {
+    double seconds;
+    uint64_t bytes;
+};
+
+BenchResult RunOnce(std::unique_ptr<net::Net>& net, net::Socket* listener, const Endpoint& endpoint,
+                    bool async, uint64_t count, size_t vertices) {
+    std::atomic<uint64_t> received = 0;
+    Reactor reactor([&](const std::vector<PacketView>& packets) {
+        received += packets.size();
+    }, 0, gBackend);
+    reactor.Listen(listener);
+    reactor.Start();
+
+    Packet packet;
+    packet.type = Mesh::Type::Points;
+    packet.data.name = "bench";
+    packet.data.color = Vec3(1, 0, 0);
+    packet.data.positions.resize(vertices, Vec3(1, 2, 3));
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t bytes;
+    {
+        // sync mode pays one syscall per packet, async mode coalesces them
+        auto sender = async ? std::make_unique<NetSender>(net, endpoint, NetSender::AsyncConfig{4096, NetSender::OverflowPolicy::Block})
+                            : std::make_unique<NetSender>(net, endpoint);
+        for (uint64_t i = 0; i < count; i++) {
+            sender->SendPacket(packet);
+        }
+        sender->Flush();
+        bytes = sender->Stats().sentBytes;
+
+        while (received < count) {
+            std::this_thread::yield();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    reactor.Stop();
+    return BenchResult{seconds, bytes};
+}
+
+void Report(const char* name, uint64_t count, const BenchResult& result) {
+    printf("%-12s %10.0f packets/s %8.1f MB/s (%.3f s)\n", name, count / result.seconds,
+           result.bytes / result.seconds / (1024.0 * 1024.0), result.seconds);
+}
+
+}
+
+int main(int argc, char** argv) {
+    const uint64_t count = argc >= 2 ? std::atoll(argv[1]) : 200000;
+    const size_t vertices = argc >= 3 ? std::atoi(argv[2]) : 4;
+    const uint32_t port = 9123;
+    if (argc >= 4 && std::string(argv[3]) == "uring") {
+        gBackend = Reactor::Backend::Uring;
+    }
+
+    auto net = net::Init();
+
+    auto tcpAddr = net::AddrInfoBuilder::CreateTCP("localhost", port).Build();
+    auto tcp = net->CreateSocket(tcpAddr.value, true);
+    if (tcp->Bind() == net::SocketError || tcp->Listen(SOMAXCONN) != 0) {
+        LOGE("listen on ", port, " failed: ", net::GetLastError());
+        return 1;
+    }
+    Report("tcp sync", count, RunOnce(net, tcp, Endpoint::Tcp("localhost", port), false, count, vertices));
+    Report("tcp async", count, RunOnce(net, tcp, Endpoint::Tcp("localhost", port), true, count, vertices));
+    tcp->Close();
+
+#ifndef _WIN32
+    const std::string path = "/tmp/visual_debugger_bench.sock";
+    auto unixAddr = net::AddrInfoBuilder::CreateUnix(path).Build();
+    auto unixSocket = net->CreateSocket(unixAddr.value, true);
+    if (unixSocket->Bind() == net::SocketError || unixSocket->Listen(SOMAXCONN) != 0) {
+        LOGE("listen on ", path, " failed: ", net::GetLastError());
+        return 1;
+    }
+    Report("unix sync", count, RunOnce(net, unixSocket, Endpoint::Unix(path), false, count, vertices));
+    Report("unix async", count, RunOnce(net, unixSocket, Endpoint::Unix(path), true, count, vertices));
+    unixSocket->Close();
+    unlink(path.c_str());
+#endif
+
+    return 0;
+}
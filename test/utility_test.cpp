@@ -1,6 +1,11 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "utility.hpp"
+#include "recv_buffer.hpp"
+#include "shm.hpp"
+#include "compress.hpp"
+#include "slot_map.hpp"
+#include <random>
 
 TEST_CASE("FindSubStr") {
     const char* str = "Hello1233321Worl00World";
@@ -9,4 +14,197 @@ TEST_CASE("FindSubStr") {
     REQUIRE(FindSubStr((uint8_t*)str, strlen(str), (uint8_t*)"World", 5) == (uint8_t*)str + 18);
     REQUIRE(FindSubStr((uint8_t*)str, strlen(str), (uint8_t*)"Worl", 4) ==  (uint8_t*)str + 12);
     REQUIRE(FindSubStr((uint8_t*)str, strlen(str), (uint8_t*)"Worldl", 6) == nullptr);
-}
\ No newline at end of file
+}
+
+TEST_CASE("RecvBuffer") {
+    RecvBuffer buffer(8);
+
+    buffer.Append((const uint8_t*)"12345", 5);
+    REQUIRE(buffer.Size() == 5);
+    buffer.Consume(3);
+    REQUIRE(memcmp(buffer.Data(), "45", 2) == 0);
+
+    // slides the unread bytes to the front instead of growing
+    uint8_t* ptr = buffer.Prepare(6);
+    REQUIRE(buffer.Capacity() == 8);
+    memcpy(ptr, "678901", 6);
+    buffer.Commit(6);
+    REQUIRE(memcmp(buffer.Data(), "45678901", 8) == 0);
+
+    // grows and keeps unread bytes contiguous
+    buffer.Append((const uint8_t*)"abc", 3);
+    REQUIRE(buffer.Capacity() == 16);
+    REQUIRE(memcmp(buffer.Data(), "45678901abc", 11) == 0);
+
+    buffer.Consume(11);
+    REQUIRE(buffer.Empty());
+}
+
+TEST_CASE("BlockCodec") {
+    std::mt19937 rng(42);
+    auto roundTrip = [](const std::vector<uint8_t>& raw) {
+        std::vector<uint8_t> packed = {0xAA};   // appended after what's there
+        if (!BlockCodec::Compress(raw.data(), raw.size(), packed)) {
+            REQUIRE(packed.size() == 1);
+            return false;
+        }
+        REQUIRE(packed.size() < raw.size() + 1);
+        std::vector<uint8_t> decoded;
+        REQUIRE(BlockCodec::Decompress(packed.data() + 1, packed.data() + packed.size(), decoded));
+        REQUIRE(decoded == raw);
+        return true;
+    };
+
+    SECTION("repetitive data shrinks") {
+        for (size_t size : {64, 1000, 65537, 300000}) {
+            std::vector<uint8_t> raw(size);
+            for (size_t i = 0; i < size; i++) {
+                raw[i] = static_cast<uint8_t>(i % 7 + (i / 4096) % 3);
+            }
+            REQUIRE(roundTrip(raw));
+        }
+    }
+
+    SECTION("random data is left alone") {
+        std::vector<uint8_t> raw(5000);
+        for (auto& b : raw) {
+            b = static_cast<uint8_t>(rng());
+        }
+        REQUIRE_FALSE(roundTrip(raw));
+        REQUIRE_FALSE(roundTrip({}));
+        REQUIRE_FALSE(roundTrip({1, 2, 3}));
+    }
+
+    SECTION("mixed data") {
+        // random runs with repeats of earlier runs, exercises overlapping matches
+        std::vector<uint8_t> raw;
+        while (raw.size() < 200000) {
+            if (raw.size() > 16 && rng() % 2) {
+                size_t from = rng() % raw.size();
+                size_t len = rng() % 300 + 1;
+                for (size_t i = 0; i < len; i++) {
+                    raw.push_back(raw[from + i]);
+                }
+            } else {
+                for (int i = rng() % 50; i >= 0; i--) {
+                    raw.push_back(static_cast<uint8_t>(rng()));
+                }
+            }
+        }
+        REQUIRE(roundTrip(raw));
+    }
+
+    SECTION("corrupt input is rejected") {
+        std::vector<uint8_t> raw(10000, 'a');
+        std::vector<uint8_t> packed, decoded;
+        REQUIRE(BlockCodec::Compress(raw.data(), raw.size(), packed));
+        REQUIRE_FALSE(BlockCodec::Decompress(packed.data(), packed.data() + packed.size() - 1, decoded));
+        REQUIRE_FALSE(BlockCodec::Decompress(packed.data(), packed.data() + 3, decoded));
+        packed[0] ++;   // raw size doesn't match
+        REQUIRE_FALSE(BlockCodec::Decompress(packed.data(), packed.data() + packed.size(), decoded));
+
+        for (int i = 0; i < 1000; i++) {
+            std::vector<uint8_t> garbage(rng() % 64 + 4);
+            for (auto& b : garbage) {
+                b = static_cast<uint8_t>(rng());
+            }
+            garbage[2] = garbage[3] = 0;    // keep the claimed size small
+            BlockCodec::Decompress(garbage.data(), garbage.data() + garbage.size(), decoded);
+        }
+    }
+
+    SECTION("a raw size the block can't have is refused before allocating") {
+        // the most compressible input still decodes
+        std::vector<uint8_t> zeros(8 * 1024 * 1024, 0);
+        REQUIRE(roundTrip(zeros));
+
+        std::vector<uint8_t> packed = {0, 0, 0, 0x40};  // claims 1 GiB
+        packed.resize(20, 0);
+        std::vector<uint8_t> decoded;
+        REQUIRE_FALSE(BlockCodec::Decompress(packed.data(), packed.data() + packed.size(), decoded));
+        REQUIRE(decoded.capacity() == 0);
+    }
+
+    SECTION("pooled buffers give back oversized capacity") {
+        std::vector<std::vector<uint8_t>> pool(2);
+        pool[0].resize(1024);
+        pool[1].resize(BlockCodec::KeepCapacity + 1);
+        BlockCodec::TrimPool(pool);
+        REQUIRE(pool[0].capacity() >= 1024);
+        REQUIRE(pool[1].capacity() == 0);
+    }
+}
+
+#ifndef _WIN32
+TEST_CASE("ShmRing") {
+    auto ring = ShmRing::Create("visual_debugger_utility_test", 10);
+    REQUIRE(ring);
+    REQUIRE(ring->Capacity() == 4096);
+    auto producer = ShmRing::Open("visual_debugger_utility_test");
+    REQUIRE(producer);
+    // one producer at a time
+    REQUIRE_FALSE(ShmRing::Open("visual_debugger_utility_test"));
+
+    // push the write position close to the end so the next write wraps
+    std::vector<uint8_t> filler(4000, 'x');
+    net::IoSlice fillerSlice{filler.data(), filler.size()};
+    REQUIRE(producer->Write(&fillerSlice, 1));
+    std::vector<uint8_t> out(4096);
+    REQUIRE(ring->Read(out.data(), out.size(), 0) == 4000);
+
+    std::vector<uint8_t> data(200);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<uint8_t>(i);
+    }
+    net::IoSlice slices[] = {
+        {data.data(), 100},
+        {data.data() + 100, 100},
+    };
+    REQUIRE(producer->Write(slices, 2));
+    REQUIRE(ring->Read(out.data(), out.size(), 0) == 200);
+    REQUIRE(memcmp(out.data(), data.data(), 200) == 0);
+
+    // empty ring times out
+    REQUIRE(ring->Read(out.data(), out.size(), 1) == 0);
+
+    producer.reset();
+    auto next = ShmRing::Open("visual_debugger_utility_test");
+    REQUIRE(next);
+
+    // the consumer closing is reported, not written into the void
+    ring.reset();
+    REQUIRE_FALSE(next->Write(slices, 2));
+}
+#endif
+
+TEST_CASE("SlotMap") {
+    SlotMap<int> map;
+    auto a = map.Insert(1);
+    auto b = map.Insert(2);
+    auto c = map.Insert(3);
+    REQUIRE(map.Size() == 3);
+    REQUIRE(*map.Get(b) == 2);
+
+    // the last value moves into the hole, its handle still finds it
+    REQUIRE(map.Remove(a));
+    REQUIRE_FALSE(map.Remove(a));
+    REQUIRE(map.Get(a) == nullptr);
+    REQUIRE(map.Values() == std::vector<int>{3, 2});
+    REQUIRE(*map.Get(c) == 3);
+    REQUIRE(map.HandleAt(0) == c);
+
+    // the slot is reused with a new generation
+    auto d = map.Insert(4);
+    REQUIRE(d.index == a.index);
+    REQUIRE(d != a);
+    REQUIRE(map.Get(a) == nullptr);
+    REQUIRE(*map.Get(d) == 4);
+
+    REQUIRE(map.Remove(d));
+    REQUIRE(map.Remove(b));
+    REQUIRE(map.Values() == std::vector<int>{3});
+    map.Clear();
+    REQUIRE(map.Size() == 0);
+    REQUIRE(map.Get(c) == nullptr);
+    REQUIRE(map.Get(SlotMap<int>::Handle{}) == nullptr);
+}